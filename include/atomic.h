@@ -2,6 +2,13 @@
 #define _ATOMIC_H_
 
 #include "stdint.h"
+#include "core.h"
+#include "percpu.h"
+#include "utils.h"
+#include "printf.h"
+#ifdef LOCK_STATS
+#include "timer.h"
+#endif
 
 #ifdef USE_MONITOR
 static inline void monitor(uintptr_t addr) {
@@ -73,7 +80,7 @@ class Atomic {
     volatile T value;
 
    public:
-    Atomic(T x) : value(x) {
+    constexpr Atomic(T x) : value(x) {
     }
     Atomic<T> &operator=(T v) {
         __atomic_store_n(&value, v, __ATOMIC_SEQ_CST);
@@ -99,6 +106,21 @@ class Atomic {
         __atomic_exchange(&value, &v, &ret, __ATOMIC_SEQ_CST);
         return ret;
     }
+    // Weaker orderings for lock-free fast paths
+    T load_relaxed() const {
+        return __atomic_load_n(&value, __ATOMIC_RELAXED);
+    }
+    T load_acquire() const {
+        return __atomic_load_n(&value, __ATOMIC_ACQUIRE);
+    }
+    void store_release(T v) {
+        __atomic_store_n(&value, v, __ATOMIC_RELEASE);
+    }
+    // On failure, expected is updated with the current value
+    bool compare_exchange(T &expected, T desired) {
+        return __atomic_compare_exchange_n(&value, &expected, desired, false, __ATOMIC_SEQ_CST,
+                                           __ATOMIC_SEQ_CST);
+    }
     void monitor_value() {
 #ifdef USE_MONITOR
         monitor((uintptr_t)&value);  // Call monitor if USE_MONITOR is defined
@@ -121,6 +143,26 @@ class Atomic<int64_t> {
     Atomic(int64_t) = delete;
 };
 
+// Sleep until an event is signalled by another core (sev) or an interrupt arrives
+static inline void wfe() {
+    asm volatile("wfe" ::: "memory");
+}
+
+// Sleep until an interrupt is pending, even a masked one; sev does not end it
+static inline void wfi() {
+    asm volatile("dsb sy\n\twfi" ::: "memory");
+}
+
+// Make prior stores visible, then wake every core sleeping in wfe
+static inline void sev() {
+    asm volatile("dsb ish\n\tsev" ::: "memory");
+}
+
+// Spin-wait hint for busy loops that are expected to be short
+static inline void cpu_relax() {
+    asm volatile("yield" ::: "memory");
+}
+
 class Barrier {
     Atomic<uint32_t> counter;
 public:
@@ -135,25 +177,135 @@ public:
     }
 };
 
-/*
-class Interrupts {
-public:
-    static bool isDisabled() {
-        uint32_t oldFlags = getFlags();
-        return (oldFlags & 0x200) == 0;
+// Reusable centralized barrier. The last core to arrive re-arms the counter
+// and flips the global sense; everyone else sleeps until the sense changes.
+// The sense is sampled before arriving, so no per-core state is needed.
+class SenseBarrier {
+    const uint32_t total;
+    Atomic<uint32_t> remaining;
+    Atomic<uint32_t> sense;
+
+   public:
+    constexpr SenseBarrier(uint32_t total) : total(total), remaining(total), sense(0) {
     }
+    SenseBarrier(const SenseBarrier &) = delete;
 
-    static bool disable() {
-        bool wasDisabled = isDisabled();
-        if (!wasDisabled)
-            cli();
-        return wasDisabled;
+    void sync() {
+        uint32_t my_sense = sense.get();
+        if (remaining.add_fetch(-1) == 0) {
+            remaining.set(total);
+            sense.set(my_sense ^ 1);
+            sev();
+        } else {
+            while (sense.get() == my_sense) {
+                wfe();
+            }
+        }
     }
+};
+
+// Reusable combining-tree barrier. Participants arrive at a leaf shared with
+// at most FANIN - 1 others; only the last arrival at each node climbs to its
+// parent, so no counter is touched by more than FANIN cores. The last arrival
+// at the root flips the global sense to release everyone.
+template <uint32_t MAX_PARTICIPANTS = CORE_COUNT, uint32_t FANIN = 2>
+class TreeBarrier {
+    static_assert(FANIN >= 2, "TreeBarrier: fan-in must be at least 2");
+
+    struct alignas(CACHE_LINE_SIZE) Node {
+        Atomic<uint32_t> arrived{0};
+        uint32_t expected = 0;
+        int32_t parent = -1;
+    };
+
+    // A tree over n leaves never has more than n nodes when FANIN >= 2
+    Node nodes[MAX_PARTICIPANTS];
+    uint32_t participants;
+    alignas(CACHE_LINE_SIZE) Atomic<uint32_t> sense{0};
 
-    static void restore(bool wasDisabled) {
-        if (!wasDisabled) {
-            sti();
+   public:
+    constexpr TreeBarrier(uint32_t n) : nodes(), participants(n) {
+        if (n == 0 || n > MAX_PARTICIPANTS) {
+            panic("TreeBarrier: %u participants, room for 1 to %u", n, MAX_PARTICIPANTS);
+        }
+        uint32_t level_start = 0;
+        uint32_t children = n;
+        uint32_t width = (n + FANIN - 1) / FANIN;
+        while (true) {
+            for (uint32_t j = 0; j < width; j++) {
+                uint32_t rest = children - j * FANIN;
+                nodes[level_start + j].expected = rest < FANIN ? rest : FANIN;
+            }
+            if (width == 1) break;
+            uint32_t next_start = level_start + width;
+            for (uint32_t j = 0; j < width; j++) {
+                nodes[level_start + j].parent = (int32_t)(next_start + j / FANIN);
+            }
+            children = width;
+            width = (width + FANIN - 1) / FANIN;
+            level_start = next_start;
+        }
+    }
+    TreeBarrier(const TreeBarrier &) = delete;
+
+    // id must be unique per participant and less than the participant count
+    void sync(uint32_t id) {
+        uint32_t my_sense = sense.get();
+        int32_t node = (int32_t)(id / FANIN);
+        while (node >= 0) {
+            Node &n = nodes[node];
+            if (n.arrived.add_fetch(1) != n.expected) {
+                while (sense.get() == my_sense) {
+                    wfe();
+                }
+                return;
+            }
+            n.arrived.set(0);
+            node = n.parent;
         }
+        sense.set(my_sense ^ 1);
+        sev();
+    }
+
+    uint32_t count() const {
+        return participants;
+    }
+};
+
+// AArch64 interrupt masking through the DAIF flags. Locks save the whole
+// DAIF value and restore it verbatim, so nesting and callers that already run
+// with interrupts masked (early boot, exception handlers) keep their state.
+class Interrupts {
+    static PerCPU<uint32_t> irq_depth;      // defined in exec.cpp
+    static PerCPU<uint32_t> softirq_depth;  // defined in softirq.cpp
+
+   public:
+    static constexpr uint64_t DAIF_F = 1 << 6;
+    static constexpr uint64_t DAIF_I = 1 << 7;
+
+    static inline uint64_t getFlags() {
+        uint64_t daif;
+        asm volatile("mrs %0, daif" : "=r"(daif));
+        return daif;
+    }
+
+    static inline bool isDisabled() {
+        return (getFlags() & DAIF_I) != 0;
+    }
+
+    // Mask IRQ and FIQ, returning the previous DAIF value for restore()
+    static inline uint64_t disable() {
+        uint64_t daif = getFlags();
+        asm volatile("msr daifset, #3" ::: "memory");
+        return daif;
+    }
+
+    static inline void restore(uint64_t daif) {
+        asm volatile("msr daif, %0" ::"r"(daif) : "memory");
+    }
+
+    static inline void enable() {
+        asm volatile("msr daifclr, #3" ::: "memory");
     }
 
     template <typename Work>
@@ -163,8 +315,69 @@ public:
         restore(was);
     }
 
+    // IRQ context tracking, maintained by handle_irq
+    static inline void enterIRQ() {
+        irq_depth.mine()++;
+    }
+    static inline void exitIRQ() {
+        irq_depth.mine()--;
+    }
+    static inline bool inIRQ() {
+        return irq_depth.mine() != 0;
+    }
+
+    // Deferred IRQ work runs with IRQs enabled but counts as interrupt
+    // context for locking, see softirq.h
+    static inline void enterSoftirq() {
+        softirq_depth.mine()++;
+    }
+    static inline void exitSoftirq() {
+        softirq_depth.mine()--;
+    }
+    static inline bool inInterrupt() {
+        return irq_depth.mine() != 0 || softirq_depth.mine() != 0;
+    }
+};
+
+// Per-core preemption control. The scheduler only switches threads on a core
+// whose count is zero; a tick that lands while it is raised just sets
+// need_resched and the switch happens once the count drops back to zero.
+struct PreemptState {
+    uint32_t count;
+    bool need_resched;
+};
+
+void preempt_schedule();  // sched.cpp
+
+class Preempt {
+    static PerCPU<PreemptState> state;  // defined in sched.cpp
+
+   public:
+    static inline void disable() {
+        state.mine().count++;
+        asm volatile("" ::: "memory");
+    }
+
+    static inline void enable() {
+        asm volatile("" ::: "memory");
+        PreemptState &s = state.mine();
+        if (--s.count == 0 && s.need_resched && !Interrupts::isDisabled()) {
+            preempt_schedule();
+        }
+    }
+
+    static inline bool isEnabled() {
+        return state.mine().count == 0;
+    }
+
+    static inline bool needResched() {
+        return state.mine().need_resched;
+    }
+
+    static inline void setNeedResched(bool v) {
+        state.mine().need_resched = v;
+    }
 };
-*/
 
 template <typename T>
 class LockGuard {
@@ -202,11 +415,66 @@ class NoLock {
 
 // extern void pause();
 
+#ifdef LOCK_STATS
+// Contention counters for one core. Each core only ever writes its own slot,
+// so the counters are plain integers on their own cache line.
+struct alignas(CACHE_LINE_SIZE) LockCoreStats {
+    uint64_t acquisitions;
+    uint64_t contended;
+    uint64_t wait_total;
+    uint64_t wait_max;
+    uint64_t hold_max;
+};
+
+// Per-lock instrumentation, only kept for named locks. Times are in generic
+// timer ticks. The lock links itself into the report list on first use.
+struct LockStats {
+    const char *name;
+    LockStats *next;
+    Atomic<bool> registered;
+    uint64_t acquired_at;  // written by the holder only
+    LockCoreStats per_core[CORE_COUNT];
+
+    constexpr LockStats(const char *name)
+        : name(name), next(nullptr), registered(false), acquired_at(0), per_core() {
+    }
+};
+
+void lock_stats_register(LockStats *stats);
+void lock_stats_dump();
+#endif
+
+// Holding a SpinLock disables preemption on this core, so a thread spinning
+// for it can never be waiting on a thread it preempted.
 class SpinLock {
     Atomic<bool> taken;
+#ifdef LOCK_STATS
+    LockStats stats;
+#endif
+#ifdef LOCK_DEBUG
+    const char *debug_name;
+    Atomic<uint32_t> owner;  // core id + 1, 0 when free
+    Atomic<bool> used_in_irq;
+    Atomic<bool> used_irqs_on;
+#endif
 
    public:
-    SpinLock() : taken(false) {
+    // The name is only used when built with LOCK_STATS=1
+    constexpr SpinLock(const char *name = nullptr)
+        : taken(false)
+#ifdef LOCK_STATS
+          ,
+          stats(name)
+#endif
+#ifdef LOCK_DEBUG
+          ,
+          debug_name(name),
+          owner(0),
+          used_in_irq(false),
+          used_irqs_on(false)
+#endif
+    {
+        (void)name;
     }
 
     SpinLock(const SpinLock &) = delete;
@@ -217,93 +485,163 @@ class SpinLock {
     }
 
     void lock(void) {
+        Preempt::disable();
+#ifdef LOCK_DEBUG
+        debug_check_acquire();
+#endif
+#ifdef LOCK_STATS
+        if (stats.name) {
+            lock_instrumented();
+            return;
+        }
+#endif
         taken.monitor_value();
         while (taken.exchange(true)) {
             // iAmStuckInALoop(true);
             taken.monitor_value();
         }
+#ifdef LOCK_DEBUG
+        owner.set(this_core() + 1);
+#endif
     }
 
     void unlock(void) {
+#ifdef LOCK_DEBUG
+        // Each unlock also ends a Preempt::disable(), so an unbalanced one
+        // would leave the count wrapped
+        if (!taken.get()) {
+            panic("SpinLock %s: unlocked while not held", debug_name ? debug_name : "(anonymous)");
+        }
+        owner.set(0);
+#endif
+#ifdef LOCK_STATS
+        if (stats.name && stats.acquired_at != 0) {
+            uint64_t held = timer_count() - stats.acquired_at;
+            stats.acquired_at = 0;
+            LockCoreStats &mine = stats.per_core[this_core()];
+            if (held > mine.hold_max) mine.hold_max = held;
+        }
+#endif
         taken.set(false);
+        Preempt::enable();
+    }
+
+#ifdef LOCK_STATS
+   private:
+    void lock_instrumented() {
+        uint64_t start = timer_count();
+        bool contended = false;
+        while (taken.exchange(true)) {
+            contended = true;
+        }
+        uint64_t now = timer_count();
+        uint64_t waited = now - start;
+
+        LockCoreStats &mine = stats.per_core[this_core()];
+        mine.acquisitions++;
+        if (contended) mine.contended++;
+        mine.wait_total += waited;
+        if (waited > mine.wait_max) mine.wait_max = waited;
+        stats.acquired_at = now;
+
+        if (!stats.registered.get()) lock_stats_register(&stats);
+#ifdef LOCK_DEBUG
+        owner.set(this_core() + 1);
+#endif
     }
+#endif
+
+#ifdef LOCK_DEBUG
+   private:
+    // A lock that is taken from an IRQ or softirq handler and also with IRQs
+    // enabled can deadlock when the IRQ lands on the core holding it (a
+    // softirq runs on the way out of that IRQ); such locks must be
+    // InterruptSafeLocks. Re-taking a lock this core already holds always
+    // deadlocks.
+    void debug_check_acquire() {
+        const char *name = debug_name ? debug_name : "(anonymous)";
+        if (owner.get() == this_core() + 1) {
+            panic("SpinLock %s: recursive acquisition on core %d", name, (int)this_core());
+        }
+        if (Interrupts::inInterrupt()) {
+            used_in_irq.set(true);
+        } else if (!Interrupts::isDisabled()) {
+            used_irqs_on.set(true);
+        }
+        if (used_in_irq.get() && used_irqs_on.get()) {
+            panic("SpinLock %s: taken in IRQ context and with IRQs enabled; "
+                  "use InterruptSafeLock",
+                  name);
+        }
+    }
+#endif
 };
-/*
-// Is this correct?
-class InterruptSafeLock  {
-    Atomic<bool> taken;
-    volatile bool was;
-public:
-    Atomic<uint32_t> ref_count;
-    InterruptSafeLock() : taken(false), was(false), ref_count(0) {}
+// SpinLock that masks IRQ/FIQ on this core for as long as it is held, so it
+// can be shared between normal code and interrupt handlers. Interrupts are
+// masked before spinning: an IRQ arriving after the lock is taken could
+// otherwise spin forever on the lock its own core holds.
+class InterruptSafeLock {
+    SpinLock spin;
+    uint64_t saved_daif;  // written by the holder only
+
+   public:
+    constexpr InterruptSafeLock(const char *name = nullptr) : spin(name), saved_daif(0) {
+    }
 
-    InterruptSafeLock(const InterruptSafeLock&) = delete;
+    InterruptSafeLock(const InterruptSafeLock &) = delete;
 
     // for debugging, etc. Allows false positives
     bool isMine() {
-        return taken.get();
+        return spin.isMine();
     }
 
     void lock() {
-        while (true) {
-            taken.monitor_value();
-            bool wasDisabled = Interrupts::disable();
-            if (!taken.exchange(true)) {
-                was = wasDisabled;
-                return;
-            }
-            Interrupts::restore(wasDisabled);
-            iAmStuckInALoop(true);
-        }
+        uint64_t daif = Interrupts::disable();
+        spin.lock();
+        saved_daif = daif;
     }
 
     void unlock() {
-        auto wasDisabled = was;
-        taken.set(false);
-        Interrupts::restore(wasDisabled);
+        uint64_t daif = saved_daif;
+#ifdef LOCK_DEBUG
+        if (!Interrupts::isDisabled()) {
+            panic("InterruptSafeLock: interrupts re-enabled while the lock was held");
+        }
+#endif
+        spin.unlock();
+        Interrupts::restore(daif);
     }
 };
 
-// A more flexible InterruptSafeLock
-class ISL  {
-    Atomic<bool> taken;
-public:
-    Atomic<uint32_t> ref_count;
-    ISL() : taken(false), ref_count(0) {}
+// A more flexible InterruptSafeLock: the caller keeps the saved DAIF value,
+// so the lock can be released with a different mask than it was taken with.
+class ISL {
+    SpinLock spin;
 
-    ISL(const ISL&) = delete;
-    ISL& operator=(const ISL&) const = delete;
+   public:
+    constexpr ISL(const char *name = nullptr) : spin(name) {
+    }
 
+    ISL(const ISL &) = delete;
+    ISL &operator=(const ISL &) const = delete;
 
     // for debugging, etc. Allows false positives
     bool isMine() {
-        return taken.get();
+        return spin.isMine();
     }
 
-    bool lock() {
-        while (true) {
-            taken.monitor_value();
-            bool wasDisabled = Interrupts::disable();
-            if (!taken.exchange(true)) {
-                return wasDisabled;
-            }
-            Interrupts::restore(wasDisabled);
-            iAmStuckInALoop(true);
-        }
+    uint64_t lock() {
+        uint64_t daif = Interrupts::disable();
+        spin.lock();
+        return daif;
     }
 
-    void unlock(bool disable) {
-        taken.set(false);
-        if (disable) {
-            cli();
-        } else {
-            sti();
-        }
+    void unlock(uint64_t daif) {
+        spin.unlock();
+        Interrupts::restore(daif);
     }
 };
 
-*/
-
 
 
 #endif
\ No newline at end of file
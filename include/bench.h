@@ -0,0 +1,56 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include "printf.h"
+#include "stdint.h"
+#include "timer.h"
+
+// Benchmark function type. Every core calls it at the same time.
+typedef void (*BenchFunction)();
+
+// Benchmark registry entry
+struct BenchEntry {
+    const char* name;
+    BenchFunction function;
+    BenchEntry* next;
+};
+
+class BenchFramework {
+private:
+    static BenchEntry* first_bench;
+    static BenchEntry* last_bench;
+    static int total_benches;
+
+public:
+    // Register a benchmark (core 0, before run_all_benches)
+    static void register_bench(const char* name, BenchFunction function);
+
+    // Run all registered benchmarks in registration order. Must be called by
+    // every core; cores rendezvous before and after each benchmark.
+    static void run_all_benches();
+
+    // Rendezvous of all cores, usable from inside a benchmark
+    static void sync();
+
+    // Generic timer counter, ordered against prior instructions
+    static inline uint64_t now() {
+        return timer_count();
+    }
+
+    // Generic timer frequency in Hz
+    static inline uint64_t frequency() {
+        return timer_frequency();
+    }
+
+    static uint64_t ticks_to_ns(uint64_t ticks);
+
+    // Print one result line in the machine-parseable form
+    //   BENCH <name> core=<id> iters=<n> ticks=<t> ns=<total> ns_per_op=<avg>
+    static void report(const char* name, uint64_t iters, uint64_t ticks);
+};
+
+// Macro for manual benchmark registration, mirrors MANUAL_REGISTER_TEST
+#define MANUAL_REGISTER_BENCH(bench_function) \
+    BenchFramework::register_bench(#bench_function, bench_function)
+
+#endif // _BENCH_H_
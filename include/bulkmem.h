@@ -0,0 +1,41 @@
+#ifndef _BULKMEM_H_
+#define _BULKMEM_H_
+
+#include "core.h"
+#include "stdint.h"
+
+/*
+ * Large fills and copies spread over several cores.
+ *
+ * The range is cut into one contiguous share per core, with every cut on a
+ * cache line boundary of the destination so no line is written by two
+ * cores. The other cores run their share from a call IPI
+ * (smp_call_function_mask()), the caller runs its own, and the call returns
+ * once all of them are done. Each share goes through the 64-byte kernels in
+ * mm.S: dc zva for zeroing, ldp/stp pairs otherwise.
+ *
+ * Below PARALLEL_MEM_THRESHOLD, or from a context that can't wait for other
+ * cores (IRQs masked, interrupt context), everything runs on the calling
+ * core, still with the line kernels.
+ *
+ * Remote shares run with IRQs masked on their cores, so this is for bulk
+ * work (boot, large buffers), not for latency-sensitive paths. The memory
+ * must be Normal cacheable, i.e. the MMU must be on.
+ */
+
+static constexpr size_t PARALLEL_MEM_THRESHOLD = 256 * 1024;
+
+// Fill n bytes at dst with val using up to cores cores, the caller first
+void* parallel_memset(void* dst, uint8_t val, size_t n, uint32_t cores = CORE_COUNT);
+
+// Copy n bytes; the ranges must not overlap
+void* parallel_memcpy(void* dst, const void* src, size_t n, uint32_t cores = CORE_COUNT);
+
+extern "C" {
+// 64-byte kernels from mm.S: dst 64-byte aligned, n a multiple of 64
+void memzero_lines(void* dst, size_t n);
+void memfill_lines(void* dst, uint64_t pattern, size_t n);
+void memcopy_lines(void* dst, const void* src, size_t n);  // src 16-byte aligned
+}
+
+#endif // _BULKMEM_H_
@@ -0,0 +1,160 @@
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include "atomic.h"
+#include "core.h"
+#include "heap.h"
+#include "stdint.h"
+#include "utils.h"
+
+// Wait-free single-producer/single-consumer channel. The producer owns tail
+// and a cached copy of head, the consumer owns head and a cached copy of
+// tail, each pair on its own cache line. A side only re-reads the other
+// side's cursor when its cached copy says the ring is full (or empty), so in
+// steady state the producer never touches the consumer's line.
+//
+// Messages are constructed in place in the ring and moved out on receive.
+template <typename T, uint32_t CAPACITY>
+class SPSCChannel {
+    static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+                  "SPSCChannel: capacity must be a power of two");
+    static constexpr uint32_t MASK = CAPACITY - 1;
+
+    // Producer side
+    alignas(CACHE_LINE_SIZE) Atomic<uint32_t> tail{0};
+    uint32_t cached_head = 0;
+
+    // Consumer side
+    alignas(CACHE_LINE_SIZE) Atomic<uint32_t> head{0};
+    uint32_t cached_tail = 0;
+
+    alignas(CACHE_LINE_SIZE) alignas(T) unsigned char storage[CAPACITY][sizeof(T)] = {};
+
+    T* slot(uint32_t pos) {
+        return (T*)storage[pos & MASK];
+    }
+
+   public:
+    // Trivially destructible so channels can be static: messages still
+    // queued when a channel goes away are not destroyed.
+    constexpr SPSCChannel() {
+    }
+    SPSCChannel(const SPSCChannel&) = delete;
+
+    static constexpr uint32_t capacity() {
+        return CAPACITY;
+    }
+
+    // Producer: construct a message directly in the ring
+    template <typename... Args>
+    bool try_emplace(Args&&... args) {
+        uint32_t t = tail.load_relaxed();
+        if (t - cached_head == CAPACITY) {
+            cached_head = head.load_acquire();
+            if (t - cached_head == CAPACITY) return false;
+        }
+        new (slot(t)) T(static_cast<Args&&>(args)...);
+        tail.store_release(t + 1);
+        return true;
+    }
+
+    bool try_send(const T& value) {
+        return try_emplace(value);
+    }
+
+    bool try_send(T&& value) {
+        return try_emplace(static_cast<T&&>(value));
+    }
+
+    // Consumer: the oldest message, left in place, or nullptr when empty
+    T* peek() {
+        uint32_t h = head.load_relaxed();
+        if (h == cached_tail) {
+            cached_tail = tail.load_acquire();
+            if (h == cached_tail) return nullptr;
+        }
+        return slot(h);
+    }
+
+    // Consumer: drop the message returned by peek()
+    void pop() {
+        uint32_t h = head.load_relaxed();
+        slot(h)->~T();
+        head.store_release(h + 1);
+    }
+
+    // Consumer: move the oldest message out
+    bool try_recv(T& out) {
+        T* msg = peek();
+        if (!msg) return false;
+        out = static_cast<T&&>(*msg);
+        pop();
+        return true;
+    }
+
+    // Either side; exact only when the other side is quiet
+    bool empty() {
+        return head.load_acquire() == tail.load_acquire();
+    }
+};
+
+// Full N x N mesh of SPSC channels: channel(from, to) carries messages from
+// core `from` to core `to`, so every core pair talks without any lock.
+template <typename T, uint32_t CAPACITY>
+class ChannelMesh {
+    SPSCChannel<T, CAPACITY> channels[CORE_COUNT][CORE_COUNT];
+
+   public:
+    constexpr ChannelMesh() {
+    }
+    ChannelMesh(const ChannelMesh&) = delete;
+
+    SPSCChannel<T, CAPACITY>& channel(uint32_t from, uint32_t to) {
+        return channels[from][to];
+    }
+
+    // Send from the calling core to core `to`
+    template <typename... Args>
+    bool try_send(uint32_t to, Args&&... args) {
+        return channels[getCoreID()][to].try_emplace(static_cast<Args&&>(args)...);
+    }
+
+    // Receive on the calling core from core `from`
+    bool try_recv(uint32_t from, T& out) {
+        return channels[from][getCoreID()].try_recv(out);
+    }
+
+    // Deliver every pending message for the calling core to handler(from, msg),
+    // at most budget messages per sender. Returns the number delivered.
+    template <typename Handler>
+    uint32_t poll(Handler handler, uint32_t budget = CAPACITY) {
+        uint32_t me = getCoreID();
+        uint32_t delivered = 0;
+        for (uint32_t from = 0; from < CORE_COUNT; from++) {
+            SPSCChannel<T, CAPACITY>& ch = channels[from][me];
+            for (uint32_t n = 0; n < budget; n++) {
+                T* msg = ch.peek();
+                if (!msg) break;
+                handler(from, *msg);
+                ch.pop();
+                delivered++;
+            }
+        }
+        return delivered;
+    }
+};
+
+// Kernel-wide inter-core messages
+struct CoreMessage {
+    uint32_t type;
+    uint64_t arg0;
+    uint64_t arg1;
+};
+
+static constexpr uint32_t CORE_CHANNEL_CAPACITY = 64;
+
+// Statically initialised, so every channel is ready before the secondary
+// cores are released
+extern ChannelMesh<CoreMessage, CORE_CHANNEL_CAPACITY> core_channels;
+
+#endif // _CHANNEL_H_
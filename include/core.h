@@ -3,6 +3,9 @@
 
 #define CORE_COUNT 4
 
+// Cortex-A53 L1/L2 line size; used to keep per-core data on separate lines
+#define CACHE_LINE_SIZE 64
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -0,0 +1,385 @@
+#ifndef _CORO_H_
+#define _CORO_H_
+
+#include "atomic.h"
+#include "channel.h"
+#include "coroutine.h"
+#include "heap.h"
+#include "percpu.h"
+#include "printf.h"
+#include "stdint.h"
+#include "timer.h"
+#include "wait.h"
+
+/*
+ * Stackless C++20 coroutines for asynchronous kernel work.
+ *
+ * A CoTask<T> (unrelated to the work pool's Task) is a lazily started
+ * coroutine producing a T. Awaiting a task runs it right there on the awaiting coroutine's executor; if it completes
+ * without suspending, the awaiter just carries on. If it suspends (on a
+ * timer, the UART, a channel), whoever wakes it posts it back to its
+ * executor, and when it finishes it posts its awaiter in turn. Nothing here
+ * relies on symmetric transfer, so chains of awaits don't grow the stack
+ * even when the compiler doesn't turn resumptions into tail calls (-O0).
+ *
+ * Every core runs one executor thread that resumes posted coroutines and
+ * sleeps when there are none. A coroutine always stays on the core it was
+ * spawned on. Frames come from per-core pools of fixed-size blocks rather
+ * than the general heap, so thousands of concurrent state machines cost a
+ * few hundred bytes each instead of a thread stack.
+ *
+ * There are no exceptions: a coroutine either returns or panics.
+ *
+ *   CoTask<int> read_two() {
+ *       char a = co_await co_uart_getc();
+ *       co_await co_sleep_for(timer_frequency() / 1000);
+ *       char b = co_await co_uart_getc();
+ *       co_return a + b;
+ *   }
+ *   int x = block_on(read_two());
+ */
+
+// Frames come from per-core pools of fixed-size blocks; larger ones from
+// kmalloc. Thread context only.
+void* coro_frame_alloc(size_t size);
+void coro_frame_free(void* frame);
+
+// Pools grow by this much at a time
+static constexpr size_t CORO_FRAME_SLAB = 16 * 1024;
+
+// A suspended coroutine, queued for the executor of core
+struct ReadyNode {
+    ReadyNode* next = nullptr;
+    std::coroutine_handle<> handle;
+    uint32_t core = 0;
+};
+
+// Queue n.handle to be resumed on n.core's executor. Safe from any core and
+// from IRQ handlers.
+void coro_post(ReadyNode& n);
+
+// Start this core's executor thread; called once per core after sched_init()
+void coro_init();
+
+struct CoroStats {
+    uint64_t resumed;  // coroutines the executor resumed
+    uint64_t frames;   // frames allocated from the pool
+    uint64_t slabs;    // pool refills from kmalloc
+};
+
+CoroStats coro_stats(uint32_t core);
+
+template <typename T = void>
+class CoTask;
+
+namespace coro_detail {
+
+struct PromiseBase {
+    ReadyNode* waiter = nullptr;  // awaiting coroutine, once it has suspended
+    ReadyNode start;              // first resumption of a spawned task
+    bool detached = false;
+
+    static void* operator new(unsigned long size) {
+        return coro_frame_alloc(size);
+    }
+
+    static void operator delete(void* frame) {
+        coro_frame_free(frame);
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+        return {};
+    }
+
+    // A detached task doesn't suspend at the end, which frees its frame
+    struct FinalAwaiter {
+        PromiseBase* promise;
+
+        bool await_ready() noexcept {
+            return promise->detached;
+        }
+        void await_suspend(std::coroutine_handle<>) noexcept {
+            if (promise->waiter) coro_post(*promise->waiter);
+        }
+        void await_resume() noexcept {
+        }
+    };
+
+    FinalAwaiter final_suspend() noexcept {
+        return FinalAwaiter{this};
+    }
+
+    void unhandled_exception() {
+        panic("coro: exception escaped a coroutine");
+    }
+};
+
+template <typename T>
+struct Promise : PromiseBase {
+    alignas(T) unsigned char storage[sizeof(T)];
+    bool has_value = false;
+
+    CoTask<T> get_return_object();
+
+    void return_value(T value) {
+        new (storage) T(static_cast<T&&>(value));
+        has_value = true;
+    }
+
+    T take() {
+        T* p = (T*)storage;
+        T value = static_cast<T&&>(*p);
+        p->~T();
+        has_value = false;
+        return value;
+    }
+
+    ~Promise() {
+        if (has_value) ((T*)storage)->~T();
+    }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    CoTask<void> get_return_object();
+
+    void return_void() {
+    }
+
+    void take() {
+    }
+};
+
+}  // namespace coro_detail
+
+template <typename T>
+class [[nodiscard]] CoTask {
+   public:
+    using promise_type = coro_detail::Promise<T>;
+    using Handle = std::coroutine_handle<promise_type>;
+
+   private:
+    Handle handle;
+
+   public:
+    CoTask() : handle() {
+    }
+
+    explicit CoTask(Handle h) : handle(h) {
+    }
+
+    CoTask(CoTask&& other) : handle(other.handle) {
+        other.handle = Handle();
+    }
+
+    CoTask(const CoTask&) = delete;
+
+    CoTask& operator=(CoTask&& other) {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = Handle();
+        }
+        return *this;
+    }
+
+    ~CoTask() {
+        if (handle) handle.destroy();
+    }
+
+    // Give up ownership of the frame
+    Handle release() {
+        Handle h = handle;
+        handle = Handle();
+        return h;
+    }
+
+    struct Awaiter {
+        Handle child;
+        ReadyNode node;
+
+        bool await_ready() {
+            return child.done();
+        }
+
+        bool await_suspend(std::coroutine_handle<> parent) {
+            // Run the child inline; it only needs the executor if it blocks
+            child.resume();
+            if (child.done()) return false;
+            node.handle = parent;
+            node.core = this_core();
+            child.promise().waiter = &node;
+            return true;
+        }
+
+        T await_resume() {
+            return child.promise().take();
+        }
+    };
+
+    Awaiter operator co_await() {
+        return Awaiter{handle, {}};
+    }
+};
+
+template <typename T>
+CoTask<T> coro_detail::Promise<T>::get_return_object() {
+    return CoTask<T>(CoTask<T>::Handle::from_promise(*this));
+}
+
+inline CoTask<void> coro_detail::Promise<void>::get_return_object() {
+    return CoTask<void>(CoTask<void>::Handle::from_promise(*this));
+}
+
+// Run task on core's executor (this core when core < 0). The frame is freed
+// when it finishes.
+void coro_spawn(CoTask<void> task, int core = -1);
+
+namespace coro_detail {
+
+extern WaitQueue block_on_waiters;
+
+template <typename T>
+struct Completion {
+    alignas(T) unsigned char storage[sizeof(T)];
+    Atomic<bool> done{false};
+
+    T take() {
+        T* p = (T*)storage;
+        T value = static_cast<T&&>(*p);
+        p->~T();
+        return value;
+    }
+};
+
+template <>
+struct Completion<void> {
+    Atomic<bool> done{false};
+
+    void take() {
+    }
+};
+
+// c lives on the blocked caller's stack: done must be the last thing written
+template <typename T>
+CoTask<void> complete(CoTask<T>& task, Completion<T>& c) {
+    T value = co_await task;
+    new (c.storage) T(static_cast<T&&>(value));
+    c.done.store_release(true);
+    block_on_waiters.wake_all();
+}
+
+CoTask<void> complete(CoTask<void>& task, Completion<void>& c);
+
+}  // namespace coro_detail
+
+// Run task on core's executor and sleep until it has finished. For threads,
+// not coroutines: blocking an executor on its own core would never return.
+template <typename T>
+T block_on(CoTask<T> task, int core = -1) {
+    coro_detail::Completion<T> c;
+    coro_spawn(coro_detail::complete(task, c), core);
+    wait_event(coro_detail::block_on_waiters, [&c] { return c.done.load_acquire(); });
+    return c.take();
+}
+
+// Timer sleeps, on the timer wheel of the coroutine's core
+struct SleepAwaiter {
+    TimerEvent ev;  // must stay first, fired() casts back from it
+    ReadyNode node;
+
+    static void fired(TimerEvent* ev) {
+        coro_post(((SleepAwaiter*)ev)->node);
+    }
+
+    bool await_ready() {
+        return timer_count() >= ev.deadline;
+    }
+
+    void await_suspend(std::coroutine_handle<> h) {
+        node.handle = h;
+        node.core = this_core();
+        ev.fn = fired;
+        timer_add(ev);
+    }
+
+    void await_resume() {
+    }
+};
+
+inline SleepAwaiter co_sleep_until(uint64_t deadline) {
+    SleepAwaiter a;
+    a.ev.deadline = deadline;
+    return a;
+}
+
+inline SleepAwaiter co_sleep_for(uint64_t counts) {
+    return co_sleep_until(timer_count() + counts);
+}
+
+// UART I/O through the UART's rings (uart.h). A coroutine that finds no
+// input, or the TX ring full, parks until the UART interrupt posts it.
+CoTask<char> co_uart_getc();
+CoTask<void> co_uart_write(const char* buf, size_t len);
+
+// Single-producer, single-consumer message channel whose receiver can wait
+// as a coroutine. The sender never blocks: try_send() fails when full.
+template <typename T, uint32_t CAPACITY>
+class AsyncChannel {
+    SPSCChannel<T, CAPACITY> ch;
+    ReadyNode* receiver = nullptr;  // parked on an empty channel
+
+   public:
+    constexpr AsyncChannel() {
+    }
+
+    AsyncChannel(const AsyncChannel&) = delete;
+
+    bool try_send(const T& value) {
+        if (!ch.try_send(value)) return false;
+        // Pairs with the fence in RecvAwaiter: either we see the receiver,
+        // or it sees the message before it parks
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        ReadyNode* r = __atomic_exchange_n(&receiver, (ReadyNode*)nullptr, __ATOMIC_ACQ_REL);
+        if (r) coro_post(*r);
+        return true;
+    }
+
+    struct RecvAwaiter {
+        AsyncChannel& c;
+        ReadyNode node;
+        T value;
+        bool have = false;
+
+        bool await_ready() {
+            have = c.ch.try_recv(value);
+            return have;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            node.handle = h;
+            node.core = this_core();
+            __atomic_store_n(&c.receiver, &node, __ATOMIC_RELEASE);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (!c.ch.empty()) {
+                // A message raced in. Park only if the sender already took
+                // us off and is going to post us.
+                return __atomic_exchange_n(&c.receiver, (ReadyNode*)nullptr, __ATOMIC_ACQ_REL) !=
+                       &node;
+            }
+            return true;
+        }
+
+        T await_resume() {
+            if (!have) c.ch.try_recv(value);
+            return static_cast<T&&>(value);
+        }
+    };
+
+    // Next message, waiting for one if the channel is empty
+    RecvAwaiter recv() {
+        return RecvAwaiter{*this, {}, T(), false};
+    }
+};
+
+#endif  // _CORO_H_
@@ -0,0 +1,103 @@
+#ifndef _COROUTINE_H_
+#define _COROUTINE_H_
+
+/*
+ * The parts of <coroutine> the compiler needs, for a freestanding build.
+ *
+ * GCC looks these names up in namespace std when it lowers a coroutine, so
+ * they have to live there even though nothing else here does. The handles
+ * are thin wrappers around the __builtin_coro_* intrinsics, the same way
+ * libstdc++ implements them.
+ */
+
+namespace std {
+
+template <typename R, typename... Args>
+struct coroutine_traits {
+    using promise_type = typename R::promise_type;
+};
+
+template <typename Promise = void>
+struct coroutine_handle;
+
+template <>
+struct coroutine_handle<void> {
+    constexpr coroutine_handle() noexcept : ptr(0) {
+    }
+
+    static coroutine_handle from_address(void* addr) noexcept {
+        coroutine_handle h;
+        h.ptr = addr;
+        return h;
+    }
+
+    void* address() const noexcept {
+        return ptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return ptr != 0;
+    }
+
+    bool done() const noexcept {
+        return __builtin_coro_done(ptr);
+    }
+
+    void operator()() const {
+        resume();
+    }
+
+    void resume() const {
+        __builtin_coro_resume(ptr);
+    }
+
+    void destroy() const {
+        __builtin_coro_destroy(ptr);
+    }
+
+   protected:
+    void* ptr;
+};
+
+template <typename Promise>
+struct coroutine_handle : coroutine_handle<void> {
+    static coroutine_handle from_address(void* addr) noexcept {
+        coroutine_handle h;
+        h.ptr = addr;
+        return h;
+    }
+
+    static coroutine_handle from_promise(Promise& p) noexcept {
+        coroutine_handle h;
+        h.ptr = __builtin_coro_promise((char*)&p, __alignof(Promise), true);
+        return h;
+    }
+
+    Promise& promise() const {
+        return *static_cast<Promise*>(__builtin_coro_promise(ptr, __alignof(Promise), false));
+    }
+};
+
+struct suspend_always {
+    constexpr bool await_ready() const noexcept {
+        return false;
+    }
+    constexpr void await_suspend(coroutine_handle<>) const noexcept {
+    }
+    constexpr void await_resume() const noexcept {
+    }
+};
+
+struct suspend_never {
+    constexpr bool await_ready() const noexcept {
+        return true;
+    }
+    constexpr void await_suspend(coroutine_handle<>) const noexcept {
+    }
+    constexpr void await_resume() const noexcept {
+    }
+};
+
+}  // namespace std
+
+#endif  // _COROUTINE_H_
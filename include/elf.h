@@ -0,0 +1,52 @@
+#ifndef _ELF_H_
+#define _ELF_H_
+
+#include "stdint.h"
+
+// The parts of the ELF64 format the process loader reads
+
+static constexpr uint8_t ELFMAG[4] = {0x7f, 'E', 'L', 'F'};
+static constexpr uint8_t ELFCLASS64 = 2;
+static constexpr uint8_t ELFDATA2LSB = 1;
+static constexpr uint16_t ET_EXEC = 2;
+static constexpr uint16_t EM_AARCH64 = 183;
+
+static constexpr uint32_t PT_LOAD = 1;
+
+// Segment permissions (p_flags)
+static constexpr uint32_t PF_X = 1;
+static constexpr uint32_t PF_W = 2;
+static constexpr uint32_t PF_R = 4;
+
+struct Elf64_Ehdr {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+};
+
+struct Elf64_Phdr {
+    uint32_t p_type;
+    uint32_t p_flags;
+    uint64_t p_offset;
+    uint64_t p_vaddr;
+    uint64_t p_paddr;
+    uint64_t p_filesz;
+    uint64_t p_memsz;
+    uint64_t p_align;
+};
+
+static_assert(sizeof(Elf64_Ehdr) == 64, "ELF64 header is 64 bytes");
+static_assert(sizeof(Elf64_Phdr) == 56, "ELF64 program header is 56 bytes");
+
+#endif  // _ELF_H_
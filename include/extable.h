@@ -0,0 +1,48 @@
+#ifndef _EXTABLE_H_
+#define _EXTABLE_H_
+
+/*
+ * Exception fixup table.
+ *
+ * Code that may fault on purpose (user copies, probes) tags each such load
+ * or store with the address to resume at instead. The entries are collected
+ * in the __ex_table section, sorted once at boot and binary searched by the
+ * EL1 data abort handler: a fault at a listed PC returns to its fixup, any
+ * other one is fatal as before. The faulting access itself costs nothing
+ * extra, so the tagged code needs no checks up front.
+ */
+
+#ifdef __ASSEMBLER__
+
+// Resume at fixup if the instruction at insn faults
+.macro	extable insn, fixup
+	.pushsection __ex_table, "a"
+	.balign	8
+	.quad	\insn, \fixup
+	.popsection
+	.endm
+
+#else
+
+#include "stdint.h"
+
+struct TrapFrame;
+
+struct ExTableEntry {
+    uint64_t insn;
+    uint64_t fixup;
+};
+
+// Sort the table; boot core, before anything may fault on purpose
+void extable_init();
+
+// The fixup for a fault at pc, or 0
+uint64_t search_extable(uint64_t pc);
+
+// Called for EL1 data aborts: point f->elr at the fixup and return true,
+// or return false if the fault was not expected
+extern "C" bool fixup_exception(TrapFrame* f);
+
+#endif  // __ASSEMBLER__
+
+#endif  // _EXTABLE_H_
@@ -0,0 +1,59 @@
+#ifndef _FPSIMD_H_
+#define _FPSIMD_H_
+
+#include "stdint.h"
+
+/*
+ * Lazy FP/SIMD context switching.
+ *
+ * The scheduler never saves V registers on a switch. Each core remembers
+ * which thread's state is live in its register file (the owner) and sets
+ * CPACR_EL1.FPEN to trap FP/SIMD use by anyone else. The first FP
+ * instruction a different thread executes raises EC 0x07; the handler saves
+ * the owner's registers, loads the new thread's and re-runs the instruction.
+ * Threads that never touch FP/SIMD never pay for it.
+ *
+ * Kernel C and C++ code is built -mgeneral-regs-only, so the trap handler,
+ * the switch path and exception entry, which saves no FP/SIMD state,
+ * cannot clobber or fault on it. Only switch.S touches those registers.
+ */
+
+struct Thread;
+
+// Full register file; layout is shared with switch.S
+struct alignas(16) FpSimdState {
+    uint64_t v[64];
+    uint32_t fpsr;
+    uint32_t fpcr;
+};
+
+extern "C" void fpsimd_save(FpSimdState* state);
+extern "C" void fpsimd_restore(const FpSimdState* state);
+
+// Start trapping FP/SIMD on this core
+void fpsimd_init();
+
+// Called by schedule() before switching to next: untrap FP/SIMD only if
+// next's state is already live in the registers
+void fpsimd_switch_to(Thread* next);
+
+// Forget t's state; called before a thread's memory is released
+void fpsimd_thread_exit(Thread* t);
+
+// Synchronous exception handler for EC 0x07 (from EL0 or EL1)
+extern "C" void fpsimd_trap_handler();
+
+struct FpSimdStats {
+    uint64_t traps;
+    uint64_t saves;
+    uint64_t restores;
+};
+
+FpSimdStats fpsimd_stats(uint32_t core);
+
+// Write/read v16 directly, so tests and benchmarks can give a thread live
+// FP/SIMD state without relying on what the compiler emits
+extern "C" void fpsimd_probe_write(uint64_t value);
+extern "C" uint64_t fpsimd_probe_read();
+
+#endif // _FPSIMD_H_
@@ -15,6 +15,11 @@ void* kmalloc(size_t size);
 // Deallocate previously allocated memory
 void kfree(void* ptr);
 
+// Allocate with a power-of-two alignment larger than the default 16 bytes
+// (e.g. cache-line aligned objects). Free with kfree_aligned.
+void* kmalloc_aligned(size_t size, size_t align);
+void kfree_aligned(void* ptr);
+
 // Optionally expand the heap by at least min_bytes; returns number of bytes added
 size_t heap_expand(size_t min_bytes);
 
@@ -38,6 +43,17 @@ void operator delete[](void* ptr);
 void operator delete(void* ptr, unsigned long size);
 void operator delete[](void* ptr, unsigned long size);
 
+// Aligned new/delete, used by the compiler for over-aligned types
+namespace std {
+enum class align_val_t : __SIZE_TYPE__ {};
+}
+void* operator new(unsigned long size, std::align_val_t align);
+void* operator new[](unsigned long size, std::align_val_t align);
+void operator delete(void* ptr, std::align_val_t align);
+void operator delete[](void* ptr, std::align_val_t align);
+void operator delete(void* ptr, unsigned long size, std::align_val_t align);
+void operator delete[](void* ptr, unsigned long size, std::align_val_t align);
+
 // Placement new (already defined by compiler, but declared for completeness)
 inline void* operator new(unsigned long, void* ptr) { return ptr; }
 inline void* operator new[](unsigned long, void* ptr) { return ptr; }
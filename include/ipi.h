@@ -0,0 +1,61 @@
+#ifndef _IPI_H_
+#define _IPI_H_
+
+#include "stdint.h"
+
+/*
+ * Inter-processor interrupts over the BCM2836 local mailboxes.
+ *
+ * Every core listens on its mailbox 0. Each IPI type is one bit of that
+ * mailbox: senders OR their bit in through the set register, and the target
+ * reads and clears the whole word in its IRQ handler. Several sends of the
+ * same type before the target gets to run coalesce into one delivery, so a
+ * type never carries a payload of its own; call requests and TLB flush
+ * generations live in memory and the bit only says "go look".
+ *
+ * Anything that waits for another core (smp_call_function*, the TLB
+ * shootdown) must be called with IRQs enabled and outside IRQ context:
+ * two cores waiting on each other with IRQs masked would never return.
+ */
+
+// Mailbox each core listens on
+static constexpr uint32_t IPI_MBOX = 0;
+
+enum class IpiType : uint32_t {
+    Reschedule,    // run the scheduler on the way out of the IRQ
+    TlbFlush,      // invalidate the local TLB and acknowledge
+    CallFunction,  // run queued smp_call_function requests
+    Count,
+};
+
+static constexpr uint32_t IPI_TYPES = (uint32_t)IpiType::Count;
+
+// Unmask this core's mailbox interrupt; called once per core before its IRQs
+// are enabled
+void ipi_init();
+
+// Raise type on core. Writes made before the call are visible to the handler.
+void ipi_send(uint32_t core, IpiType type);
+
+// Raise type on every core but the caller
+void ipi_broadcast(IpiType type);
+
+// Run fn(arg) on core and wait for it to finish. fn runs in IRQ context on
+// the target and must not block. Runs fn directly when core is the caller.
+void smp_call_function_single(uint32_t core, void (*fn)(void*), void* arg);
+
+// Run fn(arg) on every other core and wait for all of them to finish
+void smp_call_function(void (*fn)(void*), void* arg);
+
+// Run fn(arg) on every core in mask (bit n for core n) in parallel and wait
+// for all of them. The caller's own bit runs it directly, with IRQs masked
+// like everywhere else, while the others are busy.
+void smp_call_function_mask(uint32_t mask, void (*fn)(void*), void* arg);
+
+// Invalidate the TLB on every core, returning once all have done so
+void smp_flush_tlb_all();
+
+// IPIs of type this core has handled
+uint64_t ipi_received(uint32_t core, IpiType type);
+
+#endif // _IPI_H_
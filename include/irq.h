@@ -0,0 +1,99 @@
+#ifndef _IRQ_H_
+#define _IRQ_H_
+
+#include "stdint.h"
+
+/*
+ * Interrupt controllers and the IRQ dispatch table.
+ *
+ * Two controllers feed each core's IRQ line. The BCM2836 local controller
+ * has per-core sources (the generic timers, the four mailboxes, the PMU)
+ * plus one line, IRQ_SRC_GPU, for everything behind the BCM2835 ARM
+ * controller: the GPU peripherals (UART, GPIO, DMA, ...) and the basic ARM
+ * ones. Both are folded into one flat numbering:
+ *
+ *   0-63    GPU peripherals, as in the BCM2835 manual (IRQ_PL011 = 57)
+ *   64-71   basic ARM peripherals (ARM timer, mailbox, doorbells, ...)
+ *   72-83   local sources, bit n of CORE_IRQ_SOURCE is IRQ_LOCAL_BASE + n
+ *
+ * handle_irq() reads CORE_IRQ_SOURCE and walks its set bits lowest first
+ * (rbit + clz, not a loop over every bit), so the timer goes before the
+ * mailboxes and the GPU line. The GPU line is decoded the same way from the
+ * ARM controller's pending registers.
+ *
+ * Handlers run in hardirq context with IRQs masked on the core the IRQ was
+ * routed to. They should clear the device condition and leave the rest to a
+ * softirq or tasklet. Every dispatch is counted per IRQ and core.
+ *
+ * Routing is as fine as the hardware allows: per-core sources always fire
+ * on the core that enabled them, while all of the GPU/ARM interrupts share
+ * one routing register and so move between cores together.
+ */
+
+static constexpr uint32_t IRQ_GPU_BASE = 0;
+static constexpr uint32_t IRQ_ARM_BASE = 64;
+static constexpr uint32_t IRQ_LOCAL_BASE = 72;
+static constexpr uint32_t IRQ_COUNT = 84;
+
+// GPU peripherals
+static constexpr uint32_t IRQ_AUX = IRQ_GPU_BASE + 29;    // mini UART, SPI1/2
+static constexpr uint32_t IRQ_GPIO0 = IRQ_GPU_BASE + 49;
+static constexpr uint32_t IRQ_PL011 = IRQ_GPU_BASE + 57;  // UART0
+
+// Basic ARM peripherals
+static constexpr uint32_t IRQ_ARM_TIMER = IRQ_ARM_BASE + 0;
+static constexpr uint32_t IRQ_ARM_MAILBOX = IRQ_ARM_BASE + 1;
+
+// Per-core sources of the local controller
+static constexpr uint32_t IRQ_LOCAL_CNTPS = IRQ_LOCAL_BASE + 0;
+static constexpr uint32_t IRQ_LOCAL_CNTPNS = IRQ_LOCAL_BASE + 1;
+static constexpr uint32_t IRQ_LOCAL_CNTHP = IRQ_LOCAL_BASE + 2;
+static constexpr uint32_t IRQ_LOCAL_CNTV = IRQ_LOCAL_BASE + 3;
+static constexpr uint32_t IRQ_LOCAL_GPU = IRQ_LOCAL_BASE + 8;  // decoded further, never dispatched
+static constexpr uint32_t IRQ_LOCAL_PMU = IRQ_LOCAL_BASE + 9;
+static constexpr uint32_t IRQ_LOCAL_TIMER = IRQ_LOCAL_BASE + 11;
+
+static constexpr uint32_t irq_local_mailbox(uint32_t n) {
+    return IRQ_LOCAL_BASE + 4 + n;
+}
+
+using IrqHandler = void (*)(void* ctx);
+
+// Mask every GPU/ARM interrupt and route them to core 0. Called once by the
+// boot core before any other core enables IRQs.
+void irq_init();
+
+// Install handler(ctx) for irq and, for GPU/ARM interrupts, enable it.
+// Returns false if irq is out of range or already has another handler;
+// installing the same handler and ctx again succeeds, so per-core setup can
+// call it on every core. Per-core sources still need enable_irq() on each
+// core that wants them.
+bool request_irq(uint32_t irq, IrqHandler handler, void* ctx);
+
+// Disable irq and remove its handler. A dispatch already running on another
+// core may still be finishing when this returns.
+void free_irq(uint32_t irq);
+
+// Unmask/mask irq at its controller: for per-core sources on the calling
+// core only. Safe with IRQs enabled.
+void enable_irq(uint32_t irq);
+void disable_irq(uint32_t irq);
+
+// Route irq to core. GPU/ARM interrupts all move together; the per-core
+// sources can't be moved and return false.
+bool irq_set_affinity(uint32_t irq, uint32_t core);
+
+// Decode this core's pending sources and run their handlers; called from
+// handle_irq with IRQs masked. entry is the counter at the vector.
+void irq_dispatch(uint64_t entry);
+
+// In a handler: cntvct_el0 as it was at the top of the IRQ vector
+uint64_t irq_entry_count();
+
+// Times irq has been dispatched on core, handled or not
+uint64_t irq_count(uint32_t irq, uint32_t core);
+
+// Print every IRQ with a handler or a nonzero count, per core
+void irq_stats_dump();
+
+#endif  // _IRQ_H_
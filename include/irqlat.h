@@ -0,0 +1,83 @@
+#ifndef _IRQLAT_H_
+#define _IRQLAT_H_
+
+#include "stdint.h"
+
+/*
+ * IRQ latency and jitter harness.
+ *
+ * The calling core arms its EL1 physical timer (CNTP; the kernel's own
+ * timers all run on CNTV) for a known deadline and spins, IRQs on and
+ * preemption off, until the IRQ has come and gone. Each round records how
+ * long after the deadline the core got to
+ *
+ *   entry    the top of the IRQ vector (irq_entry_count())
+ *   handler  the first instruction of the CNTP handler: frame saved and the
+ *            controllers decoded
+ *   resume   the interrupted loop again: softirqs run and eret done
+ *
+ * CNTVOFF_EL2 is zero (boot.S), so the physical compare value and the
+ * virtual counter every stage is read from count the same time.
+ *
+ * The deadline moves around from round to round so it does not keep landing
+ * at one phase of the tick or of whatever load runs elsewhere.
+ * irq_latency_load() provides that load: kmalloc/kfree churn or printf
+ * output on other cores, until told to stop.
+ *
+ * Samples go into log-linear histograms, 32 buckets per power of two, so a
+ * percentile is exact below 64 counts and within 1/32 above.
+ * irq_latency_report() prints one line per stage, like
+ * BenchFramework::report():
+ *
+ *   IRQLAT <name> core=<id> stage=<stage> n=<n> min=<ns> p50=<ns> p99=<ns> max=<ns>
+ */
+
+static constexpr uint32_t LAT_SUB_BUCKETS = 32;
+// Up to 2^28 counts (4s at 62.5MHz); anything longer counts as the last bucket
+static constexpr uint32_t LAT_BUCKETS = 24 * LAT_SUB_BUCKETS;
+
+struct LatencyHist {
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint32_t buckets[LAT_BUCKETS];
+
+    void reset();
+    void add(uint64_t v);
+
+    // The pct-th percentile (0-100), rounded down to its bucket
+    uint64_t percentile(uint32_t pct) const;
+};
+
+enum class IrqLatStage : uint32_t {
+    Entry,
+    Handler,
+    Resume,
+    Count,
+};
+
+struct IrqLatency {
+    LatencyHist stages[(uint32_t)IrqLatStage::Count];
+
+    const LatencyHist& operator[](IrqLatStage s) const {
+        return stages[(uint32_t)s];
+    }
+};
+
+enum class IrqLoad : uint32_t {
+    None,
+    Heap,    // kmalloc/kfree of random sizes
+    Printf,  // console output
+};
+
+// Measure rounds IRQs on the calling core into lat, in timer counts. Uses
+// this core's CNTP only, so every core can measure at once.
+void irq_latency_run(IrqLatency& lat, uint32_t rounds);
+
+// Keep the calling core busy with load until *stop is set
+void irq_latency_load(IrqLoad load, const volatile bool* stop);
+
+// Print lat's stages in ns, in the IRQLAT form above
+void irq_latency_report(const char* name, const IrqLatency& lat);
+
+#endif  // _IRQLAT_H_
@@ -0,0 +1,311 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include "core.h"
+#include "heap.h"
+#include "printf.h"
+#include "stdint.h"
+#include "workpool.h"
+
+/*
+ * Parallel algorithms over random-access ranges, built on the work pool.
+ *
+ *   par::for_each(a, a + n, [](uint32_t& x) { x *= 2; });
+ *   uint64_t sum = par::reduce(a, a + n, (uint64_t)0, [](uint64_t s, uint32_t x) { return s + x; });
+ *   par::inclusive_scan(a, a + n, out, [](uint32_t s, uint32_t x) { return s + x; });
+ *   par::sort(a, a + n);
+ *
+ * Work is split by a PartitionPolicy into chunks that are spawned as pool
+ * tasks from the calling core. The other cores only help if they are in the
+ * pool (WorkPool::start() or WorkPool::work_until()); otherwise the caller
+ * runs every chunk itself, which is still correct. Inputs of at most
+ * policy.grain elements, or PAR_SEQUENTIAL, skip the pool entirely.
+ *
+ * Iterators only need *, +, - and ++, so plain pointers are the usual
+ * choice. reduce and inclusive_scan combine chunks out of order, so op must
+ * be associative. Value types must be default-constructible and assignable.
+ * Thread context only: tasks can run on any core and the caller waits.
+ */
+
+struct PartitionPolicy {
+    size_t grain;     // at most this many elements run sequentially
+    uint32_t chunks;  // split into at most this many pieces
+};
+
+static constexpr uint32_t PAR_MAX_CHUNKS = 64;
+
+// A few chunks per core so stealing can even out uneven ones
+static constexpr PartitionPolicy PAR_DEFAULT = {4096, CORE_COUNT * 4};
+static constexpr PartitionPolicy PAR_SEQUENTIAL = {(size_t)-1, 1};
+
+namespace par_detail {
+
+template <typename T>
+T&& declval();
+
+template <typename T>
+struct Bare {
+    using Type = T;
+};
+template <typename T>
+struct Bare<T&> : Bare<T> {};
+template <typename T>
+struct Bare<const T> : Bare<T> {};
+
+template <typename It>
+using ValueOf = typename Bare<decltype(*declval<It>())>::Type;
+
+// Runs with at most this many elements are insertion sorted
+static constexpr size_t INSERTION_SORT_MAX = 32;
+
+inline uint32_t chunk_count(size_t n, const PartitionPolicy& policy) {
+    if (n <= policy.grain) return 1;
+    size_t k = n / policy.grain;
+    if (k > policy.chunks) k = policy.chunks;
+    if (k > PAR_MAX_CHUNKS) k = PAR_MAX_CHUNKS;
+    return k ? (uint32_t)k : 1;
+}
+
+// Element offset where chunk i of k starts
+inline size_t chunk_start(size_t n, uint32_t i, uint32_t k) {
+    return n * i / k;
+}
+
+// Run left as a pool task and right here, returning once both are done
+template <typename L, typename R>
+void fork_join(L left, R right) {
+    TaskGroup g;
+    auto t = make_task(left);
+    g.spawn(t);
+    right();
+    g.sync();
+}
+
+// fn(i) for every chunk index in [lo, hi), halving the range at each level
+template <typename F>
+void for_chunks(uint32_t lo, uint32_t hi, F& fn) {
+    if (hi - lo == 1) {
+        fn(lo);
+        return;
+    }
+    uint32_t mid = lo + (hi - lo) / 2;
+    fork_join([&fn, lo, mid] { for_chunks(lo, mid, fn); }, [&fn, mid, hi] { for_chunks(mid, hi, fn); });
+}
+
+template <typename It, typename T, typename Op>
+T fold(It first, It last, T acc, Op& op) {
+    for (; first != last; ++first) acc = op(acc, *first);
+    return acc;
+}
+
+template <typename It, typename Cmp>
+void insertion_sort(It a, size_t n, Cmp& cmp) {
+    using T = ValueOf<It>;
+    for (size_t i = 1; i < n; i++) {
+        T v = static_cast<T&&>(a[i]);
+        size_t j = i;
+        for (; j > 0 && cmp(v, a[j - 1]); j--) a[j] = static_cast<T&&>(a[j - 1]);
+        a[j] = static_cast<T&&>(v);
+    }
+}
+
+// First position in x whose element does not go before v: for lower (x
+// elements equal to v go after it) or upper (they go before it)
+template <typename It, typename T, typename Cmp>
+size_t bound(It x, size_t n, const T& v, Cmp& cmp, bool upper) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        bool before = upper ? !cmp(v, x[mid]) : cmp(x[mid], v);
+        if (before) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Stable merge of x (the earlier run) and y into out. While the split budget
+// lasts, the longer run is halved around its middle element and the two
+// halves are merged in parallel.
+template <typename X, typename Y, typename Out, typename Cmp>
+void merge(X x, size_t nx, Y y, size_t ny, Out out, Cmp& cmp, size_t grain, uint32_t split) {
+    if (split <= 1 || nx + ny <= grain) {
+        size_t i = 0, j = 0;
+        while (i < nx && j < ny) {
+            if (cmp(y[j], x[i])) {
+                *out = static_cast<ValueOf<Y>&&>(y[j++]);
+            } else {
+                *out = static_cast<ValueOf<X>&&>(x[i++]);
+            }
+            ++out;
+        }
+        for (; i < nx; ++out) *out = static_cast<ValueOf<X>&&>(x[i++]);
+        for (; j < ny; ++out) *out = static_cast<ValueOf<Y>&&>(y[j++]);
+        return;
+    }
+    size_t mx, my;
+    if (nx >= ny) {
+        mx = nx / 2;
+        my = bound(y, ny, x[mx], cmp, false);
+    } else {
+        my = ny / 2;
+        mx = bound(x, nx, y[my], cmp, true);
+    }
+    fork_join([=, &cmp] { merge(x, mx, y, my, out, cmp, grain, split / 2); },
+              [=, &cmp] { merge(x + mx, nx - mx, y + my, ny - my, out + (mx + my), cmp, grain, split / 2); });
+}
+
+template <typename It, typename T, typename Cmp>
+void sort_to(It a, T* tmp, size_t n, Cmp& cmp, size_t grain, uint32_t split);
+
+// Merge sort a[0, n) in place, with tmp[0, n) as scratch
+template <typename It, typename T, typename Cmp>
+void sort_in_place(It a, T* tmp, size_t n, Cmp& cmp, size_t grain, uint32_t split) {
+    if (n <= INSERTION_SORT_MAX) {
+        insertion_sort(a, n, cmp);
+        return;
+    }
+    size_t h = n / 2;
+    if (split > 1 && n > grain) {
+        fork_join([=, &cmp] { sort_to(a, tmp, h, cmp, grain, split / 2); },
+                  [=, &cmp] { sort_to(a + h, tmp + h, n - h, cmp, grain, split / 2); });
+    } else {
+        sort_to(a, tmp, h, cmp, grain, 1);
+        sort_to(a + h, tmp + h, n - h, cmp, grain, 1);
+    }
+    merge(tmp, h, tmp + h, n - h, a, cmp, grain, split);
+}
+
+// Sort a[0, n) leaving the result in tmp[0, n); a is clobbered
+template <typename It, typename T, typename Cmp>
+void sort_to(It a, T* tmp, size_t n, Cmp& cmp, size_t grain, uint32_t split) {
+    if (n <= INSERTION_SORT_MAX) {
+        insertion_sort(a, n, cmp);
+        for (size_t i = 0; i < n; i++) tmp[i] = static_cast<T&&>(a[i]);
+        return;
+    }
+    size_t h = n / 2;
+    if (split > 1 && n > grain) {
+        fork_join([=, &cmp] { sort_in_place(a, tmp, h, cmp, grain, split / 2); },
+                  [=, &cmp] { sort_in_place(a + h, tmp + h, n - h, cmp, grain, split / 2); });
+    } else {
+        sort_in_place(a, tmp, h, cmp, grain, 1);
+        sort_in_place(a + h, tmp + h, n - h, cmp, grain, 1);
+    }
+    merge(a, h, a + h, n - h, tmp, cmp, grain, split);
+}
+
+struct Less {
+    template <typename T>
+    bool operator()(const T& a, const T& b) const {
+        return a < b;
+    }
+};
+
+}  // namespace par_detail
+
+namespace par {
+
+// fn(x) for every element, chunks in parallel
+template <typename It, typename Fn>
+void for_each(It first, It last, Fn fn, const PartitionPolicy& policy = PAR_DEFAULT) {
+    size_t n = last - first;
+    if (n == 0) return;
+    uint32_t k = par_detail::chunk_count(n, policy);
+    auto chunk = [&](uint32_t i) {
+        It end = first + par_detail::chunk_start(n, i + 1, k);
+        for (It it = first + par_detail::chunk_start(n, i, k); it != end; ++it) fn(*it);
+    };
+    par_detail::for_chunks(0, k, chunk);
+}
+
+// init combined with every element by op, which must be associative
+template <typename It, typename T, typename Op>
+T reduce(It first, It last, T init, Op op, const PartitionPolicy& policy = PAR_DEFAULT) {
+    size_t n = last - first;
+    uint32_t k = par_detail::chunk_count(n, policy);
+    if (k == 1) return par_detail::fold(first, last, init, op);
+
+    // Chunks are never empty, so each starts from its own first element
+    T partial[PAR_MAX_CHUNKS];
+    auto chunk = [&](uint32_t i) {
+        It begin = first + par_detail::chunk_start(n, i, k);
+        It end = first + par_detail::chunk_start(n, i + 1, k);
+        partial[i] = par_detail::fold(begin + 1, end, T(*begin), op);
+    };
+    par_detail::for_chunks(0, k, chunk);
+    return par_detail::fold(partial, partial + k, init, op);
+}
+
+// out[i] = in[0] op ... op in[i]; out may be first. Returns the end of out.
+//
+// Two passes: every chunk but the last is reduced in parallel, a short
+// sequential scan over the chunk totals gives each chunk its carry-in, then
+// every chunk is scanned in parallel starting from its carry.
+template <typename It, typename Out, typename Op>
+Out inclusive_scan(It first, It last, Out out, Op op, const PartitionPolicy& policy = PAR_DEFAULT) {
+    using T = par_detail::ValueOf<It>;
+    size_t n = last - first;
+    if (n == 0) return out;
+    uint32_t k = par_detail::chunk_count(n, policy);
+    if (k == 1) {
+        T acc = *first;
+        *out = acc;
+        for (size_t i = 1; i < n; i++) {
+            acc = op(acc, first[i]);
+            out[i] = acc;
+        }
+        return out + n;
+    }
+
+    T carry[PAR_MAX_CHUNKS];
+    auto total = [&](uint32_t i) {
+        It begin = first + par_detail::chunk_start(n, i, k);
+        It end = first + par_detail::chunk_start(n, i + 1, k);
+        carry[i + 1] = par_detail::fold(begin + 1, end, T(*begin), op);
+    };
+    par_detail::for_chunks(0, k - 1, total);
+    for (uint32_t i = 2; i < k; i++) carry[i] = op(carry[i - 1], carry[i]);
+
+    auto scan = [&](uint32_t i) {
+        size_t begin = par_detail::chunk_start(n, i, k);
+        size_t end = par_detail::chunk_start(n, i + 1, k);
+        T acc = i ? op(carry[i], first[begin]) : T(first[begin]);
+        out[begin] = acc;
+        for (size_t j = begin + 1; j < end; j++) {
+            acc = op(acc, first[j]);
+            out[j] = acc;
+        }
+    };
+    par_detail::for_chunks(0, k, scan);
+    return out + n;
+}
+
+// Stable merge sort by cmp (a strict weak order). Halves are sorted and
+// merged in parallel down to policy.grain elements; needs a scratch buffer
+// as large as the input from the heap.
+template <typename It, typename Cmp>
+void sort(It first, It last, Cmp cmp, const PartitionPolicy& policy = PAR_DEFAULT) {
+    using T = par_detail::ValueOf<It>;
+    size_t n = last - first;
+    if (n <= par_detail::INSERTION_SORT_MAX) {
+        par_detail::insertion_sort(first, n, cmp);
+        return;
+    }
+    T* tmp = new T[n];
+    if (!tmp) panic("par::sort: no memory for %llu elements", (uint64_t)n);
+    uint32_t split = n > policy.grain ? policy.chunks : 1;
+    par_detail::sort_in_place(first, tmp, n, cmp, policy.grain, split);
+    delete[] tmp;
+}
+
+template <typename It>
+void sort(It first, It last, const PartitionPolicy& policy = PAR_DEFAULT) {
+    sort(first, last, par_detail::Less(), policy);
+}
+
+}  // namespace par
+
+#endif  // _PARALLEL_H_
@@ -1,15 +1,71 @@
+#ifndef _PERCPU_H_
+#define _PERCPU_H_
+
+#include "core.h"
+#include "stdint.h"
 #include "utils.h"
 
+// Id of the calling core. boot.S stores it in TPIDR_EL1 on every core, so
+// this is a single register read rather than a call into getCoreID.
+static inline uint32_t this_core() {
+    uint64_t id;
+    asm volatile("mrs %0, tpidr_el1" : "=r"(id));
+    return (uint32_t)id;
+}
+
+// One T per core. Each slot is padded to its own cache line so that a core
+// updating its value never invalidates another core's copy.
 template<class T>
 class PerCPU {
 private:
-    T data[4];
+    struct alignas(CACHE_LINE_SIZE) Slot {
+        T value;
+    };
+    Slot data[CORE_COUNT];
 public:
     inline T& forCPU(int id) {
-        return data[id];
+        return data[id].value;
     }
 
     inline T& mine() {
-        return forCPU(getCoreID());
+        return forCPU(this_core());
+    }
+};
+
+// Statistics counter that each core bumps locally without atomics; readers
+// fold all cores' slots together. Updates from IRQ handlers must use a
+// separate counter (or mask IRQs) since add() is a plain read-modify-write.
+template<typename T = uint64_t>
+class PerCPUCounter {
+private:
+    PerCPU<T> counts;
+public:
+    inline void add(T n) {
+        T& mine = counts.mine();
+        __atomic_store_n(&mine, __atomic_load_n(&mine, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+    }
+
+    inline void inc() {
+        add(1);
     }
-};
\ No newline at end of file
+
+    inline T forCPU(int id) {
+        return __atomic_load_n(&counts.forCPU(id), __ATOMIC_RELAXED);
+    }
+
+    T sum() {
+        T total = 0;
+        for (int id = 0; id < CORE_COUNT; id++) {
+            total += forCPU(id);
+        }
+        return total;
+    }
+
+    void reset() {
+        for (int id = 0; id < CORE_COUNT; id++) {
+            __atomic_store_n(&counts.forCPU(id), (T)0, __ATOMIC_RELAXED);
+        }
+    }
+};
+
+#endif // _PERCPU_H_
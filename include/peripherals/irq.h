@@ -0,0 +1,28 @@
+#ifndef _P_IRQ_H
+#define _P_IRQ_H
+
+#include "vm.h"
+
+// BCM2835 ARM interrupt controller (bus address 0x7E00B200). All of its
+// interrupts reach the cores as one source, IRQ_SRC_GPU, on whichever core
+// GPU_INT_ROUTING selects.
+#define ARMC_BASE                   (VA_START | 0x3F00B000)
+
+#define IRQ_BASIC_PENDING           ((volatile unsigned int*)(ARMC_BASE + 0x200))
+#define IRQ_PENDING_1               ((volatile unsigned int*)(ARMC_BASE + 0x204))
+#define IRQ_PENDING_2               ((volatile unsigned int*)(ARMC_BASE + 0x208))
+#define FIQ_CONTROL                 ((volatile unsigned int*)(ARMC_BASE + 0x20C))
+#define ENABLE_IRQS_1               ((volatile unsigned int*)(ARMC_BASE + 0x210))
+#define ENABLE_IRQS_2               ((volatile unsigned int*)(ARMC_BASE + 0x214))
+#define ENABLE_BASIC_IRQS           ((volatile unsigned int*)(ARMC_BASE + 0x218))
+#define DISABLE_IRQS_1              ((volatile unsigned int*)(ARMC_BASE + 0x21C))
+#define DISABLE_IRQS_2              ((volatile unsigned int*)(ARMC_BASE + 0x220))
+#define DISABLE_BASIC_IRQS          ((volatile unsigned int*)(ARMC_BASE + 0x224))
+
+// IRQ_BASIC_PENDING: bits 0-7 are the ARM peripheral interrupts, bits 8/9
+// summarise pending registers 1/2, bits 10-20 repeat a few GPU interrupts
+// (which then don't show up in the summary bits)
+#define BASIC_ARM_MASK              0xFF
+#define BASIC_GPU_MASK              0x1FFF00
+
+#endif  /*_P_IRQ_H */
@@ -0,0 +1,55 @@
+#ifndef _P_LOCAL_INTC_H
+#define _P_LOCAL_INTC_H
+
+#include "vm.h"
+
+// BCM2836 per-core interrupt controller ("ARM local peripherals" at 0x40000000)
+#define LOCAL_INTC_BASE             (VA_START | 0x40000000)
+
+#define LOCAL_CONTROL               ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x00))
+#define LOCAL_PRESCALER             ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x08))
+#define GPU_INT_ROUTING             ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x0C))
+#define PMU_ROUTING_SET             ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x10))
+#define PMU_ROUTING_CLR             ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x14))
+#define LOCAL_TIMER_ROUTING         ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x24))
+#define CORE_TIMER_IRQCNTL(core)    ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x40 + 4 * (core)))
+#define CORE_MAILBOX_IRQCNTL(core)  ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x50 + 4 * (core)))
+#define CORE_IRQ_SOURCE(core)       ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x60 + 4 * (core)))
+#define CORE_FIQ_SOURCE(core)       ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x70 + 4 * (core)))
+
+// Four 32-bit mailboxes per core. Writing the set register ORs bits in,
+// writing the read/clear register clears the bits written; any set bit
+// raises the mailbox interrupt on the owning core.
+#define CORE_MBOX_SET(core, n)      ((volatile unsigned int*)(LOCAL_INTC_BASE + 0x80 + 0x10 * (core) + 4 * (n)))
+#define CORE_MBOX_RDCLR(core, n)    ((volatile unsigned int*)(LOCAL_INTC_BASE + 0xC0 + 0x10 * (core) + 4 * (n)))
+
+// GPU_INT_ROUTING: bits 1:0 pick the core taking GPU IRQs, 3:2 GPU FIQs
+#define GPU_IRQ_CORE(core)          ((core) & 3)
+
+// PMU_ROUTING_SET/CLR: bit n routes core n's PMU interrupt to its IRQ line
+#define PMU_IRQ(core)               (1 << (core))
+
+// LOCAL_TIMER_ROUTING: bits 2:0 pick the core (0-3 IRQ, 4-7 FIQ)
+#define LOCAL_TIMER_IRQ_CORE(core)  ((core) & 3)
+
+// CORE_TIMER_IRQCNTL: route each generic timer to this core's IRQ line
+#define TIMER_CNTPSIRQ              (1 << 0)
+#define TIMER_CNTPNSIRQ             (1 << 1)
+#define TIMER_CNTHPIRQ              (1 << 2)
+#define TIMER_CNTVIRQ               (1 << 3)
+
+// CORE_MAILBOX_IRQCNTL: raise an IRQ for mailbox n
+#define MBOX_IRQ(n)                 (1 << (n))
+
+// CORE_IRQ_SOURCE: pending sources for this core
+#define IRQ_SRC_CNTPSIRQ            (1 << 0)
+#define IRQ_SRC_CNTPNSIRQ           (1 << 1)
+#define IRQ_SRC_CNTHPIRQ            (1 << 2)
+#define IRQ_SRC_CNTVIRQ             (1 << 3)
+#define IRQ_SRC_MAILBOX(n)          (1 << (4 + (n)))
+#define IRQ_SRC_GPU                 (1 << 8)
+#define IRQ_SRC_PMU                 (1 << 9)
+#define IRQ_SRC_AXI                 (1 << 10)
+#define IRQ_SRC_LOCAL_TIMER         (1 << 11)
+
+#endif  /*_P_LOCAL_INTC_H */
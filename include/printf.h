@@ -19,6 +19,9 @@ void tfp_sprintf(char* s, const char* fmt, ...);
 void tfp_format(void* putp, void (*putf)(void*, char), const char* fmt, va_list va);
 void tfp_error_printf(const char* fmt, ...);
 
+// Write n raw bytes to the console under the printf lock
+void console_write(const char* s, unsigned long n);
+
 #define printf_err tfp_error_printf
 #define panic tfp_panic
 #define printf tfp_printf
@@ -0,0 +1,71 @@
+#ifndef _PROCESS_H_
+#define _PROCESS_H_
+
+#include "sched.h"
+#include "stdint.h"
+#include "vm.h"
+
+/*
+ * EL0 processes loaded from in-memory ELF64 images.
+ *
+ *   Process* p = process_create("hello", image, size);
+ *   int code = process_wait(p);
+ *
+ * Every PT_LOAD segment is mapped at its p_vaddr in the process's own TTBR0
+ * tables (see vm.h). Read-only segments are mapped straight from the image,
+ * which therefore has to stay put until the process exits; that needs a
+ * page-aligned image whose segments start at page-aligned file offsets,
+ * otherwise they are copied. Writable segments are always copied into
+ * fresh pages, with their bss zeroed.
+ *
+ * A process is one kernel thread that erets to e_entry at EL0t with SP_EL0
+ * at the top of a USER_STACK_SIZE stack and x0-x30 cleared. The kernel's
+ * time page (timekeeping.h) is mapped read-only at USER_TIME_PAGE. It talks to
+ * the kernel through the syscalls in syscall.h, is killed with exit code
+ * -EFAULT by any exception other than an svc or an FP/SIMD trap, and stays
+ * on the core it was created on.
+ */
+
+static constexpr uint64_t USER_STACK_SIZE = 64 * 1024;
+static constexpr uint64_t USER_STACK_TOP = USER_VA_END;
+// Below the stack and its guard page
+static constexpr uint64_t USER_TIME_PAGE = USER_STACK_TOP - USER_STACK_SIZE - 2 * PAGE_SIZE_4KB;
+// mmap() hands out addresses upwards from here, up to the time page
+static constexpr uint64_t USER_MMAP_BASE = USER_VA_START + (USER_VA_END - USER_VA_START) / 2;
+
+struct Process {
+    const char* name;
+    uint64_t* pgd;
+    uint16_t asid;
+    uint64_t entry;
+    uint64_t mmap_next;
+    uint32_t state;  // 0 while running, 1 once exit_code is final
+    int exit_code;
+    uint32_t pages_shared;  // mapped straight from the image
+    uint32_t pages_copied;  // segment pages with their own copy
+};
+
+// Load image and start it on core (this core when core < 0). Returns
+// nullptr, printing why, if the image is not a valid AArch64 ELF64
+// executable for the user range or memory runs out.
+Process* process_create(const char* name, const void* image, uint64_t size, int core = -1);
+
+// Wait for p to exit, free it and return its exit code
+int process_wait(Process* p);
+
+// The calling thread's process, nullptr in kernel threads
+Process* current_process();
+
+// End the calling process; its address space is gone when this returns
+// control to the scheduler
+[[noreturn]] void process_exit(int code);
+
+// Map len bytes (rounded up to pages) of zeroed memory with perms
+// (READ_PERM/WRITE_PERM/EXEC_PERM). Returns the address, or 0.
+uint64_t process_mmap(Process* p, uint64_t len, uint32_t perms);
+
+// Called by schedule() before switching: saves prev's SP_EL0 and TPIDR_EL0
+// and loads next's user state and tables
+void process_switch_to(Thread* prev, Thread* next);
+
+#endif  // _PROCESS_H_
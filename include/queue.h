@@ -4,6 +4,8 @@
 #include "libk.h"
 #include "heap.h"
 #include "stdint.h"
+#include "atomic.h"
+#include "core.h"
 
 
 template <typename T, typename LockType>
@@ -11,7 +13,7 @@ class Queue{
     public:
         Queue(int capacity){
             this->capacity = capacity;
-            this->data = new int[capacity];
+            this->data = new T[capacity];
             this->head = 0;
             this->tail = 0;
             this->size = 0;
@@ -27,24 +29,24 @@ class Queue{
             this->size = 0;
         };
 
-        void enqueue(int value){
+        void enqueue(const T& value){
             LockGuard g{this->lock};
             K::assert(size < capacity, "Queue::enqueue: queue is full");
             this->data[this->tail] = value;
-            this->tail = (this->tail + 1) % this->capacity;
+            if (++this->tail == this->capacity) this->tail = 0;
             this->size++;
         }
-        int dequeue(){
+        T dequeue(){
             LockGuard g{this->lock};
             K::assert(size > 0, "Queue::dequeue: queue is empty");
-            int value = this->data[this->head];
-            this->head = (this->head + 1) % capacity;
+            T value = this->data[this->head];
+            if (++this->head == this->capacity) this->head = 0;
             this->size--;
             return value;
         }
 
     private:
-    int* data;
+    T* data;
     int head;
     int tail;
     int size;
@@ -52,4 +54,139 @@ class Queue{
     LockType lock;
 };
 
-#endif // _QUEUE_H_
\ No newline at end of file
+// Bounded lock-free multi-producer/multi-consumer ring (Vyukov). Every cell
+// carries a sequence number that says whether it is ready to be written for
+// position pos (seq == pos) or read (seq == pos + 1), so producers and
+// consumers only contend on their own cursor. The capacity is rounded up to
+// a power of two and indices are masked, never divided.
+template <typename T>
+class MPMCRing {
+    struct Cell {
+        Atomic<uint32_t> sequence{0};
+        T data;
+    };
+
+    Cell* buffer;
+    uint32_t mask;
+    alignas(CACHE_LINE_SIZE) Atomic<uint32_t> enqueue_pos{0};
+    alignas(CACHE_LINE_SIZE) Atomic<uint32_t> dequeue_pos{0};
+    char pad[CACHE_LINE_SIZE - sizeof(Atomic<uint32_t>)];
+
+    static uint32_t round_up_pow2(uint32_t n) {
+        uint32_t cap = 2;
+        while (cap < n) cap <<= 1;
+        return cap;
+    }
+
+   public:
+    MPMCRing(uint32_t capacity) : pad() {
+        uint32_t cap = round_up_pow2(capacity);
+        buffer = new Cell[cap];
+        mask = cap - 1;
+        for (uint32_t i = 0; i < cap; i++) {
+            buffer[i].sequence.set(i);
+        }
+    }
+    ~MPMCRing() {
+        delete[] buffer;
+    }
+    MPMCRing(const MPMCRing&) = delete;
+
+    uint32_t capacity() const {
+        return mask + 1;
+    }
+
+    // Returns false instead of blocking when the ring is full
+    bool try_enqueue(const T& value) {
+        uint32_t pos = enqueue_pos.load_relaxed();
+        Cell* cell;
+        while (true) {
+            cell = &buffer[pos & mask];
+            int32_t diff = (int32_t)(cell->sequence.load_acquire() - pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange(pos, pos + 1)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load_relaxed();
+            }
+        }
+        cell->data = value;
+        cell->sequence.store_release(pos + 1);
+        return true;
+    }
+
+    // Returns false instead of blocking when the ring is empty
+    bool try_dequeue(T& out) {
+        uint32_t pos = dequeue_pos.load_relaxed();
+        Cell* cell;
+        while (true) {
+            cell = &buffer[pos & mask];
+            int32_t diff = (int32_t)(cell->sequence.load_acquire() - (pos + 1));
+            if (diff == 0) {
+                if (dequeue_pos.compare_exchange(pos, pos + 1)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load_relaxed();
+            }
+        }
+        out = cell->data;
+        cell->sequence.store_release(pos + mask + 1);
+        return true;
+    }
+
+    // Enqueue up to count items with a single cursor update. Returns how many
+    // were enqueued (0 when full); items keep their order.
+    uint32_t enqueue_bulk(const T* items, uint32_t count) {
+        uint32_t pos = enqueue_pos.load_relaxed();
+        uint32_t n;
+        while (true) {
+            // Cells only become free for position pos + i once consumers
+            // release them; only producers can take them away again, and
+            // the CAS below excludes other producers.
+            n = 0;
+            while (n < count && buffer[(pos + n) & mask].sequence.load_acquire() == pos + n) n++;
+            if (n == 0) {
+                uint32_t now = enqueue_pos.load_relaxed();
+                if (now == pos) return 0;
+                pos = now;
+                continue;
+            }
+            if (enqueue_pos.compare_exchange(pos, pos + n)) break;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            Cell& cell = buffer[(pos + i) & mask];
+            cell.data = items[i];
+            cell.sequence.store_release(pos + i + 1);
+        }
+        return n;
+    }
+
+    // Dequeue up to count items with a single cursor update. Returns how many
+    // were dequeued (0 when empty).
+    uint32_t dequeue_bulk(T* items, uint32_t count) {
+        uint32_t pos = dequeue_pos.load_relaxed();
+        uint32_t n;
+        while (true) {
+            n = 0;
+            while (n < count && buffer[(pos + n) & mask].sequence.load_acquire() == pos + n + 1)
+                n++;
+            if (n == 0) {
+                uint32_t now = dequeue_pos.load_relaxed();
+                if (now == pos) return 0;
+                pos = now;
+                continue;
+            }
+            if (dequeue_pos.compare_exchange(pos, pos + n)) break;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            Cell& cell = buffer[(pos + i) & mask];
+            items[i] = cell.data;
+            cell.sequence.store_release(pos + i + mask + 1);
+        }
+        return n;
+    }
+};
+
+#endif // _QUEUE_H_
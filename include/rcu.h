@@ -0,0 +1,89 @@
+#ifndef _RCU_H_
+#define _RCU_H_
+
+#include "atomic.h"
+#include "stdint.h"
+
+/*
+ * Quiescent-state based RCU.
+ *
+ * Readers only bump this core's preempt count: a core may only hold RCU
+ * protected references between rcu_read_lock() and rcu_read_unlock(), and
+ * reports that it holds none by calling rcu_quiescent_state() (or by going
+ * idle with rcu_idle_enter()). A grace period has elapsed once every core has
+ * done either since the grace period began; only then may the memory an
+ * updater unlinked be freed.
+ *
+ * Cores start out idle and join with rcu_idle_exit(). Read-side critical
+ * sections disable preemption, so a context switch is a quiescent state too,
+ * and so is a scheduler tick that interrupted preemptible code.
+ *
+ * call_rcu() callbacks do not depend on their caller to run them: while a
+ * core has any queued, the scheduler keeps its tick running and every tick
+ * raises the RCU softirq, which starts batches and runs those whose grace
+ * period is over. Callbacks therefore run in softirq context (or from
+ * rcu_quiescent_state()) and must not block.
+ */
+
+struct RcuHead {
+    RcuHead* next;
+    void (*func)(RcuHead* head);
+};
+
+static inline void rcu_read_lock() {
+    Preempt::disable();
+}
+
+static inline void rcu_read_unlock() {
+    Preempt::enable();
+}
+
+// Load an RCU protected pointer inside a read-side critical section
+template <typename T>
+static inline T* rcu_dereference(T* const& p) {
+    return __atomic_load_n(&p, __ATOMIC_ACQUIRE);
+}
+
+// Publish a fully initialised object to readers
+template <typename T>
+static inline void rcu_assign_pointer(T*& p, T* v) {
+    __atomic_store_n(&p, v, __ATOMIC_RELEASE);
+}
+
+// Report that this core holds no RCU references; also runs callbacks whose
+// grace period has completed
+void rcu_quiescent_state();
+
+// Cheaper quiescent state report for the scheduler; never runs callbacks
+void rcu_note_context_switch();
+
+// Install the RCU softirq; called on each core after softirq_init()
+void rcu_init();
+
+// Called from the scheduler tick with IRQs masked. Reports a quiescent
+// state if the tick interrupted preemptible code and raises the RCU softirq
+// if callbacks are queued here; returns whether they are, so the tick keeps
+// running for them.
+bool rcu_check_callbacks();
+
+// True while this core has callbacks queued
+bool rcu_needs_cpu();
+
+// Extended quiescent state for cores that sleep or wait for long periods
+void rcu_idle_enter();
+void rcu_idle_exit();
+
+// False while this core is in an extended quiescent state
+bool rcu_is_online();
+
+// Block until every core has passed through a quiescent state
+void synchronize_rcu();
+
+// Run func(head) on this core after a grace period. Callbacks are batched
+// per core and invoked from the RCU softirq or rcu_quiescent_state().
+void call_rcu(RcuHead* head, void (*func)(RcuHead* head));
+
+// Number of callbacks queued on this core that have not run yet
+uint32_t rcu_pending_callbacks();
+
+#endif // _RCU_H_
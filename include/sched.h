@@ -0,0 +1,128 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+#include "atomic.h"
+#include "fpsimd.h"
+#include "stdint.h"
+
+struct Process;
+
+/*
+ * Preemptive round-robin scheduler for kernel threads.
+ *
+ * Every core owns a run queue and only ever dequeues from its own; threads
+ * stay on the core they were created on. Other cores may enqueue onto a
+ * queue (thread creation, wakeups) under that queue's lock.
+ *
+ * The virtual generic timer raises a tick on every core through local_intc.
+ * A tick with other threads waiting sets need_resched, and the switch
+ * happens on the way out of handle_irq, or at the next Preempt::enable() if
+ * the tick landed inside a preempt-disabled section (any held SpinLock).
+ *
+ * The tick only runs while a core has threads waiting for its CPU. A core
+ * running a single thread, or idling in wfi, takes no timer interrupts
+ * except for its own TimerEvents (sleep_until()). Queueing a thread onto a
+ * core whose tick is stopped sends it a reschedule IPI.
+ *
+ * The context switch only saves the AAPCS64 callee-saved general registers:
+ * x19-x29, lr and sp. The other general registers are already on the stack,
+ * saved by the compiler around the call to schedule() or by kernel_entry for
+ * an IRQ. FP/SIMD state is switched lazily, see fpsimd.h.
+ */
+
+static constexpr uint32_t SCHED_TICK_HZ = 100;
+static constexpr uint64_t THREAD_STACK_SIZE = 16 * 1024;
+
+enum class ThreadState : uint32_t {
+    Running,   // on a CPU, not on any run queue
+    Runnable,  // on its core's run queue
+    Blocked,   // waiting for sched_wakeup()
+    Dead,      // exited; freed by the next thread to run on its core
+};
+
+// Registers cpu_switch_to() saves; layout is shared with switch.S
+struct CpuContext {
+    uint64_t x19_x28[10];
+    uint64_t fp;
+    uint64_t lr;
+    uint64_t sp;
+};
+
+struct Thread {
+    CpuContext context;  // must stay first, switch.S indexes from the Thread*
+    Thread* next;        // run queue link
+    ThreadState state;
+    uint32_t core;
+    const char* name;
+    void* stack;  // nullptr for the boot thread, which runs on the static stack
+    uint64_t switches;
+    bool fp_used;     // fp holds saved state (the thread has touched FP/SIMD)
+    FpSimdState fp;   // only written when another thread takes the FP unit
+    Process* process; // nullptr for kernel threads
+    uint64_t user_sp; // SP_EL0 while switched out
+    uint64_t user_tpidr; // TPIDR_EL0, the process's TLS pointer, likewise
+};
+
+// Called on each core once its stack is final; the calling context becomes
+// that core's boot thread
+void sched_init();
+
+// Enable the scheduler tick on this core
+void sched_start();
+
+// Create a thread running fn(arg) on core (this core when core < 0)
+Thread* thread_create(const char* name, void (*fn)(void*), void* arg, int core = -1);
+
+// Leave the current thread for good; returning from fn does the same
+[[noreturn]] void thread_exit();
+
+// The thread running on this core, or nullptr before sched_init()
+Thread* current_thread();
+
+// True when the caller may sleep through the scheduler: a thread context on
+// a core running the scheduler, not in an IRQ and with preemption enabled
+bool sched_can_block();
+
+// Give up the CPU to the next runnable thread on this core, if any
+void yield();
+
+// Pick the next thread and switch to it. The current thread is put back on
+// the run queue unless it has blocked or exited.
+void schedule();
+
+// Block the current thread if still_blocked(arg) holds. It is evaluated
+// under the run queue lock, which pairs with sched_wakeup(): a waker that
+// makes it false before calling sched_wakeup() is never missed.
+void sched_block_if(bool (*still_blocked)(void* arg), void* arg);
+
+// Make a blocked thread runnable again; a no-op for any other state
+void sched_wakeup(Thread* t);
+
+// Sleep until the timer count reaches deadline. Spins instead when the
+// caller can't block.
+void sleep_until(uint64_t deadline);
+
+// Timer tick, called from handle_irq with IRQs masked. Returns false when
+// the core no longer needs the tick.
+bool sched_tick();
+
+// Run by handle_irq on the way out when a tick asked for a switch
+void preempt_schedule_irq();
+
+// Number of context switches this core has done
+uint64_t sched_switch_count(uint32_t core);
+
+// Time the idle thread spent in wfi, and how late sleep_until() returned,
+// in timer counts
+struct IdleStats {
+    uint64_t idle_entries;
+    uint64_t idle_total;
+    uint64_t wakeups;
+    uint64_t wakeup_latency_total;
+    uint64_t wakeup_latency_max;
+};
+
+IdleStats sched_idle_stats(uint32_t core);
+void sched_idle_stats_reset();
+
+#endif // _SCHED_H_
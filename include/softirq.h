@@ -0,0 +1,82 @@
+#ifndef _SOFTIRQ_H_
+#define _SOFTIRQ_H_
+
+#include "stdint.h"
+
+/*
+ * Deferred interrupt work ("softirqs", after the Linux bottom halves).
+ *
+ * An IRQ handler should only acknowledge its device, note what needs doing
+ * with raise_softirq() and return. Raised work runs on the way out of
+ * handle_irq with IRQs unmasked again, so the next interrupt is taken as
+ * soon as it arrives instead of queueing behind a long handler. Work raised
+ * while a pass is already running, from a nested IRQ or by a handler
+ * itself, is picked up by that pass.
+ *
+ * A pass on IRQ exit is bounded: it stops after SOFTIRQ_MAX_ROUNDS rounds or
+ * SOFTIRQ_BUDGET_US, whichever comes first, and leaves the rest to the
+ * core's softirqd thread. softirqd is an ordinary round-robin thread that
+ * yields after every pass, so a flood of interrupts slows the other threads
+ * down but can't starve them. Work raised from a thread goes to softirqd
+ * too.
+ *
+ * Handlers run on the core that raised them, one pass at a time, with
+ * preemption disabled: they must not block. They count as interrupt context
+ * for locking (Interrupts::inInterrupt()), so anything they share with
+ * threads needs an InterruptSafeLock.
+ */
+
+enum class SoftirqType : uint32_t {
+    Timer,    // expired TimerEvents
+    Tasklet,  // one-shot work items, see Tasklet
+    Rcu,      // RCU callbacks whose grace period has ended
+    Count
+};
+
+static constexpr uint32_t SOFTIRQ_TYPES = (uint32_t)SoftirqType::Count;
+static constexpr uint32_t SOFTIRQ_MAX_ROUNDS = 10;
+static constexpr uint64_t SOFTIRQ_BUDGET_US = 2000;
+
+// Start this core's softirqd; called once per core after sched_init()
+void softirq_init();
+
+// Install the handler for type; the same on every core
+void open_softirq(SoftirqType type, void (*handler)());
+
+// Mark type pending on this core. Safe from any context.
+void raise_softirq(SoftirqType type);
+
+// Called by handle_irq with IRQs masked once the hardware has been dealt
+// with; irq_start is the timer count at entry. Runs pending work.
+void softirq_irq_exit(uint64_t irq_start);
+
+// A work item run once from the Tasklet softirq of the core that scheduled
+// it. fn may schedule the tasklet again. A tasklet scheduled from several
+// cores can run on them concurrently.
+struct Tasklet {
+    void (*fn)(Tasklet* t) = nullptr;
+    Tasklet* next = nullptr;
+    uint32_t queued = 0;  // set by tasklet_schedule(), cleared just before fn runs
+};
+
+// Queue t on this core. Returns false if it was already queued.
+bool tasklet_schedule(Tasklet& t);
+
+// Where interrupt handling time goes on a core, in timer counts
+struct SoftirqStats {
+    uint64_t hardirqs;        // handle_irq calls
+    uint64_t hardirq_cycles;  // spent in them with IRQs masked
+    uint64_t hardirq_max;
+    uint64_t exit_passes;     // softirq passes run on IRQ exit
+    uint64_t exit_cycles;
+    uint64_t deferred;        // exit passes that ran out of budget
+    uint64_t thread_passes;   // passes run by softirqd
+    uint64_t thread_cycles;
+    uint64_t runs[SOFTIRQ_TYPES];    // handler calls per type
+    uint64_t cycles[SOFTIRQ_TYPES];  // time in them
+};
+
+SoftirqStats softirq_stats(uint32_t core);
+void softirq_stats_reset();
+
+#endif // _SOFTIRQ_H_
@@ -0,0 +1,105 @@
+#ifndef _SYNC_H_
+#define _SYNC_H_
+
+#include "stdint.h"
+
+/*
+ * Sleeping locks built on futex_wait/futex_wake.
+ *
+ * Each primitive spins briefly first (the holder is usually about to let
+ * go), then sleeps on its own state word. The uncontended paths are a
+ * single atomic and never touch the futex hash table.
+ *
+ * These may block, so they must not be used from IRQ handlers or with
+ * interrupts masked; use SpinLock/InterruptSafeLock there.
+ */
+
+// Bounded spin before a contended acquire goes to sleep
+static constexpr uint32_t SYNC_SPIN_LIMIT = 200;
+
+class Mutex {
+    uint32_t state;  // 0 free, 1 locked, 2 locked and there may be sleepers
+
+   public:
+    constexpr Mutex() : state(0) {
+    }
+
+    Mutex(const Mutex&) = delete;
+
+    bool try_lock() {
+        uint32_t expected = 0;
+        return __atomic_compare_exchange_n(&state, &expected, 1, false, __ATOMIC_ACQUIRE,
+                                           __ATOMIC_RELAXED);
+    }
+
+    void lock() {
+        if (!try_lock()) lock_slow();
+    }
+
+    void unlock() {
+        if (__atomic_exchange_n(&state, 0, __ATOMIC_RELEASE) == 2) unlock_slow();
+    }
+
+    // for debugging, etc. Allows false positives
+    bool isMine() {
+        return __atomic_load_n(&state, __ATOMIC_RELAXED) != 0;
+    }
+
+   private:
+    void lock_slow();
+    void unlock_slow();
+};
+
+class Semaphore {
+    uint32_t count;
+    uint32_t sleepers;
+
+   public:
+    constexpr Semaphore(uint32_t count) : count(count), sleepers(0) {
+    }
+
+    Semaphore(const Semaphore&) = delete;
+
+    bool try_down() {
+        uint32_t c = __atomic_load_n(&count, __ATOMIC_RELAXED);
+        while (c != 0) {
+            if (__atomic_compare_exchange_n(&count, &c, c - 1, false, __ATOMIC_ACQUIRE,
+                                            __ATOMIC_RELAXED)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void down();
+    void up();
+
+    uint32_t value() {
+        return __atomic_load_n(&count, __ATOMIC_RELAXED);
+    }
+};
+
+class CondVar {
+    uint32_t seq;  // bumped by every signal so a sleeper can't miss one
+    uint32_t sleepers;
+
+   public:
+    constexpr CondVar() : seq(0), sleepers(0) {
+    }
+
+    CondVar(const CondVar&) = delete;
+
+    // Atomically release m and sleep; m is held again on return. Wakeups may
+    // be spurious, so callers re-check their condition.
+    void wait(Mutex& m);
+
+    template <typename Pred>
+    void wait(Mutex& m, Pred pred) {
+        while (!pred()) wait(m);
+    }
+
+    void signal();
+    void broadcast();
+};
+
+#endif // _SYNC_H_
@@ -0,0 +1,138 @@
+#ifndef _SYSCALL_H_
+#define _SYSCALL_H_
+
+#include "entry.h"
+
+/*
+ * System calls.
+ *
+ * ABI: "svc #0" with the number in x8 and up to six arguments in x0-x5. The
+ * result comes back in x0, negative on error; every other register is
+ * preserved.
+ *
+ * svc #0 takes a lean path in boot.S. It saves only what a call into C can
+ * clobber (x0-x19, x30, ELR, SPSR), unmasks IRQs if the caller had them
+ * unmasked, jumps through sys_call_table[x8] and restores the same set.
+ * The C handler saves x19-x29 itself if it uses them. The time each call
+ * takes is added to per-core, per-syscall counters.
+ *
+ * Any other svc immediate goes through the full exception frame to
+ * syscall_handler(). That path is kept as the reference the lean one is
+ * benchmarked against.
+ *
+ * EL0 processes (process.h) use the same ABI. Their pointers are checked
+ * against their page tables; kernel threads may call in too, and their
+ * pointers are trusted.
+ */
+
+#define SYS_NULL 0           // does nothing, for measuring the entry path
+#define SYS_WRITE 1          // write(fd, buf, len): fd 1 and 2 go to the console
+#define SYS_EXIT 2           // exit(code): processes only
+#define SYS_MMAP 3           // mmap(addr, len, prot, flags, fd, off): anonymous only
+#define SYS_YIELD 4          // yield()
+#define SYS_CLOCK_GETTIME 5  // clock_gettime(clock, Timespec*)
+
+#define NR_SYSCALLS 6
+
+// Error results, negated
+#define EPERM 1
+#define EBADF 9
+#define ENOMEM 12
+#define EFAULT 14
+#define EINVAL 22
+#define ENOSYS 38  // no such syscall
+
+// mmap() arguments; PROT_* match the vm.h permission bits
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC 0x4
+#define MAP_PRIVATE 0x02
+#define MAP_FIXED 0x10
+#define MAP_ANONYMOUS 0x20
+
+// CLOCK_MONOTONIC counts from boot; CLOCK_REALTIME is whatever
+// timekeeping_set_realtime() last made it
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+
+// Layout of syscall_stats_table for boot.S: one SyscallStats per syscall,
+// each core's block padded to whole cache lines
+#define SYSCALL_STATS_SHIFT 5
+#define SYSCALL_CPU_STRIDE (((NR_SYSCALLS << SYSCALL_STATS_SHIFT) + 63) & ~63)
+
+#ifndef __ASSEMBLER__
+
+#include "core.h"
+#include "stdint.h"
+
+// The exception frame built by kernel_entry
+struct TrapFrame {
+    uint64_t x[31];
+    uint64_t elr;
+    uint64_t spsr;
+    uint64_t irq_entry;  // cntvct_el0 at the vector, IRQ frames only
+};
+
+static_assert(sizeof(TrapFrame) == S_FRAME_SIZE, "TrapFrame must match kernel_entry");
+
+struct Timespec {
+    int64_t tv_sec;
+    int64_t tv_nsec;
+};
+
+using SyscallFn = long (*)(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4,
+                           uint64_t a5);
+
+extern "C" const SyscallFn sys_call_table[NR_SYSCALLS];
+
+// Per core and syscall, in timer counts, written by the lean path only
+struct SyscallStats {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t max;
+    uint64_t pad;
+};
+
+static_assert(sizeof(SyscallStats) == 1 << SYSCALL_STATS_SHIFT, "boot.S indexes by shift");
+
+struct alignas(CACHE_LINE_SIZE) SyscallCpu {
+    SyscallStats stats[NR_SYSCALLS];
+};
+
+static_assert(sizeof(SyscallCpu) == SYSCALL_CPU_STRIDE, "boot.S indexes by stride");
+
+SyscallStats syscall_stats(uint32_t core, uint32_t nr);
+void syscall_stats_reset();
+
+// Issue a syscall from the kernel or from EL0
+static inline long syscall6(uint64_t nr, uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3,
+                            uint64_t a4, uint64_t a5) {
+    register uint64_t x8 asm("x8") = nr;
+    register uint64_t x0 asm("x0") = a0;
+    register uint64_t x1 asm("x1") = a1;
+    register uint64_t x2 asm("x2") = a2;
+    register uint64_t x3 asm("x3") = a3;
+    register uint64_t x4 asm("x4") = a4;
+    register uint64_t x5 asm("x5") = a5;
+    asm volatile("svc #0"
+                 : "+r"(x0)
+                 : "r"(x8), "r"(x1), "r"(x2), "r"(x3), "r"(x4), "r"(x5)
+                 : "memory");
+    return (long)x0;
+}
+
+static inline long syscall0(uint64_t nr) {
+    return syscall6(nr, 0, 0, 0, 0, 0, 0);
+}
+
+// The same call through the full-frame path
+static inline long syscall0_full_frame(uint64_t nr) {
+    register uint64_t x8 asm("x8") = nr;
+    register uint64_t x0 asm("x0");
+    asm volatile("svc #1" : "=r"(x0) : "r"(x8) : "memory");
+    return (long)x0;
+}
+
+#endif  // __ASSEMBLER__
+
+#endif  // _SYSCALL_H_
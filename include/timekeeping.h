@@ -0,0 +1,79 @@
+#ifndef _TIMEKEEPING_H_
+#define _TIMEKEEPING_H_
+
+#include "stdint.h"
+#include "syscall.h"
+
+/*
+ * Timekeeping and the user-readable time page.
+ *
+ * The kernel keeps the clock parameters in one page, mapped read-only at
+ * USER_TIME_PAGE in every process (process.h). Reading the time is
+ *
+ *   ns = base_ns + (cntvct_el0 - base_count) * mult / 2^32
+ *
+ * plus realtime_offset for CLOCK_REALTIME, which time_page_gettime() does
+ * anywhere, EL0 included (boot.S gives EL0 the virtual counter), with no
+ * syscall. SYS_CLOCK_GETTIME runs the same code on the kernel's copy.
+ *
+ * The parameters are guarded by a sequence count: odd while the kernel is
+ * rewriting them. Readers retry until they see the same even count before
+ * and after reading. Updates are rare (adjustments, setting the wall
+ * clock) and each one rebases to the current time, so the clock never
+ * jumps when its rate changes.
+ */
+
+struct alignas(4096) TimePage {
+    uint32_t seq;
+    uint32_t pad;
+    uint64_t freq;            // cntfrq_el0
+    uint64_t base_count;      // counter at the last update; the boot count at first
+    uint64_t base_ns;         // CLOCK_MONOTONIC at base_count
+    uint64_t mult;            // ns per count, 32.32 fixed point, adjustment included
+    int64_t realtime_offset;  // CLOCK_REALTIME - CLOCK_MONOTONIC, ns
+    int64_t adjust_ppb;       // frequency adjustment in mult, parts per billion
+};
+
+static_assert(sizeof(TimePage) == 4096, "the time page is mapped as one page");
+
+// Read clock (CLOCK_REALTIME or CLOCK_MONOTONIC) from tp. Needs nothing but
+// read access to tp, so it works from EL0 through USER_TIME_PAGE.
+static inline bool time_page_gettime(const TimePage* tp, uint64_t clock, Timespec* ts) {
+    if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC) return false;
+
+    uint32_t seq;
+    uint64_t base_count, base_ns, mult;
+    int64_t offset;
+    do {
+        seq = __atomic_load_n(&tp->seq, __ATOMIC_ACQUIRE);
+        base_count = __atomic_load_n(&tp->base_count, __ATOMIC_RELAXED);
+        base_ns = __atomic_load_n(&tp->base_ns, __ATOMIC_RELAXED);
+        mult = __atomic_load_n(&tp->mult, __ATOMIC_RELAXED);
+        offset = __atomic_load_n(&tp->realtime_offset, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&tp->seq, __ATOMIC_RELAXED));
+
+    // Read after the snapshot, so it is never older than base_count
+    uint64_t count;
+    asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(count)::"memory");
+    uint64_t ns = base_ns + (uint64_t)(((unsigned __int128)(count - base_count) * mult) >> 32);
+    if (clock == CLOCK_REALTIME) ns += offset;
+    ts->tv_sec = (int64_t)(ns / 1000000000);
+    ts->tv_nsec = (int64_t)(ns % 1000000000);
+    return true;
+}
+
+// Start CLOCK_MONOTONIC at 0 from the current counter; boot core, once
+void timekeeping_init();
+
+// The kernel's copy of the page
+const TimePage* time_page();
+
+// Run the clock ppb parts per billion fast (negative: slow), relative to
+// the nominal counter frequency, from now on. Clamped to +-500ppm.
+void timekeeping_adjust(int64_t ppb);
+
+// Set CLOCK_REALTIME to ns since the epoch
+void timekeeping_set_realtime(int64_t ns);
+
+#endif  // _TIMEKEEPING_H_
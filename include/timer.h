@@ -0,0 +1,81 @@
+#ifndef _TIMER_H_
+#define _TIMER_H_
+
+#include "stdint.h"
+#include "timerwheel.h"
+
+// Virtual generic timer count (cntvct_el0). The isb keeps the read from
+// being speculated ahead of the code it is meant to time.
+static inline uint64_t timer_count() {
+    uint64_t t;
+    asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(t) :: "memory");
+    return t;
+}
+
+// Generic timer frequency in Hz (cntfrq_el0)
+static inline uint64_t timer_frequency() {
+    uint64_t f;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(f));
+    return f;
+}
+
+/*
+ * Each core's virtual timer is programmed for its next pending event only:
+ * the scheduler tick, if the scheduler currently wants one, or the next
+ * expiry or cascade in the core's timer wheel. With neither, the timer is
+ * switched off and an idle core sleeps in wfi until some other interrupt
+ * arrives.
+ *
+ * TimerEvents are one-shot and run on the core that queued them. Deadlines
+ * are rounded up to the wheel granule of 2^TIMER_GRANULE_SHIFT counts (16us
+ * on QEMU's 62.5MHz counter). Everything due by the time the IRQ is taken
+ * expires as one batch. The IRQ only takes the batch off the wheel; fn runs
+ * from the timer softirq right after, with IRQs enabled, preemption disabled
+ * and the wheel unlocked, so it may queue new events but must not block.
+ */
+
+static constexpr uint32_t TIMER_GRANULE_SHIFT = 10;
+
+// Start the scheduler tick at hz and route the virtual timer to this core
+void timer_tick_init(uint32_t hz);
+
+// Start or stop this core's tick. Call with IRQs masked.
+void timer_tick_enable(bool on);
+
+// Queue ev on this core for ev.deadline; ev must not already be queued
+void timer_add(TimerEvent& ev);
+
+// Take ev back, from any core, as long as its callback has not started.
+// Returns false if it had (or ev was never queued); when called from a
+// thread on another core it then also waits for the callback to have
+// returned, so ev may be freed either way. From IRQ or softirq context
+// (another timer callback) it never waits, since two cores cancelling each
+// other's running events would wait forever; false there means ev's
+// callback may still be running.
+bool timer_cancel(TimerEvent& ev);
+
+// Expiry batches handled so far on core
+struct TimerStats {
+    uint64_t batches;       // softirq runs that had events to expire
+    uint64_t expired;
+    uint64_t batch_max;
+    uint64_t cycles_total;  // spent in the softirq running callbacks
+};
+
+TimerStats timer_stats(uint32_t core);
+void timer_stats_reset();
+
+// Events queued on core's wheel
+uint64_t timer_active(uint32_t core);
+
+// Time spent handling scheduler ticks, in timer counts
+struct TickStats {
+    uint64_t ticks;
+    uint64_t cycles_total;
+    uint64_t cycles_max;
+};
+
+TickStats timer_tick_stats(uint32_t core);
+void timer_tick_stats_reset();
+
+#endif // _TIMER_H_
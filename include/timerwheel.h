@@ -0,0 +1,93 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#include "stdint.h"
+
+/*
+ * Hierarchical timing wheel (Varghese & Lauck, as in the classic Linux
+ * timer base).
+ *
+ * Time is counted in granules. Level L has 64 slots, each covering 64^L
+ * granules. A timer goes into the lowest level whose range still reaches
+ * its expiry, so adding and removing are O(1): link or unlink, plus one bit
+ * in the level's occupancy mask. Each time the clock crosses a slot boundary
+ * of level L, that slot is cascaded and its timers are re-placed one or
+ * more levels down. Level 0 slots hold timers due at exactly that granule.
+ *
+ * advance() does not walk idle granules one by one: the occupancy masks give
+ * the next granule where anything expires or cascades, and the clock jumps
+ * straight there. That keeps a core that slept for seconds cheap to catch up.
+ *
+ * The wheel does no locking of its own.
+ */
+
+struct TimerEvent {
+    uint64_t deadline = 0;                // timer count, set by the caller
+    void (*fn)(TimerEvent* ev) = nullptr;
+
+    // Owned by the wheel
+    TimerEvent* next = nullptr;
+    TimerEvent** pprev = nullptr;  // nullptr when not queued
+    uint64_t expires = 0;          // deadline in granules, rounded up
+    uint32_t core = 0;             // wheel it was last queued on
+    uint32_t bucket = 0;           // level * SLOTS + slot
+};
+
+class TimerWheel {
+   public:
+    static constexpr uint32_t SLOT_BITS = 6;
+    static constexpr uint32_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint32_t LEVELS = 5;
+    static constexpr uint64_t NEVER = ~0ull;
+
+    // Furthest a timer can be placed from the clock; later ones are parked in
+    // the top level and re-placed when it cascades
+    static constexpr uint64_t MAX_DELTA = (1ull << (SLOT_BITS * LEVELS)) - 1;
+
+   private:
+    uint64_t clk;  // next granule to process
+    uint64_t pending[LEVELS];
+    TimerEvent* slots[LEVELS][SLOTS];
+    uint64_t active;
+    uint64_t cascaded;
+
+    void place(TimerEvent& ev);
+    void cascade(uint32_t level, uint32_t slot);
+    void step(TimerEvent**& tail, uint32_t& count);
+
+   public:
+    constexpr TimerWheel() : clk(0), pending(), slots(), active(0), cascaded(0) {
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+
+    // Start the clock at now; the wheel must be empty
+    void init(uint64_t now) {
+        clk = now;
+    }
+
+    // Queue ev to expire at granule expires. ev must not be queued.
+    void add(TimerEvent& ev, uint64_t expires);
+
+    // Unqueue ev; false if it was not queued
+    bool remove(TimerEvent& ev);
+
+    // Process every granule up to and including now. Returns the timers that
+    // expired, linked through next, and their number in count.
+    TimerEvent* advance(uint64_t now, uint32_t& count);
+
+    // Earliest granule at which advance() has work (an expiry or a cascade),
+    // NEVER when the wheel is empty
+    uint64_t next_pending();
+
+    uint64_t size() {
+        return active;
+    }
+
+    // Timers re-placed by cascades so far
+    uint64_t cascades() {
+        return cascaded;
+    }
+};
+
+#endif // _TIMERWHEEL_H_
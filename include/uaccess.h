@@ -0,0 +1,52 @@
+#ifndef _UACCESS_H_
+#define _UACCESS_H_
+
+#include "process.h"
+#include "stdint.h"
+#include "syscall.h"
+#include "vm.h"
+
+/*
+ * Copies to and from memory that may not be there.
+ *
+ * These do plain loads and stores and let the MMU do the checking: a fault
+ * on one of them resumes through the exception table (extable.h) instead of
+ * killing the kernel, and the copy reports how far it got. Nothing is
+ * looked up in the page tables beforehand.
+ *
+ * copy_from_user()/copy_to_user() also check that a process's pointer lies
+ * in its own half of the address space, so it cannot name kernel memory.
+ * Kernel threads (no process) call syscalls with kernel pointers, which are
+ * taken as they are.
+ */
+
+// Copy n bytes, returning how many were not copied (uaccess.S)
+extern "C" uint64_t uaccess_copy(void* dst, const void* src, uint64_t n);
+
+// True if the calling process may name [p, p + n)
+static inline bool access_ok(const void* p, uint64_t n) {
+    uint64_t va = (uint64_t)p;
+    if (!current_process()) return true;
+    return va >= USER_VA_START && va <= USER_VA_END && n <= USER_VA_END - va;
+}
+
+// Both return the number of bytes not copied: 0 on success
+static inline uint64_t copy_from_user(void* dst, const void* src, uint64_t n) {
+    return access_ok(src, n) ? uaccess_copy(dst, src, n) : n;
+}
+
+static inline uint64_t copy_to_user(void* dst, const void* src, uint64_t n) {
+    return access_ok(dst, n) ? uaccess_copy(dst, src, n) : n;
+}
+
+// Copy n bytes from src, which may be any address at all. 0 or -EFAULT.
+static inline long probe_read(void* dst, const void* src, uint64_t n) {
+    return uaccess_copy(dst, src, n) ? -EFAULT : 0;
+}
+
+// Copy n bytes to dst, which may be any address at all. 0 or -EFAULT.
+static inline long probe_write(void* dst, const void* src, uint64_t n) {
+    return uaccess_copy(dst, src, n) ? -EFAULT : 0;
+}
+
+#endif  // _UACCESS_H_
@@ -1,11 +1,76 @@
 #ifndef UART_H
 #define UART_H
 
+#include "stdint.h"
+
+/*
+ * PL011 UART0 console.
+ *
+ * uart_init() starts it polled: every byte waits for FIFO space (TXFF) or
+ * data (RXFE), which is all there is until the interrupt controller is up.
+ * uart_enable_irq() then moves it behind two software rings:
+ *
+ *   TX  writers copy into the ring and push up to a FIFO's worth into the
+ *       FIFO right away; the TX interrupt (FIFO down to 1/8) refills it from
+ *       the ring and is masked again once the ring is empty. uart_write() never
+ *       waits. uart_putc() only does when the ring is full, and then by
+ *       feeding the FIFO itself, so printf output is never dropped.
+ *   RX  the RX (FIFO half full) and receive timeout interrupts drain the
+ *       whole FIFO into the ring at once and then post every coroutine
+ *       waiting for input (coro.h). Bytes that find the ring full are
+ *       dropped and counted.
+ *
+ * uart_set_polled() goes back to polling for good, pushing out whatever
+ * is still queued without taking the UART lock, whose holder may be the
+ * code that failed. panic() and the fatal exception handlers call it.
+ */
+
+static constexpr uint32_t UART_TX_RING = 4096;
+static constexpr uint32_t UART_RX_RING = 1024;
+
+struct ReadyNode;
+
 void uart_init();
+void uart_enable_irq();  // after irq_init()
+void uart_set_polled();
+
 void uart_putc(char c);
 char uart_getc(void);
+bool uart_rx_ready(void);  // a character is waiting
+bool uart_tx_ready(void);  // uart_putc() won't wait
 void uart_puts(const char* str);
 void uart_hex(unsigned int d);
 void uart_putc_wrapper(void* p, char c);
 
+// Queue up to len bytes and return how many were taken: fewer than len
+// only when the TX ring is full. Polled, it writes all of them.
+uint64_t uart_write(const char* buf, uint64_t len);
+
+// Take up to len received bytes without waiting; returns how many
+uint64_t uart_read(char* buf, uint64_t len);
+
+// Park n to be posted from the UART IRQ once input is waiting (rx) or the
+// TX ring is at most half full (tx). Returns false, leaving n alone, if
+// that is already so or the UART is polled.
+bool uart_wait_rx(ReadyNode& n);
+bool uart_wait_tx(ReadyNode& n);
+
+// Stop (true) or go back to (false) handing the TX ring to the FIFO. While
+// held, writes only queue and writers park once the ring fills; on release
+// a FIFO's worth goes out and the TX interrupt moves the rest. For tests,
+// so the ring and its interrupt get used even on a UART that sends at once.
+void uart_tx_hold(bool on);
+
+struct UartStats {
+    uint64_t tx_bytes;    // handed to the FIFO
+    uint64_t rx_bytes;    // taken from the FIFO into the ring
+    uint64_t rx_dropped;  // taken from the FIFO with the ring full
+    uint64_t tx_irqs;
+    uint64_t rx_irqs;
+    uint64_t tx_waits;    // writers parked by uart_wait_tx()
+    uint64_t tx_pending;  // in the TX ring right now
+};
+
+UartStats uart_stats();
+
 #endif // UART_H
@@ -92,5 +92,47 @@ bool map_4kb(uint64_t virt_addr, uint64_t phys_addr, uint64_t attrs);
 // I will expose a helper to get normal cached memory attributes for new mappings (heap expansion)
 uint64_t vm_get_normal_page_attrs();
 
+// Kernel virtual addresses are VA_START | physical
+static inline uint64_t virt_to_phys(const void* p) {
+    return (uint64_t)p & ~VA_START;
+}
+
+static inline void* phys_to_virt(uint64_t pa) {
+    return (void*)(pa | VA_START);
+}
+
+/*
+ * User address spaces.
+ *
+ * Each process has its own TTBR0 tables. Entry 0 of its PGD is the kernel's
+ * (the EL1-only identity map, so the kernel keeps working while a process
+ * is loaded), entry 1 is private and holds the user range below. User pages
+ * are not global and are tagged with the process's ASID, so switching
+ * between processes needs no TLB flush.
+ *
+ * Permissions are READ_PERM/WRITE_PERM/EXEC_PERM. Pages mapped as owned are
+ * kfree_aligned()'d with the tables; the others (e.g. shared ELF text) are
+ * left alone.
+ */
+#define USER_VA_START 0x0000008000000000ULL  // PGD entry 1
+#define USER_VA_END   0x0000010000000000ULL
+
+// Empty user tables, nullptr without memory
+uint64_t* vm_user_create();
+
+// Map the 4KB page at va to pa. Fails outside the user range, if va is
+// already mapped or without memory for a table.
+bool vm_user_map(uint64_t* pgd, uint64_t va, uint64_t pa, uint32_t perms, bool owned);
+
+// True if va is mapped with at least perms; the physical address goes to pa
+bool vm_user_lookup(uint64_t* pgd, uint64_t va, uint32_t perms, uint64_t* pa = nullptr);
+
+// Free the tables and every owned page, and drop asid's TLB entries.
+// pgd must not be live in TTBR0 on any core.
+void vm_user_destroy(uint64_t* pgd, uint16_t asid);
+
+// Load pgd/asid into TTBR0 on this core, or the kernel's tables for nullptr
+void vm_user_switch(uint64_t* pgd, uint16_t asid);
+
 #endif /*__ASSEMBLER__*/
 #endif /*_VM_H*/
\ No newline at end of file
@@ -0,0 +1,102 @@
+#ifndef _WAIT_H_
+#define _WAIT_H_
+
+#include "atomic.h"
+#include "sched.h"
+#include "stdint.h"
+
+/*
+ * Wait queues and futex-style wait-on-address.
+ *
+ * A Waiter lives on the stack of whoever blocks. It is linked into a queue
+ * under the queue lock, the caller re-checks its condition under that same
+ * lock, and only then blocks; a waker that changes the condition and then
+ * calls wake() can therefore never be missed.
+ *
+ * A thread that may sleep (sched_can_block()) is taken off its run queue
+ * until woken. Anywhere else, e.g. before the scheduler is up, blocking parks
+ * the core in wfe until a waker sets the waiter's flag and issues sev; the
+ * core reports an RCU extended quiescent state while parked.
+ */
+
+struct Waiter {
+    Waiter* next = nullptr;
+    Waiter* prev = nullptr;
+    const void* key = nullptr;  // futex address, nullptr on plain wait queues
+    Thread* thread = nullptr;   // sleeping thread, nullptr when parked in wfe
+    Atomic<bool> woken{false};
+};
+
+class WaitQueue {
+    InterruptSafeLock lock;
+    Waiter* head;
+    Waiter* tail;
+
+    void link(Waiter& w);
+    void unlink(Waiter& w);
+
+   public:
+    constexpr WaitQueue(const char* name = "waitqueue") : lock(name), head(nullptr), tail(nullptr) {
+    }
+
+    WaitQueue(const WaitQueue&) = delete;
+
+    // Queue w only if pred() holds; pred runs under the queue lock with IRQs
+    // masked, so it must be short and must not block
+    template <typename Pred>
+    bool enqueue_if(Waiter& w, const void* key, Pred pred) {
+        Thread* self = sched_can_block() ? current_thread() : nullptr;
+        LockGuard<InterruptSafeLock> g{lock};
+        if (!pred()) return false;
+        w.key = key;
+        w.thread = self;
+        w.woken.set(false);
+        link(w);
+        return true;
+    }
+
+    // Remove w if no waker has dequeued it yet. Always takes the queue lock,
+    // so a waker is done with w (and its thread) once this returns.
+    void finish(Waiter& w);
+
+    // Park until w has been woken
+    static void block(Waiter& w);
+
+    // Wake up to n waiters queued with key (any key when key is nullptr),
+    // oldest first. Returns how many were woken.
+    uint32_t wake(uint32_t n, const void* key = nullptr);
+
+    uint32_t wake_one() {
+        return wake(1);
+    }
+
+    uint32_t wake_all() {
+        return wake(0xFFFFFFFF);
+    }
+
+    // Unlocked snapshot; only a hint unless the caller holds off wakers
+    bool has_waiters() {
+        return __atomic_load_n(&head, __ATOMIC_RELAXED) != nullptr;
+    }
+};
+
+// Block until cond() is true. cond() is evaluated under the queue lock, so
+// whoever makes it true must do so before calling wake_one()/wake_all().
+template <typename Cond>
+void wait_event(WaitQueue& wq, Cond cond) {
+    while (!cond()) {
+        Waiter w;
+        if (!wq.enqueue_if(w, nullptr, [&cond] { return !cond(); })) return;
+        WaitQueue::block(w);
+        wq.finish(w);
+    }
+}
+
+// Sleep while *addr == expected. Returns false without sleeping if the value
+// had already changed when checked under the hash bucket lock.
+bool futex_wait(const uint32_t* addr, uint32_t expected);
+
+// Wake up to n threads sleeping on addr; returns how many were woken
+uint32_t futex_wake(const uint32_t* addr, uint32_t n);
+
+#endif // _WAIT_H_
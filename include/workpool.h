@@ -0,0 +1,117 @@
+#ifndef _WORKPOOL_H_
+#define _WORKPOOL_H_
+
+#include "atomic.h"
+#include "core.h"
+#include "stdint.h"
+
+/*
+ * Fork-join task pool with per-core Chase-Lev work-stealing deques.
+ *
+ * A core pushes and pops tasks at the bottom of its own deque; other cores
+ * steal from the top. Tasks are not allocated by the pool: the caller owns
+ * each Task and must keep it alive until the TaskGroup it was spawned into
+ * has been synced, which is what makes stack-allocated tasks safe.
+ *
+ *   TaskGroup g;
+ *   auto left = make_task([&] { a = fib(n - 1); });
+ *   g.spawn(left);
+ *   b = fib(n - 2);
+ *   g.sync();
+ *
+ * sync() runs queued tasks (its own first, then stolen ones) instead of
+ * waiting idle. Cores that are not spawning work join in via
+ * WorkPool::work_until() or the worker threads started by WorkPool::start();
+ * they steal from random victims and park in wfe when every deque is empty.
+ */
+
+class TaskGroup;
+
+struct Task {
+    void (*run)(Task* self);
+    TaskGroup* group;
+};
+
+template <typename F>
+struct FnTask : Task {
+    F fn;
+
+    FnTask(F f) : fn(f) {
+        run = [](Task* self) { static_cast<FnTask*>(self)->fn(); };
+        group = nullptr;
+    }
+};
+
+template <typename F>
+FnTask<F> make_task(F f) {
+    return FnTask<F>(f);
+}
+
+class TaskGroup {
+    Atomic<uint32_t> pending;
+
+   public:
+    constexpr TaskGroup() : pending(0) {
+    }
+
+    TaskGroup(const TaskGroup&) = delete;
+
+    // Queue t on this core; it may run on any core before sync() returns
+    void spawn(Task& t);
+
+    // Run queued work until every task spawned into this group has finished
+    void sync();
+
+    // Called by the pool when one of this group's tasks has run
+    void task_done() {
+        pending.fetch_add((uint32_t)-1);
+    }
+
+    bool idle() {
+        return pending.load_acquire() == 0;
+    }
+};
+
+// Single-owner deque: push/pop from the owning core only, steal from anywhere.
+// Fixed capacity; spawn runs the task inline when it is full.
+class WorkDeque {
+   public:
+    static constexpr int64_t CAPACITY = 1024;  // power of two
+
+   private:
+    alignas(CACHE_LINE_SIZE) int64_t top;
+    alignas(CACHE_LINE_SIZE) int64_t bottom;
+    Task* tasks[CAPACITY];
+
+   public:
+    constexpr WorkDeque() : top(0), bottom(0), tasks() {
+    }
+
+    bool push(Task* t);
+    Task* pop();
+    Task* steal();
+
+    bool empty() {
+        return __atomic_load_n(&bottom, __ATOMIC_ACQUIRE) <= __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+    }
+};
+
+class WorkPool {
+   public:
+    // Run one task from this core's deque or stolen from another core;
+    // false if there was nothing to run
+    static bool run_one();
+
+    // Steal and run tasks until stop is set, sleeping in wfe when idle
+    static void work_until(Atomic<bool>& stop);
+
+    // Start a worker thread on every other core / stop and reap them. Not
+    // reentrant: one owner at a time.
+    static void start();
+    static void stop();
+
+    // Tasks this core has stolen from others
+    static uint64_t steals(uint32_t core);
+};
+
+#endif // _WORKPOOL_H_
@@ -0,0 +1,1152 @@
+#include "bench.h"
+#include "atomic.h"
+#include "bulkmem.h"
+#include "channel.h"
+#include "coro.h"
+#include "core.h"
+#include "heap.h"
+#include "ipi.h"
+#include "irq.h"
+#include "irqlat.h"
+#include "parallel.h"
+#include "percpu.h"
+#include "queue.h"
+#include "rcu.h"
+#include "sync.h"
+#include "syscall.h"
+#include "sched.h"
+#include "softirq.h"
+#include "fpsimd.h"
+#include "timekeeping.h"
+#include "timer.h"
+#include "uart.h"
+#include "workpool.h"
+#include "utils.h"
+#include "vm.h"
+#include "peripherals/local_intc.h"
+
+static bool benches_registered = false;
+
+static constexpr uint64_t BARRIER_ITERS = 10000;
+
+static SenseBarrier sense_barrier(CORE_COUNT);
+static TreeBarrier<CORE_COUNT, 2> tree_barrier(CORE_COUNT);
+
+// One 4-core round trip per iteration: every core arrives, every core leaves
+void bench_sense_barrier() {
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < BARRIER_ITERS; i++) {
+        sense_barrier.sync();
+    }
+    BenchFramework::report("sense_barrier", BARRIER_ITERS, BenchFramework::now() - start);
+}
+
+void bench_tree_barrier() {
+    uint32_t id = getCoreID();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < BARRIER_ITERS; i++) {
+        tree_barrier.sync(id);
+    }
+    BenchFramework::report("tree_barrier", BARRIER_ITERS, BenchFramework::now() - start);
+}
+
+// Read-mostly list: readers walk the whole list, core 0 also updates it
+struct BenchNode {
+    RcuHead rcu;  // first member, so the callback can cast back
+    uint64_t value;
+    BenchNode* next;
+};
+
+static constexpr int LIST_LENGTH = 64;
+static constexpr uint64_t LIST_READ_ITERS = 20000;
+static constexpr uint64_t LIST_UPDATE_EVERY = 64;
+static const uint32_t list_reader_counts[] = {1, 2, 4};
+static const char* rcu_list_names[] = {"rcu_list_read_1core", "rcu_list_read_2cores",
+                                       "rcu_list_read_4cores"};
+static const char* locked_list_names[] = {"spinlock_list_read_1core",
+                                          "spinlock_list_read_2cores",
+                                          "spinlock_list_read_4cores"};
+
+static BenchNode* rcu_list = nullptr;
+static BenchNode* locked_list = nullptr;
+static SpinLock list_lock("bench_list");
+static volatile uint64_t list_sink;
+
+static BenchNode* build_list() {
+    BenchNode* head = nullptr;
+    for (int i = 0; i < LIST_LENGTH; i++) {
+        BenchNode* n = new BenchNode;
+        n->value = i;
+        n->next = head;
+        head = n;
+    }
+    return head;
+}
+
+static void free_list(BenchNode* head) {
+    while (head) {
+        BenchNode* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+static void free_bench_node(RcuHead* head) {
+    delete (BenchNode*)head;
+}
+
+void bench_rcu_list_read() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) rcu_list = build_list();
+
+    for (int round = 0; round < 3; round++) {
+        BenchFramework::sync();
+        if (core_id >= list_reader_counts[round]) continue;
+
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < LIST_READ_ITERS; i++) {
+            uint64_t sum = 0;
+            rcu_read_lock();
+            for (BenchNode* n = rcu_dereference(rcu_list); n; n = rcu_dereference(n->next)) {
+                sum += n->value;
+            }
+            rcu_read_unlock();
+            list_sink = sum;
+
+            // Copy-update the head; the old copy is freed after a grace period
+            if (core_id == 0 && i % LIST_UPDATE_EVERY == 0) {
+                BenchNode* old = rcu_list;
+                BenchNode* copy = new BenchNode;
+                copy->value = old->value + 1;
+                copy->next = old->next;
+                rcu_assign_pointer(rcu_list, copy);
+                call_rcu(&old->rcu, free_bench_node);
+            }
+            rcu_quiescent_state();
+        }
+        BenchFramework::report(rcu_list_names[round], LIST_READ_ITERS,
+                               BenchFramework::now() - start);
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) {
+        // Every other core is parked in sync(), so this cannot block
+        synchronize_rcu();
+        while (rcu_pending_callbacks() != 0) rcu_quiescent_state();
+        free_list(rcu_list);
+        rcu_list = nullptr;
+    }
+}
+
+void bench_spinlock_list_read() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) locked_list = build_list();
+
+    for (int round = 0; round < 3; round++) {
+        BenchFramework::sync();
+        if (core_id >= list_reader_counts[round]) continue;
+
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < LIST_READ_ITERS; i++) {
+            uint64_t sum = 0;
+            list_lock.lock();
+            for (BenchNode* n = locked_list; n; n = n->next) {
+                sum += n->value;
+            }
+            if (core_id == 0 && i % LIST_UPDATE_EVERY == 0) {
+                locked_list->value++;
+            }
+            list_lock.unlock();
+            list_sink = sum;
+        }
+        BenchFramework::report(locked_list_names[round], LIST_READ_ITERS,
+                               BenchFramework::now() - start);
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) {
+        free_list(locked_list);
+        locked_list = nullptr;
+    }
+}
+
+// Each active core enqueues then dequeues, so the queue never overflows or
+// underflows no matter how the cores interleave
+static constexpr uint64_t QUEUE_ITERS = 20000;
+static constexpr uint32_t QUEUE_BATCH = 16;
+static Queue<int, SpinLock>* locked_queue = nullptr;
+static MPMCRing<int>* mpmc_ring = nullptr;
+
+void bench_locked_queue() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) locked_queue = new Queue<int, SpinLock>(64);
+
+    for (uint32_t active = 1; active <= CORE_COUNT; active++) {
+        BenchFramework::sync();
+        if (core_id >= active) continue;
+
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < QUEUE_ITERS; i++) {
+            locked_queue->enqueue((int)i);
+            locked_queue->dequeue();
+        }
+        char name[48];
+        sprintf(name, "locked_queue_%ucores", active);
+        BenchFramework::report(name, QUEUE_ITERS, BenchFramework::now() - start);
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) delete locked_queue;
+}
+
+void bench_mpmc_ring() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) mpmc_ring = new MPMCRing<int>(64);
+
+    for (uint32_t active = 1; active <= CORE_COUNT; active++) {
+        BenchFramework::sync();
+        if (core_id >= active) continue;
+
+        int value;
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < QUEUE_ITERS; i++) {
+            while (!mpmc_ring->try_enqueue((int)i)) {
+            }
+            // May briefly see a claimed but unpublished cell from another core
+            while (!mpmc_ring->try_dequeue(value)) {
+            }
+        }
+        char name[48];
+        sprintf(name, "mpmc_ring_%ucores", active);
+        BenchFramework::report(name, QUEUE_ITERS, BenchFramework::now() - start);
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) delete mpmc_ring;
+}
+
+void bench_mpmc_ring_bulk() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) mpmc_ring = new MPMCRing<int>(64);
+
+    for (uint32_t active = 1; active <= CORE_COUNT; active++) {
+        BenchFramework::sync();
+        if (core_id >= active) continue;
+
+        int batch[QUEUE_BATCH];
+        for (uint32_t i = 0; i < QUEUE_BATCH; i++) batch[i] = i;
+
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < QUEUE_ITERS; i += QUEUE_BATCH) {
+            for (uint32_t done = 0; done < QUEUE_BATCH;) {
+                done += mpmc_ring->enqueue_bulk(batch + done, QUEUE_BATCH - done);
+            }
+            for (uint32_t done = 0; done < QUEUE_BATCH;) {
+                done += mpmc_ring->dequeue_bulk(batch + done, QUEUE_BATCH - done);
+            }
+        }
+        char name[48];
+        sprintf(name, "mpmc_ring_bulk%u_%ucores", QUEUE_BATCH, active);
+        BenchFramework::report(name, QUEUE_ITERS, BenchFramework::now() - start);
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) delete mpmc_ring;
+}
+
+// Core-pair messaging over a dedicated mesh so the kernel mesh stays quiet
+static constexpr uint64_t PINGPONG_ITERS = 2000;
+static constexpr uint64_t STREAM_MESSAGES = 20000;
+static ChannelMesh<uint64_t, 256> bench_channels;
+
+// Round-trip latency for every unordered core pair
+void bench_spsc_pingpong() {
+    uint32_t core_id = getCoreID();
+
+    for (uint32_t a = 0; a < CORE_COUNT; a++) {
+        for (uint32_t b = a + 1; b < CORE_COUNT; b++) {
+            BenchFramework::sync();
+            SPSCChannel<uint64_t, 256>& ping = bench_channels.channel(a, b);
+            SPSCChannel<uint64_t, 256>& pong = bench_channels.channel(b, a);
+            uint64_t value;
+
+            if (core_id == a) {
+                uint64_t start = BenchFramework::now();
+                for (uint64_t i = 0; i < PINGPONG_ITERS; i++) {
+                    while (!ping.try_send(i)) {
+                    }
+                    while (!pong.try_recv(value)) {
+                    }
+                }
+                char name[48];
+                sprintf(name, "spsc_pingpong_%u_%u", a, b);
+                BenchFramework::report(name, PINGPONG_ITERS, BenchFramework::now() - start);
+            } else if (core_id == b) {
+                for (uint64_t i = 0; i < PINGPONG_ITERS; i++) {
+                    while (!ping.try_recv(value)) {
+                    }
+                    while (!pong.try_send(value)) {
+                    }
+                }
+            }
+        }
+    }
+}
+
+// One-way streaming throughput for every ordered core pair, timed on the
+// receiving core
+void bench_spsc_stream() {
+    uint32_t core_id = getCoreID();
+
+    for (uint32_t a = 0; a < CORE_COUNT; a++) {
+        for (uint32_t b = 0; b < CORE_COUNT; b++) {
+            if (a == b) continue;
+            BenchFramework::sync();
+            SPSCChannel<uint64_t, 256>& ch = bench_channels.channel(a, b);
+
+            if (core_id == a) {
+                for (uint64_t i = 0; i < STREAM_MESSAGES; i++) {
+                    while (!ch.try_send(i)) {
+                    }
+                }
+            } else if (core_id == b) {
+                uint64_t value;
+                uint64_t start = BenchFramework::now();
+                for (uint64_t i = 0; i < STREAM_MESSAGES; i++) {
+                    while (!ch.try_recv(value)) {
+                    }
+                }
+                char name[48];
+                sprintf(name, "spsc_stream_%u_%u", a, b);
+                BenchFramework::report(name, STREAM_MESSAGES, BenchFramework::now() - start);
+            }
+        }
+    }
+}
+
+static constexpr uint64_t COUNTER_ITERS = 1000000;
+
+// All four counters share one cache line, so every increment bounces it
+// between cores
+static uint64_t packed_counters[CORE_COUNT] __attribute__((aligned(CACHE_LINE_SIZE)));
+static PerCPUCounter<uint64_t> padded_counters;
+
+void bench_counter_packed() {
+    uint64_t& mine = packed_counters[this_core()];
+    BenchFramework::sync();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < COUNTER_ITERS; i++) {
+        __atomic_store_n(&mine, __atomic_load_n(&mine, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+    }
+    BenchFramework::report("counter_packed", COUNTER_ITERS, BenchFramework::now() - start);
+}
+
+void bench_counter_percpu() {
+    BenchFramework::sync();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < COUNTER_ITERS; i++) {
+        padded_counters.inc();
+    }
+    BenchFramework::report("counter_percpu", COUNTER_ITERS, BenchFramework::now() - start);
+}
+
+// Every core hammers one lock around a short critical section
+static constexpr uint64_t LOCK_ITERS = 20000;
+static SpinLock contended_spinlock("bench_contended");
+static Mutex contended_mutex;
+static volatile uint64_t contended_counter;
+
+void bench_spinlock_contended() {
+    BenchFramework::sync();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < LOCK_ITERS; i++) {
+        LockGuard<SpinLock> g{contended_spinlock};
+        contended_counter = contended_counter + 1;
+    }
+    BenchFramework::report("spinlock_contended", LOCK_ITERS, BenchFramework::now() - start);
+}
+
+void bench_mutex_contended() {
+    BenchFramework::sync();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < LOCK_ITERS; i++) {
+        LockGuard<Mutex> g{contended_mutex};
+        contended_counter = contended_counter + 1;
+    }
+    BenchFramework::report("mutex_contended", LOCK_ITERS, BenchFramework::now() - start);
+}
+
+// Sleep/wake round trip between cores 0 and 1: each down() finds the count
+// at zero, so every iteration goes through futex_wait and futex_wake
+static constexpr uint64_t SEM_PINGPONG_ITERS = 2000;
+static Semaphore sem_ping(0);
+static Semaphore sem_pong(0);
+
+void bench_semaphore_pingpong() {
+    uint32_t core_id = getCoreID();
+    BenchFramework::sync();
+    if (core_id == 0) {
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < SEM_PINGPONG_ITERS; i++) {
+            sem_ping.up();
+            sem_pong.down();
+        }
+        BenchFramework::report("semaphore_pingpong", SEM_PINGPONG_ITERS, BenchFramework::now() - start);
+    } else if (core_id == 1) {
+        for (uint64_t i = 0; i < SEM_PINGPONG_ITERS; i++) {
+            sem_ping.down();
+            sem_pong.up();
+        }
+    }
+}
+
+// Two threads on one core yielding to each other; every yield is a switch
+static constexpr uint64_t SWITCH_ITERS = 20000;
+
+// With use_fp both threads write a SIMD register between yields, so every
+// switch also takes the lazy FP trap and a save/restore
+struct YieldPartner {
+    volatile bool stop;
+    volatile bool done;
+    bool use_fp;
+};
+
+static void yield_partner_thread(void* arg) {
+    YieldPartner* p = (YieldPartner*)arg;
+    while (!p->stop) {
+        if (p->use_fp) fpsimd_probe_write(2);
+        yield();
+    }
+    p->done = true;
+}
+
+static void run_context_switch(const char* name, bool use_fp) {
+    YieldPartner partner{false, false, use_fp};
+    thread_create("yield_partner", yield_partner_thread, &partner);
+    yield();  // let it start so the timed loop only sees steady-state switches
+
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < SWITCH_ITERS; i++) {
+        if (use_fp) fpsimd_probe_write(1);
+        yield();
+    }
+    uint64_t elapsed = BenchFramework::now() - start;
+
+    partner.stop = true;
+    while (!partner.done) {
+        yield();
+    }
+    BenchFramework::report(name, 2 * SWITCH_ITERS, elapsed);
+}
+
+void bench_context_switch() {
+    run_context_switch("context_switch", false);
+}
+
+void bench_context_switch_fp() {
+    run_context_switch("context_switch_fp", true);
+}
+
+// Cost of the scheduler tick itself, measured inside the handler while the
+// core spins for a fixed number of ticks. A yielding partner keeps the run
+// queue non-empty, otherwise the tick would stop.
+static constexpr uint64_t TICK_SAMPLE = 50;
+
+void bench_tick_overhead() {
+    uint32_t core = getCoreID();
+    YieldPartner partner{false, false, false};
+    thread_create("yield_partner", yield_partner_thread, &partner);
+
+    timer_tick_stats_reset();
+    uint64_t end = timer_count() + TICK_SAMPLE * timer_frequency() / SCHED_TICK_HZ;
+    while (timer_count() < end) {
+    }
+    TickStats s = timer_tick_stats(core);
+
+    partner.stop = true;
+    while (!partner.done) {
+        yield();
+    }
+    BenchFramework::report("tick_handler", s.ticks, s.cycles_total);
+    BenchFramework::report("tick_handler_max", 1, s.cycles_max);
+}
+
+// Every core sleeps repeatedly on an otherwise idle run queue: how late the
+// thread runs after its deadline, and how much of the time the core spent
+// in wfi
+static constexpr uint64_t SLEEP_ITERS = 200;
+
+void bench_wakeup_latency() {
+    uint32_t core = getCoreID();
+    uint64_t period = timer_frequency() / 1000;  // 1ms
+
+    sched_idle_stats_reset();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < SLEEP_ITERS; i++) {
+        // Vary the phase so deadlines don't line up with anything periodic
+        sleep_until(timer_count() + period + (i * 7919) % period);
+    }
+    uint64_t elapsed = BenchFramework::now() - start;
+    IdleStats s = sched_idle_stats(core);
+
+    BenchFramework::report("wakeup_latency", s.wakeups, s.wakeup_latency_total);
+    BenchFramework::report("wakeup_latency_max", 1, s.wakeup_latency_max);
+    BenchFramework::report("idle_wfi", s.idle_entries, s.idle_total);
+    BenchFramework::report("sleep_window", SLEEP_ITERS, elapsed);
+}
+
+// 100k timers on core 0's wheel: add and cancel with the wheel fully
+// populated, then expiry of all of them in IRQ batches
+static constexpr uint32_t WHEEL_TIMERS = 100000;
+static volatile uint32_t wheel_fired;
+
+static void count_fired(TimerEvent*) {
+    wheel_fired = wheel_fired + 1;
+}
+
+static void add_spread(TimerEvent* evs, uint64_t base, uint64_t spread) {
+    uint32_t x = 12345;
+    for (uint32_t i = 0; i < WHEEL_TIMERS; i++) {
+        x = x * 1103515245 + 12345;
+        evs[i].deadline = base + x % spread;
+        evs[i].fn = count_fired;
+        timer_add(evs[i]);
+    }
+}
+
+void bench_timer_wheel() {
+    if (getCoreID() != 0) return;
+    TimerEvent* evs = new TimerEvent[WHEEL_TIMERS];
+    uint64_t freq = timer_frequency();
+
+    // 1-11s out, so the timers land on every level up to 3
+    uint64_t start = BenchFramework::now();
+    add_spread(evs, timer_count() + freq, 10 * freq);
+    BenchFramework::report("timer_add_100k", WHEEL_TIMERS, BenchFramework::now() - start);
+
+    start = BenchFramework::now();
+    for (uint32_t i = 0; i < WHEEL_TIMERS; i++) {
+        timer_cancel(evs[i]);
+    }
+    BenchFramework::report("timer_cancel_100k", WHEEL_TIMERS, BenchFramework::now() - start);
+
+    // All due within 200ms
+    wheel_fired = 0;
+    timer_stats_reset();
+    add_spread(evs, timer_count() + freq / 100, freq / 5);
+    while (wheel_fired < WHEEL_TIMERS) {
+        cpu_relax();
+    }
+    TimerStats s = timer_stats(0);
+    BenchFramework::report("timer_expire_100k", s.expired, s.cycles_total);
+    BenchFramework::report("timer_expire_batch", s.batches, s.cycles_total);
+
+    delete[] evs;
+}
+
+// Core 0 interrupts the others while they wait at the benchmark barrier;
+// each iteration is a full send, remote IRQ, completion round trip
+static constexpr uint64_t IPI_ITERS = 2000;
+
+static void ipi_noop(void*) {
+}
+
+void bench_ipi_roundtrip() {
+    uint32_t core_id = getCoreID();
+
+    for (uint32_t target = 1; target < CORE_COUNT; target++) {
+        BenchFramework::sync();
+        if (core_id == 0) {
+            uint64_t start = BenchFramework::now();
+            for (uint64_t i = 0; i < IPI_ITERS; i++) {
+                smp_call_function_single(target, ipi_noop, nullptr);
+            }
+            char name[48];
+            sprintf(name, "ipi_roundtrip_0_%u", target);
+            BenchFramework::report(name, IPI_ITERS, BenchFramework::now() - start);
+        }
+    }
+}
+
+void bench_ipi_broadcast() {
+    if (getCoreID() == 0) {
+        uint64_t start = BenchFramework::now();
+        for (uint64_t i = 0; i < IPI_ITERS; i++) {
+            smp_call_function(ipi_noop, nullptr);
+        }
+        BenchFramework::report("ipi_call_all", IPI_ITERS, BenchFramework::now() - start);
+
+        start = BenchFramework::now();
+        for (uint64_t i = 0; i < IPI_ITERS; i++) {
+            smp_flush_tlb_all();
+        }
+        BenchFramework::report("tlb_shootdown_all", IPI_ITERS, BenchFramework::now() - start);
+    }
+}
+
+// Fork-join speedup: core 0 runs the root computation while cores
+// 1..count-1 steal from it
+static const uint32_t pool_core_counts[] = {1, 2, 4};
+static Atomic<bool> pool_done(false);
+
+// Returns the time root took on core 0, 0 on the other cores
+template <typename Root>
+static uint64_t time_on_pool(uint32_t count, Root root) {
+    uint32_t core_id = getCoreID();
+    BenchFramework::sync();
+    if (core_id == 0) pool_done.set(false);
+    BenchFramework::sync();
+
+    uint64_t elapsed = 0;
+    if (core_id == 0) {
+        uint64_t start = BenchFramework::now();
+        root();
+        elapsed = BenchFramework::now() - start;
+        pool_done.set(true);
+        sev();
+    } else if (core_id < count) {
+        WorkPool::work_until(pool_done);
+    }
+    return elapsed;
+}
+
+template <typename Root>
+static void run_on_pool(uint32_t count, const char* fmt, Root root) {
+    uint64_t elapsed = time_on_pool(count, root);
+    if (getCoreID() == 0) {
+        char name[48];
+        sprintf(name, fmt, count);
+        BenchFramework::report(name, 1, elapsed);
+    }
+}
+
+static constexpr uint32_t FIB_N = 27;
+static constexpr uint32_t FIB_CUTOFF = 16;
+static volatile uint64_t fib_sink;
+
+static uint64_t fib_seq(uint32_t n) {
+    return n < 2 ? n : fib_seq(n - 1) + fib_seq(n - 2);
+}
+
+static uint64_t fib_par(uint32_t n) {
+    if (n < FIB_CUTOFF) return fib_seq(n);
+    uint64_t a, b;
+    TaskGroup g;
+    auto left = make_task([&a, n] { a = fib_par(n - 1); });
+    g.spawn(left);
+    b = fib_par(n - 2);
+    g.sync();
+    return a + b;
+}
+
+void bench_fib_pool() {
+    for (uint32_t count : pool_core_counts) {
+        run_on_pool(count, "fib_pool_%ucores", [] { fib_sink = fib_par(FIB_N); });
+    }
+}
+
+static constexpr uint32_t SORT_N = 1 << 16;
+static constexpr uint32_t SORT_CUTOFF = 2048;
+static uint32_t* sort_data = nullptr;
+static uint32_t* sort_tmp = nullptr;
+
+static void merge_halves(uint32_t* a, uint32_t* tmp, uint32_t n) {
+    uint32_t mid = n / 2, i = 0, j = mid, k = 0;
+    while (i < mid && j < n) tmp[k++] = a[i] <= a[j] ? a[i++] : a[j++];
+    while (i < mid) tmp[k++] = a[i++];
+    while (j < n) tmp[k++] = a[j++];
+    for (k = 0; k < n; k++) a[k] = tmp[k];
+}
+
+static void sort_seq(uint32_t* a, uint32_t* tmp, uint32_t n) {
+    if (n < 2) return;
+    sort_seq(a, tmp, n / 2);
+    sort_seq(a + n / 2, tmp + n / 2, n - n / 2);
+    merge_halves(a, tmp, n);
+}
+
+static void sort_par(uint32_t* a, uint32_t* tmp, uint32_t n) {
+    if (n <= SORT_CUTOFF) {
+        sort_seq(a, tmp, n);
+        return;
+    }
+    TaskGroup g;
+    auto left = make_task([a, tmp, n] { sort_par(a, tmp, n / 2); });
+    g.spawn(left);
+    sort_par(a + n / 2, tmp + n / 2, n - n / 2);
+    g.sync();
+    merge_halves(a, tmp, n);
+}
+
+void bench_mergesort_pool() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) {
+        sort_data = (uint32_t*)kmalloc(SORT_N * sizeof(uint32_t));
+        sort_tmp = (uint32_t*)kmalloc(SORT_N * sizeof(uint32_t));
+    }
+
+    for (uint32_t count : pool_core_counts) {
+        if (core_id == 0) {
+            uint32_t x = 12345;
+            for (uint32_t i = 0; i < SORT_N; i++) {
+                x = x * 1103515245 + 12345;
+                sort_data[i] = x;
+            }
+        }
+        run_on_pool(count, "mergesort_pool_%ucores", [] { sort_par(sort_data, sort_tmp, SORT_N); });
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) {
+        for (uint32_t i = 1; i < SORT_N; i++) {
+            if (sort_data[i - 1] > sort_data[i]) {
+                printf("mergesort_pool: output not sorted at %u\n", i);
+                break;
+            }
+        }
+        kfree(sort_data);
+        kfree(sort_tmp);
+    }
+}
+
+// Coroutines, on every core's own executor. Awaiting a task that finishes
+// without suspending costs a pooled frame and a call; spawning one goes
+// through the executor's ready queue and a thread wakeup.
+static constexpr uint32_t CORO_TASKS = 10000;
+static constexpr uint32_t CORO_SLEEPERS = 4000;
+
+static WaitQueue coro_join_wq{"coro_bench"};
+
+struct CoroJoin {
+    Atomic<int> left{0};
+
+    void done() {
+        if (left.add_fetch(-1) == 0) coro_join_wq.wake_all();
+    }
+
+    void wait() {
+        wait_event(coro_join_wq, [this] { return left.load_acquire() == 0; });
+    }
+};
+
+static CoTask<int> coro_noop(int x) {
+    co_return x;
+}
+
+static CoTask<void> coro_await_many(uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) co_await coro_noop(i);
+}
+
+static CoTask<void> coro_count_down(CoroJoin& j) {
+    j.done();
+    co_return;
+}
+
+static CoTask<void> coro_sleeper(uint64_t deadline, CoroJoin& j) {
+    co_await co_sleep_until(deadline);
+    j.done();
+}
+
+void bench_coro_tasks() {
+    uint64_t start = BenchFramework::now();
+    block_on(coro_await_many(CORO_TASKS));
+    BenchFramework::report("coro_await_10k", CORO_TASKS, BenchFramework::now() - start);
+
+    CoroJoin j;
+    j.left = CORO_TASKS;
+    start = BenchFramework::now();
+    for (uint32_t i = 0; i < CORO_TASKS; i++) {
+        coro_spawn(coro_count_down(j));
+    }
+    j.wait();
+    BenchFramework::report("coro_spawn_10k", CORO_TASKS, BenchFramework::now() - start);
+}
+
+// Thousands of concurrent sleepers per core, due over 100ms: the cost is
+// one wheel timer and one small frame each, not a thread and its stack
+void bench_coro_sleepers() {
+    uint32_t core = getCoreID();
+    uint64_t freq = timer_frequency();
+    CoroStats before = coro_stats(core);
+
+    CoroJoin j;
+    j.left = CORO_SLEEPERS;
+    uint64_t start = BenchFramework::now();
+    uint64_t first = timer_count() + freq / 100;
+    for (uint32_t i = 0; i < CORO_SLEEPERS; i++) {
+        coro_spawn(coro_sleeper(first + i * (freq / 10) / CORO_SLEEPERS, j));
+    }
+    j.wait();
+    BenchFramework::report("coro_sleepers_4k", CORO_SLEEPERS, BenchFramework::now() - start);
+
+    CoroStats after = coro_stats(core);
+    if (core == 0) {
+        printf("coro_sleepers: %llu KB of new frame slabs for %u sleepers\n",
+               (after.slabs - before.slabs) * CORO_FRAME_SLAB / 1024, CORO_SLEEPERS);
+    }
+}
+
+// Deferred IRQ work. A tasklet that keeps rescheduling itself measures the
+// softirq dispatch path; a burst of timers on every core then shows where
+// interrupt time goes: masked in handle_irq, or in passes on IRQ exit and
+// in softirqd.
+static constexpr uint32_t TASKLET_ITERS = 10000;
+static constexpr uint32_t SOFTIRQ_TIMERS = 2000;
+
+struct BenchTasklet {
+    Tasklet t;  // must stay first
+    volatile uint32_t left;
+};
+
+static void bench_tasklet_fn(Tasklet* t) {
+    BenchTasklet* b = (BenchTasklet*)t;
+    b->left = b->left - 1;
+    if (b->left) tasklet_schedule(b->t);
+}
+
+static PerCPU<uint32_t> softirq_timers_fired;
+
+static void count_softirq_timer(TimerEvent*) {
+    softirq_timers_fired.mine()++;
+}
+
+void bench_softirq() {
+    uint32_t core = getCoreID();
+
+    BenchTasklet b{{bench_tasklet_fn}, TASKLET_ITERS};
+    uint64_t start = BenchFramework::now();
+    tasklet_schedule(b.t);
+    while (b.left) yield();
+    BenchFramework::report("tasklet_dispatch", TASKLET_ITERS, BenchFramework::now() - start);
+
+    TimerEvent* evs = new TimerEvent[SOFTIRQ_TIMERS];
+    uint64_t freq = timer_frequency();
+    softirq_timers_fired.mine() = 0;
+    softirq_stats_reset();
+    uint64_t first = timer_count() + freq / 100;
+    for (uint32_t i = 0; i < SOFTIRQ_TIMERS; i++) {
+        evs[i].deadline = first + i * (freq / 10) / SOFTIRQ_TIMERS;
+        evs[i].fn = count_softirq_timer;
+        timer_add(evs[i]);
+    }
+    while (__atomic_load_n(&softirq_timers_fired.mine(), __ATOMIC_RELAXED) < SOFTIRQ_TIMERS) {
+        cpu_relax();
+    }
+    SoftirqStats s = softirq_stats(core);
+    BenchFramework::report("hardirq_masked", s.hardirqs, s.hardirq_cycles);
+    BenchFramework::report("softirq_exit_pass", s.exit_passes, s.exit_cycles);
+    BenchFramework::report("softirq_thread_pass", s.thread_passes, s.thread_cycles);
+    BenchFramework::report("softirq_timer", s.runs[(uint32_t)SoftirqType::Timer],
+                           s.cycles[(uint32_t)SoftirqType::Timer]);
+    delete[] evs;
+}
+
+// Bulk memory. Core 0 fills and copies buffers of 1-64MB split over 1, 2
+// and 4 cores while the others wait at the barrier, where they serve the
+// call IPIs. The buffers are plain RAM above the kernel image and heap that
+// nothing else uses. ns_per_op is per KB.
+static constexpr size_t BULK_MAX = 64 * 1024 * 1024;
+static uint8_t* const bulk_dst = (uint8_t*)(VA_START | 0x10000000);
+static uint8_t* const bulk_src = (uint8_t*)(VA_START | 0x14000000);
+
+void bench_bulkmem() {
+    if (getCoreID() != 0) return;
+    static constexpr uint32_t CORE_SPLITS[] = {1, 2, 4};
+    char name[48];
+
+    parallel_memset(bulk_src, 0x5A, BULK_MAX);
+    for (size_t size = 1024 * 1024; size <= BULK_MAX; size *= 4) {
+        for (uint32_t cores : CORE_SPLITS) {
+            uint64_t start = BenchFramework::now();
+            parallel_memset(bulk_dst, 0, size, cores);
+            uint64_t ticks = BenchFramework::now() - start;
+            sprintf(name, "pmemset_%lluMB_%ucores", (uint64_t)(size >> 20), cores);
+            BenchFramework::report(name, size / 1024, ticks);
+
+            start = BenchFramework::now();
+            parallel_memcpy(bulk_dst, bulk_src, size, cores);
+            ticks = BenchFramework::now() - start;
+            sprintf(name, "pmemcpy_%lluMB_%ucores", (uint64_t)(size >> 20), cores);
+            BenchFramework::report(name, size / 1024, ticks);
+        }
+    }
+}
+
+// Parallel algorithms against their sequential fallbacks at a few sizes:
+// sequential on core 0 alone, then PAR_DEFAULT with every core in the pool.
+// Each pair is followed by the speedup.
+static constexpr uint32_t PAR_SIZES[] = {1 << 14, 1 << 17, 1 << 20};
+static constexpr uint32_t PAR_MAX_N = 1 << 20;
+static uint32_t* par_data = nullptr;
+static uint32_t* par_out = nullptr;
+
+static void par_fill(uint32_t n) {
+    uint32_t x = 12345;
+    for (uint32_t i = 0; i < n; i++) {
+        x = x * 1103515245 + 12345;
+        par_data[i] = x;
+    }
+}
+
+static uint32_t par_add(uint32_t a, uint32_t b) {
+    return a + b;
+}
+
+static uint64_t par_add64(uint64_t a, uint32_t b) {
+    return a + b;
+}
+
+static void par_scale(uint32_t& x) {
+    x = x * 3 + 1;
+}
+
+// setup runs on core 0 before each timed run
+template <typename Setup, typename Run>
+static void par_compare(const char* algo, uint32_t n, Setup setup, Run run) {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) setup();
+    uint64_t seq = time_on_pool(1, [&] { run(PAR_SEQUENTIAL); });
+    if (core_id == 0) setup();
+    uint64_t par = time_on_pool(CORE_COUNT, [&] { run(PAR_DEFAULT); });
+    if (core_id != 0) return;
+
+    char name[48];
+    sprintf(name, "%s_%uK_seq", algo, n / 1024);
+    BenchFramework::report(name, n, seq);
+    sprintf(name, "%s_%uK_%ucores", algo, n / 1024, CORE_COUNT);
+    BenchFramework::report(name, n, par);
+    uint64_t x100 = par ? seq * 100 / par : 0;
+    printf("%s_%uK: speedup %llu.%02llux\n", algo, n / 1024, x100 / 100, x100 % 100);
+}
+
+static volatile uint64_t par_sink;
+
+void bench_parallel_algorithms() {
+    uint32_t core_id = getCoreID();
+    if (core_id == 0) {
+        par_data = new uint32_t[PAR_MAX_N];
+        par_out = new uint32_t[PAR_MAX_N];
+    }
+
+    for (uint32_t n : PAR_SIZES) {
+        auto fill = [n] { par_fill(n); };
+        par_compare("par_for_each", n, fill, [n](const PartitionPolicy& p) {
+            par::for_each(par_data, par_data + n, par_scale, p);
+        });
+        par_compare("par_reduce", n, fill, [n](const PartitionPolicy& p) {
+            par_sink = par::reduce(par_data, par_data + n, (uint64_t)0, par_add64, p);
+        });
+        par_compare("par_scan", n, fill, [n](const PartitionPolicy& p) {
+            par::inclusive_scan(par_data, par_data + n, par_out, par_add, p);
+        });
+        par_compare("par_sort", n, fill, [n](const PartitionPolicy& p) {
+            par::sort(par_data, par_data + n, p);
+        });
+
+        if (core_id == 0) {
+            for (uint32_t i = 1; i < n; i++) {
+                if (par_data[i - 1] > par_data[i]) {
+                    printf("par_sort: output not sorted at %u\n", i);
+                    break;
+                }
+            }
+        }
+    }
+
+    BenchFramework::sync();
+    if (core_id == 0) {
+        delete[] par_data;
+        delete[] par_out;
+    }
+}
+
+// IRQ dispatch: every core raises mailbox 2 on itself and waits for the
+// handler, so one iteration is a full exception entry, the decode, the
+// handler and the way out
+static constexpr uint64_t IRQ_ITERS = 20000;
+static constexpr uint32_t BENCH_MBOX = 2;
+static PerCPU<uint64_t> bench_mbox_hits;
+
+static void bench_mbox_irq(void*) {
+    uint32_t me = this_core();
+    put32(CORE_MBOX_RDCLR(me, BENCH_MBOX), get32(CORE_MBOX_RDCLR(me, BENCH_MBOX)));
+    __atomic_add_fetch(&bench_mbox_hits.mine(), 1, __ATOMIC_RELAXED);
+}
+
+void bench_irq_dispatch() {
+    uint32_t irq = irq_local_mailbox(BENCH_MBOX);
+    uint32_t me = this_core();
+    request_irq(irq, bench_mbox_irq, nullptr);
+    enable_irq(irq);
+
+    uint64_t& hits = bench_mbox_hits.mine();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 1; i <= IRQ_ITERS; i++) {
+        put32(CORE_MBOX_SET(me, BENCH_MBOX), 1);
+        while (__atomic_load_n(&hits, __ATOMIC_RELAXED) < i) cpu_relax();
+    }
+    BenchFramework::report("irq_self_mailbox", IRQ_ITERS, BenchFramework::now() - start);
+    hits = 0;
+
+    disable_irq(irq);
+    BenchFramework::sync();
+    if (me == 0) free_irq(irq);
+}
+
+// IRQ latency from a timer deadline to the vector, the handler and back in
+// the interrupted code (irqlat.h): first every core at once, then core 0
+// alone while the others idle, churn the heap or print
+static constexpr uint32_t IRQLAT_ROUNDS = 2000;
+static PerCPU<IrqLatency> irqlat;
+static volatile bool irqlat_stop = false;
+
+static void irqlat_with_load(const char* name, IrqLoad load) {
+    BenchFramework::sync();
+    if (getCoreID() == 0) {
+        irq_latency_run(irqlat.mine(), IRQLAT_ROUNDS);
+        irqlat_stop = true;
+    } else {
+        irq_latency_load(load, &irqlat_stop);
+    }
+    BenchFramework::sync();
+    if (getCoreID() == 0) {
+        irq_latency_report(name, irqlat.mine());
+        irqlat_stop = false;
+    }
+}
+
+void bench_irq_latency() {
+    irq_latency_run(irqlat.mine(), IRQLAT_ROUNDS);
+    irq_latency_report("all_cores", irqlat.mine());
+    irqlat_with_load("others_idle", IrqLoad::None);
+    irqlat_with_load("others_heap", IrqLoad::Heap);
+    irqlat_with_load("others_printf", IrqLoad::Printf);
+}
+
+// A 2KB console burst from core 0: how long the writer is held up, not how
+// long the UART takes to send it (about 180ms at 115200 baud)
+static constexpr uint32_t UART_BURST = 2048;
+
+void bench_uart_write() {
+    if (getCoreID() != 0) return;
+    static char burst[UART_BURST];
+    for (uint32_t i = 0; i < UART_BURST; i++) {
+        burst[i] = i % 64 == 63 ? '\n' : i % 64 == 62 ? '\r' : '.';
+    }
+
+    uint64_t start = BenchFramework::now();
+    uint64_t queued = uart_write(burst, UART_BURST);
+    BenchFramework::report("uart_write_2k", 1, BenchFramework::now() - start);
+    if (queued < UART_BURST) printf("uart_write_2k: only %llu bytes fit in the ring\n", queued);
+}
+
+// Null syscall round trips on every core: svc #0 through the lean entry,
+// then svc #1 through the full exception frame it replaced. The handler's
+// own share comes from the per-syscall counters.
+static constexpr uint64_t SYSCALL_ITERS = 100000;
+
+void bench_syscall_null() {
+    uint32_t core = getCoreID();
+    syscall_stats_reset();
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < SYSCALL_ITERS; i++) {
+        syscall0(SYS_NULL);
+    }
+    BenchFramework::report("syscall_null_lean", SYSCALL_ITERS, BenchFramework::now() - start);
+    SyscallStats s = syscall_stats(core, SYS_NULL);
+    BenchFramework::report("syscall_null_handler", s.calls, s.cycles);
+
+    start = BenchFramework::now();
+    for (uint64_t i = 0; i < SYSCALL_ITERS; i++) {
+        syscall0_full_frame(SYS_NULL);
+    }
+    BenchFramework::report("syscall_null_full_frame", SYSCALL_ITERS, BenchFramework::now() - start);
+}
+
+// clock_gettime through the syscall against reading the time page directly,
+// as a process does from USER_TIME_PAGE
+void bench_clock_gettime() {
+    Timespec ts;
+    uint64_t start = BenchFramework::now();
+    for (uint64_t i = 0; i < SYSCALL_ITERS; i++) {
+        syscall6(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (uint64_t)&ts, 0, 0, 0, 0);
+    }
+    BenchFramework::report("clock_gettime_syscall", SYSCALL_ITERS, BenchFramework::now() - start);
+
+    const TimePage* tp = time_page();
+    start = BenchFramework::now();
+    for (uint64_t i = 0; i < SYSCALL_ITERS; i++) {
+        time_page_gettime(tp, CLOCK_MONOTONIC, &ts);
+    }
+    BenchFramework::report("clock_gettime_time_page", SYSCALL_ITERS, BenchFramework::now() - start);
+}
+
+void register_all_benches() {
+    if (benches_registered) return;
+    benches_registered = true;
+
+    // Synchronization primitives
+    MANUAL_REGISTER_BENCH(bench_sense_barrier);
+    MANUAL_REGISTER_BENCH(bench_tree_barrier);
+
+    // Read-side scaling
+    MANUAL_REGISTER_BENCH(bench_rcu_list_read);
+    MANUAL_REGISTER_BENCH(bench_spinlock_list_read);
+
+    // Queues
+    MANUAL_REGISTER_BENCH(bench_locked_queue);
+    MANUAL_REGISTER_BENCH(bench_mpmc_ring);
+    MANUAL_REGISTER_BENCH(bench_mpmc_ring_bulk);
+
+    // Inter-core channels
+    MANUAL_REGISTER_BENCH(bench_spsc_pingpong);
+    MANUAL_REGISTER_BENCH(bench_spsc_stream);
+
+    // Per-core data layout
+    MANUAL_REGISTER_BENCH(bench_counter_packed);
+    MANUAL_REGISTER_BENCH(bench_counter_percpu);
+
+    // Sleeping locks
+    MANUAL_REGISTER_BENCH(bench_spinlock_contended);
+    MANUAL_REGISTER_BENCH(bench_mutex_contended);
+    MANUAL_REGISTER_BENCH(bench_semaphore_pingpong);
+
+    // Scheduler
+    MANUAL_REGISTER_BENCH(bench_context_switch);
+    MANUAL_REGISTER_BENCH(bench_context_switch_fp);
+    MANUAL_REGISTER_BENCH(bench_tick_overhead);
+    MANUAL_REGISTER_BENCH(bench_wakeup_latency);
+
+    // Timer wheel
+    MANUAL_REGISTER_BENCH(bench_timer_wheel);
+
+    // Inter-processor interrupts
+    MANUAL_REGISTER_BENCH(bench_ipi_roundtrip);
+    MANUAL_REGISTER_BENCH(bench_ipi_broadcast);
+
+    // Interrupt dispatch
+    MANUAL_REGISTER_BENCH(bench_irq_dispatch);
+    MANUAL_REGISTER_BENCH(bench_irq_latency);
+    MANUAL_REGISTER_BENCH(bench_uart_write);
+
+    // Syscall entry
+    MANUAL_REGISTER_BENCH(bench_syscall_null);
+    MANUAL_REGISTER_BENCH(bench_clock_gettime);
+
+    // Work-stealing pool
+    MANUAL_REGISTER_BENCH(bench_fib_pool);
+    MANUAL_REGISTER_BENCH(bench_mergesort_pool);
+
+    // Coroutines
+    MANUAL_REGISTER_BENCH(bench_coro_tasks);
+    MANUAL_REGISTER_BENCH(bench_coro_sleepers);
+
+    // Deferred IRQ work
+    MANUAL_REGISTER_BENCH(bench_softirq);
+
+    // Bulk memory
+    MANUAL_REGISTER_BENCH(bench_bulkmem);
+
+    // Parallel algorithms
+    MANUAL_REGISTER_BENCH(bench_parallel_algorithms);
+}
@@ -0,0 +1,80 @@
+#include "bench.h"
+#include "atomic.h"
+#include "core.h"
+#include "rcu.h"
+#include "utils.h"
+
+BenchEntry* BenchFramework::first_bench = nullptr;
+BenchEntry* BenchFramework::last_bench = nullptr;
+int BenchFramework::total_benches = 0;
+const int MAX_BENCHES = 64;
+
+static SenseBarrier bench_barrier(CORE_COUNT);
+static SpinLock report_lock;
+
+void BenchFramework::register_bench(const char* name, BenchFunction function) {
+    static BenchEntry bench_entries[MAX_BENCHES];
+    static int next_entry = 0;
+
+    if (next_entry >= MAX_BENCHES) {
+        printf("ERROR: Too many benchmarks registered (max %d)\n", MAX_BENCHES);
+        return;
+    }
+
+    // Append so benchmarks run in the order they were registered
+    BenchEntry* entry = &bench_entries[next_entry++];
+    entry->name = name;
+    entry->function = function;
+    entry->next = nullptr;
+    if (last_bench) {
+        last_bench->next = entry;
+    } else {
+        first_bench = entry;
+    }
+    last_bench = entry;
+    total_benches++;
+}
+
+void BenchFramework::sync() {
+    // Cores parked at the barrier hold no RCU references
+    rcu_idle_enter();
+    bench_barrier.sync();
+    rcu_idle_exit();
+}
+
+void BenchFramework::run_all_benches() {
+    uint64_t core_id = getCoreID();
+    if (core_id == 0) {
+        printf("\n=== KERNEL BENCHMARKS ===\n");
+        printf("Running %d benchmarks on %d cores (timer %lld Hz)...\n\n", total_benches,
+               CORE_COUNT, frequency());
+    }
+
+    for (BenchEntry* current = first_bench; current != nullptr; current = current->next) {
+        sync();
+        if (core_id == 0) {
+            printf("Running benchmark: %s...\n", current->name);
+        }
+        sync();
+        current->function();
+    }
+    sync();
+
+    if (core_id == 0) {
+        printf("=== BENCHMARKS COMPLETED ===\n\n");
+    }
+}
+
+uint64_t BenchFramework::ticks_to_ns(uint64_t ticks) {
+    uint64_t freq = frequency();
+    if (freq == 0) return 0;
+    // Split to avoid overflowing ticks * 1e9 on long runs
+    return (ticks / freq) * 1000000000ULL + ((ticks % freq) * 1000000000ULL) / freq;
+}
+
+void BenchFramework::report(const char* name, uint64_t iters, uint64_t ticks) {
+    uint64_t ns = ticks_to_ns(ticks);
+    LockGuard<SpinLock> g(report_lock);
+    printf("BENCH %s core=%llu iters=%llu ticks=%llu ns=%llu ns_per_op=%llu\n", name,
+           getCoreID(), iters, ticks, ns, iters ? ns / iters : 0);
+}
@@ -0,0 +1,136 @@
+#include "bulkmem.h"
+#include "atomic.h"
+#include "ipi.h"
+#include "libk.h"
+#include "percpu.h"
+
+static constexpr uintptr_t LINE_MASK = CACHE_LINE_SIZE - 1;
+
+// dc zva is usable when it isn't prohibited (DZP) and clears exactly one
+// cache line; otherwise zeroing goes through the store kernel
+static bool zva_ok() {
+    uint64_t dczid;
+    asm volatile("mrs %0, dczid_el0" : "=r"(dczid));
+    return !(dczid & (1 << 4)) && (4u << (dczid & 0xf)) == CACHE_LINE_SIZE;
+}
+
+static void fill_range(uint8_t* d, uint8_t val, uint64_t pattern, size_t n) {
+    size_t head = (CACHE_LINE_SIZE - ((uintptr_t)d & LINE_MASK)) & LINE_MASK;
+    if (head >= n) {
+        K::memset(d, val, n);
+        return;
+    }
+    K::memset(d, val, head);
+    d += head;
+    n -= head;
+
+    size_t body = n & ~LINE_MASK;
+    if (val == 0 && zva_ok()) {
+        memzero_lines(d, body);
+    } else {
+        memfill_lines(d, pattern, body);
+    }
+    K::memset(d + body, val, n - body);
+}
+
+static void copy_range(uint8_t* d, const uint8_t* s, size_t n) {
+    size_t head = (CACHE_LINE_SIZE - ((uintptr_t)d & LINE_MASK)) & LINE_MASK;
+    if (head >= n) {
+        K::memcpy(d, s, (int)n);
+        return;
+    }
+    K::memcpy(d, s, (int)head);
+    d += head;
+    s += head;
+    n -= head;
+
+    // ldp needs no alignment on Normal memory, but a misaligned source splits
+    // every pair; K::memcpy handles those a byte or word at a time anyway
+    size_t body = ((uintptr_t)s & 15) ? 0 : n & ~LINE_MASK;
+    memcopy_lines(d, s, body);
+    d += body;
+    s += body;
+    n -= body;
+    while (n > 0) {
+        int chunk = n > 0x40000000 ? 0x40000000 : (int)n;
+        K::memcpy(d, s, chunk);
+        d += chunk;
+        s += chunk;
+        n -= chunk;
+    }
+}
+
+struct BulkJob {
+    uint8_t* dst;
+    const uint8_t* src;  // nullptr for a fill
+    uint64_t pattern;
+    uint8_t val;
+    size_t n;
+    uint32_t mask;   // cores taking part
+    uint32_t parts;  // popcount(mask)
+};
+
+// Byte offset where part p starts. Interior cuts land on destination cache
+// lines, so neighbouring shares never write the same line.
+static size_t cut(const BulkJob& job, uint32_t p) {
+    if (p == 0) return 0;
+    if (p == job.parts) return job.n;
+    uintptr_t first = ((uintptr_t)job.dst + LINE_MASK) & ~LINE_MASK;
+    size_t lead = first - (uintptr_t)job.dst;
+    if (lead >= job.n) return job.n;
+    size_t lines = (job.n - lead) / CACHE_LINE_SIZE;
+    return lead + lines * p / job.parts * CACHE_LINE_SIZE;
+}
+
+static void run_share(void* arg) {
+    BulkJob& job = *(BulkJob*)arg;
+    uint32_t core = this_core();
+    uint32_t p = __builtin_popcount(job.mask & ((1u << core) - 1));
+    size_t from = cut(job, p);
+    size_t to = cut(job, p + 1);
+    if (from >= to) return;
+
+    if (job.src) {
+        copy_range(job.dst + from, job.src + from, to - from);
+    } else {
+        fill_range(job.dst + from, job.val, job.pattern, to - from);
+    }
+}
+
+static void dispatch(BulkJob& job, uint32_t cores) {
+    if (cores > CORE_COUNT) cores = CORE_COUNT;
+    if (cores == 0) cores = 1;
+    // Waiting for other cores needs IRQs on here and a thread to wait in
+    if (job.n < PARALLEL_MEM_THRESHOLD || Interrupts::isDisabled() ||
+        Interrupts::inInterrupt()) {
+        cores = 1;
+    }
+
+    // Stay on this core while the shares are assigned relative to it
+    Preempt::disable();
+    uint32_t me = this_core();
+    job.mask = 0;
+    for (uint32_t i = 0; i < cores; i++) {
+        job.mask |= 1u << ((me + i) % CORE_COUNT);
+    }
+    job.parts = cores;
+
+    if (cores == 1) {
+        run_share(&job);
+    } else {
+        smp_call_function_mask(job.mask, run_share, &job);
+    }
+    Preempt::enable();
+}
+
+void* parallel_memset(void* dst, uint8_t val, size_t n, uint32_t cores) {
+    BulkJob job{(uint8_t*)dst, nullptr, val * 0x0101010101010101ull, val, n, 0, 0};
+    dispatch(job, cores);
+    return dst;
+}
+
+void* parallel_memcpy(void* dst, const void* src, size_t n, uint32_t cores) {
+    BulkJob job{(uint8_t*)dst, (const uint8_t*)src, 0, 0, n, 0, 0};
+    dispatch(job, cores);
+    return dst;
+}
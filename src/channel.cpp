@@ -0,0 +1,3 @@
+#include "channel.h"
+
+ChannelMesh<CoreMessage, CORE_CHANNEL_CAPACITY> core_channels;
@@ -0,0 +1,185 @@
+#include "coro.h"
+#include "atomic.h"
+#include "heap.h"
+#include "percpu.h"
+#include "printf.h"
+#include "sched.h"
+#include "uart.h"
+
+// Frame pool. Every block starts with a header holding its size class, so a
+// frame can be freed on any core: it simply joins that core's free list.
+static constexpr size_t FRAME_HEADER = 16;  // keeps frames 16-byte aligned
+static constexpr uint32_t FRAME_CLASSES = 5;
+static constexpr size_t frame_class_size[FRAME_CLASSES] = {128, 256, 512, 1024, 2048};
+static constexpr uint32_t FRAME_HUGE = FRAME_CLASSES;  // straight from kmalloc
+
+struct FreeFrame {
+    FreeFrame* next;
+};
+
+struct FramePool {
+    FreeFrame* free[FRAME_CLASSES] = {};
+    uint64_t frames = 0;
+    uint64_t slabs = 0;
+};
+
+struct Executor {
+    ReadyNode* incoming = nullptr;  // pushed by any core, drained by the executor
+    WaitQueue idle{"coro_executor"};
+    uint64_t resumed = 0;
+};
+
+static PerCPU<FramePool> frame_pools;
+static PerCPU<Executor> executors;
+
+WaitQueue coro_detail::block_on_waiters{"coro_block_on"};
+
+static void refill(FramePool& pool, uint32_t cls) {
+    size_t size = frame_class_size[cls];
+    char* slab = (char*)kmalloc(CORO_FRAME_SLAB);
+    if (!slab) panic("coro: out of memory for frames");
+    for (size_t off = 0; off + size <= CORO_FRAME_SLAB; off += size) {
+        FreeFrame* f = (FreeFrame*)(slab + off);
+        f->next = pool.free[cls];
+        pool.free[cls] = f;
+    }
+    pool.slabs++;
+}
+
+void* coro_frame_alloc(size_t size) {
+    size_t need = size + FRAME_HEADER;
+    uint32_t cls = 0;
+    while (cls < FRAME_CLASSES && frame_class_size[cls] < need) cls++;
+
+    uint64_t* block;
+    if (cls == FRAME_HUGE) {
+        block = (uint64_t*)kmalloc(need);
+        if (!block) panic("coro: out of memory for a %llu byte frame", (uint64_t)size);
+    } else {
+        Preempt::disable();
+        FramePool& pool = frame_pools.mine();
+        if (!pool.free[cls]) refill(pool, cls);
+        FreeFrame* f = pool.free[cls];
+        pool.free[cls] = f->next;
+        pool.frames++;
+        Preempt::enable();
+        block = (uint64_t*)f;
+    }
+    block[0] = cls;
+    return (char*)block + FRAME_HEADER;
+}
+
+void coro_frame_free(void* frame) {
+    uint64_t* block = (uint64_t*)((char*)frame - FRAME_HEADER);
+    uint32_t cls = block[0];
+    if (cls == FRAME_HUGE) {
+        kfree(block);
+        return;
+    }
+    Preempt::disable();
+    FramePool& pool = frame_pools.mine();
+    FreeFrame* f = (FreeFrame*)block;
+    f->next = pool.free[cls];
+    pool.free[cls] = f;
+    Preempt::enable();
+}
+
+void coro_post(ReadyNode& n) {
+    Executor& e = executors.forCPU(n.core);
+    ReadyNode* head = __atomic_load_n(&e.incoming, __ATOMIC_RELAXED);
+    do {
+        n.next = head;
+    } while (!__atomic_compare_exchange_n(&e.incoming, &head, &n, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+    // The executor only sleeps on an empty queue, and whoever made it
+    // non-empty wakes it
+    if (!head) e.idle.wake_one();
+}
+
+static void executor_thread(void*) {
+    Executor& e = executors.mine();
+    while (true) {
+        ReadyNode* list = __atomic_exchange_n(&e.incoming, (ReadyNode*)nullptr, __ATOMIC_ACQUIRE);
+        if (!list) {
+            wait_event(e.idle,
+                       [&e] { return __atomic_load_n(&e.incoming, __ATOMIC_ACQUIRE) != nullptr; });
+            continue;
+        }
+
+        // Pushed LIFO; resume in the order they were posted
+        ReadyNode* fifo = nullptr;
+        while (list) {
+            ReadyNode* next = list->next;
+            list->next = fifo;
+            fifo = list;
+            list = next;
+        }
+        while (fifo) {
+            // The node lives in the frame being resumed and may be gone after
+            ReadyNode* next = fifo->next;
+            std::coroutine_handle<> h = fifo->handle;
+            h.resume();
+            e.resumed++;
+            fifo = next;
+        }
+    }
+}
+
+void coro_init() {
+    thread_create("coro", executor_thread, nullptr, this_core());
+}
+
+void coro_spawn(CoTask<void> task, int core) {
+    CoTask<void>::Handle h = task.release();
+    coro_detail::PromiseBase& p = h.promise();
+    p.detached = true;
+    p.start.handle = h;
+    p.start.core = core < 0 ? this_core() : core;
+    coro_post(p.start);
+}
+
+CoTask<void> coro_detail::complete(CoTask<void>& task, Completion<void>& c) {
+    co_await task;
+    c.done.store_release(true);
+    block_on_waiters.wake_all();
+}
+
+CoroStats coro_stats(uint32_t core) {
+    FramePool& pool = frame_pools.forCPU(core);
+    return CoroStats{executors.forCPU(core).resumed, pool.frames, pool.slabs};
+}
+
+// Suspends until the UART IRQ posts it, unless wait() finds there's no
+// need (or the UART is polled, in which case the caller just retries)
+struct UartAwaiter {
+    bool (*wait)(ReadyNode&);
+    ReadyNode node;
+
+    bool await_ready() {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        node.handle = h;
+        node.core = this_core();
+        return wait(node);
+    }
+
+    void await_resume() {
+    }
+};
+
+CoTask<char> co_uart_getc() {
+    char c;
+    while (!uart_read(&c, 1)) co_await UartAwaiter{uart_wait_rx, {}};
+    co_return c;
+}
+
+CoTask<void> co_uart_write(const char* buf, size_t len) {
+    while (len) {
+        uint64_t n = uart_write(buf, len);
+        buf += n;
+        len -= n;
+        if (len) co_await UartAwaiter{uart_wait_tx, {}};
+    }
+}
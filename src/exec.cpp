@@ -3,8 +3,16 @@
 #include "stdint.h"
 #include "atomic.h"
 #include "utils.h"
+#include "sched.h"
+#include "irq.h"
+#include "softirq.h"
+#include "timer.h"
+#include "process.h"
+#include "syscall.h"
 
-SpinLock exc_lock;
+SpinLock exc_lock("exc");
+
+PerCPU<uint32_t> Interrupts::irq_depth;
 
 // Function to decode ESR_EL1 exception class
 const char* get_exception_class_name(uint32_t ec) {
@@ -52,6 +60,7 @@ const char* get_exception_class_name(uint32_t ec) {
 extern "C" void exc_handler(unsigned long type, unsigned long esr, unsigned long elr, unsigned long spsr, unsigned long far)
 {
     exc_lock.lock();
+    uart_set_polled();
     
     // Decode ESR_EL1
     uint32_t ec = (esr >> 26) & 0x3F;  // Exception Class (bits 31:26)
@@ -93,6 +102,7 @@ extern "C" void exc_handler(unsigned long type, unsigned long esr, unsigned long
 
 extern "C" void page_fault_handler(unsigned long elr, unsigned long spsr, unsigned long far)
 {
+    uart_set_polled();
     printf("\n=== PAGE FAULT ===\n");
     printf("Core   : %d\n", getCoreID());
     printf("Fault Address (FAR_EL1): 0x%lx\n", far);
@@ -101,14 +111,35 @@ extern "C" void page_fault_handler(unsigned long elr, unsigned long spsr, unsign
     while(1);
 }
 
-extern "C" void syscall_handler(unsigned long sp)
+// Any synchronous exception from EL0 but an svc or an FP/SIMD trap
+extern "C" void user_fault_handler(TrapFrame* f, unsigned long esr)
 {
-    // For now, just print a message.
-    printf("Syscall received on Core %d. SP: 0x%lx\n", getCoreID(), sp);
+    unsigned long far;
+    asm volatile("mrs %0, far_el1" : "=r"(far));
+    uint32_t ec = (esr >> 26) & 0x3F;
+
+    Process* p = current_process();
+    if (!p) {
+        exc_handler(SYNC_INVALID_EL0_64, esr, f->elr, f->spsr, far);
+        return;
+    }
+    Interrupts::enable();
+    printf("process %s: %s at pc 0x%llx, address 0x%llx; killed\n", p->name,
+           get_exception_class_name(ec), f->elr, far);
+    process_exit(-EFAULT);
 }
 
 extern "C" void handle_irq(unsigned long sp)
 {
-    // For now, just print a message.
-    printf("IRQ received on Core %d. SP: 0x%lx\n", getCoreID(), sp);
+    uint64_t start = timer_count();
+    Interrupts::enterIRQ();
+    irq_dispatch(((TrapFrame*)sp)->irq_entry);
+    Interrupts::exitIRQ();
+
+    // Deferred work runs here, with IRQs enabled again
+    softirq_irq_exit(start);
+
+    // Only switch once the IRQ bookkeeping is done; the thread we switch to
+    // may be resuming outside of any handler
+    preempt_schedule_irq();
 }
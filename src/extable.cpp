@@ -0,0 +1,39 @@
+#include "extable.h"
+#include "syscall.h"
+
+extern "C" ExTableEntry __ex_table_start[];
+extern "C" ExTableEntry __ex_table_end[];
+
+void extable_init() {
+    ExTableEntry* t = __ex_table_start;
+    uint64_t n = __ex_table_end - __ex_table_start;
+    // A few entries per object file, in link order: insertion sort is plenty
+    for (uint64_t i = 1; i < n; i++) {
+        ExTableEntry e = t[i];
+        uint64_t j = i;
+        for (; j > 0 && t[j - 1].insn > e.insn; j--) t[j] = t[j - 1];
+        t[j] = e;
+    }
+}
+
+uint64_t search_extable(uint64_t pc) {
+    const ExTableEntry* t = __ex_table_start;
+    uint64_t lo = 0, hi = __ex_table_end - __ex_table_start;
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (t[mid].insn == pc) return t[mid].fixup;
+        if (t[mid].insn < pc) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0;
+}
+
+bool fixup_exception(TrapFrame* f) {
+    uint64_t fixup = search_extable(f->elr);
+    if (!fixup) return false;
+    f->elr = fixup;
+    return true;
+}
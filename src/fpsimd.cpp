@@ -0,0 +1,66 @@
+#include "fpsimd.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "sched.h"
+
+// CPACR_EL1.FPEN, bits [21:20]
+static constexpr uint64_t CPACR_FPEN_MASK = 3ull << 20;
+static constexpr uint64_t CPACR_FPEN_NOTRAP = 3ull << 20;
+
+struct FpSimdCpu {
+    Thread* owner;  // thread whose registers are live on this core
+    FpSimdStats stats;
+};
+
+static PerCPU<FpSimdCpu> fp_cpu;
+
+// What a thread sees on its first FP instruction
+static const FpSimdState fp_initial_state = {};
+
+static inline void set_fpen(uint64_t fpen) {
+    uint64_t cpacr;
+    asm volatile("mrs %0, cpacr_el1" : "=r"(cpacr));
+    uint64_t want = (cpacr & ~CPACR_FPEN_MASK) | fpen;
+    if (want != cpacr) {
+        asm volatile("msr cpacr_el1, %0\n\tisb" ::"r"(want) : "memory");
+    }
+}
+
+void fpsimd_init() {
+    fp_cpu.mine().owner = nullptr;
+    set_fpen(0);
+}
+
+void fpsimd_switch_to(Thread* next) {
+    set_fpen(fp_cpu.mine().owner == next ? CPACR_FPEN_NOTRAP : 0);
+}
+
+void fpsimd_thread_exit(Thread* t) {
+    Interrupts::protect([t] {
+        FpSimdCpu& cpu = fp_cpu.mine();
+        if (cpu.owner == t) cpu.owner = nullptr;
+    });
+}
+
+extern "C" void fpsimd_trap_handler() {
+    FpSimdCpu& cpu = fp_cpu.mine();
+    Thread* me = current_thread();
+
+    set_fpen(CPACR_FPEN_NOTRAP);
+    cpu.stats.traps++;
+    // Before the scheduler is up there is nobody to switch between
+    if (!me || cpu.owner == me) return;
+
+    if (cpu.owner) {
+        fpsimd_save(&cpu.owner->fp);
+        cpu.stats.saves++;
+    }
+    fpsimd_restore(me->fp_used ? &me->fp : &fp_initial_state);
+    me->fp_used = true;
+    cpu.stats.restores++;
+    cpu.owner = me;
+}
+
+FpSimdStats fpsimd_stats(uint32_t core) {
+    return fp_cpu.forCPU(core).stats;
+}
@@ -1,6 +1,7 @@
 #include "heap.h"
 #include "printf.h"
 #include "atomic.h"
+#include "bulkmem.h"
 #include "stdint.h"
 
 extern char _end[];
@@ -80,7 +81,8 @@ static char* heap_end = nullptr;
 static Atomic<char*> heap_current(nullptr);
 
 static BlockHeader* free_head = nullptr; // head of free-list
-static SpinLock heap_lock;
+// Interrupt-safe so IRQ handlers may allocate
+static InterruptSafeLock heap_lock("heap");
 static size_t heap_used_bytes = 0;
 
 static inline void free_list_insert(BlockHeader* b) {
@@ -148,14 +150,12 @@ size_t heap_expand(size_t /*min_bytes*/) {
     return 0;
 }
 
-void* kmalloc(size_t size) {
-    if (size == 0) return nullptr;
-
-    size_t payload_size = align_up(size, HEAP_ALIGN);
+// Carve out a block for payload_size bytes; the payload is not cleared
+static void* alloc_block(size_t size, size_t payload_size) {
     size_t need = header_aligned_size() + payload_size + footer_size();
     need = align_up(need, HEAP_ALIGN);
 
-    LockGuard<SpinLock> g(heap_lock);
+    LockGuard<InterruptSafeLock> g(heap_lock);
 
     // First-fit search
     BlockHeader* cur = free_head;
@@ -197,29 +197,32 @@ void* kmalloc(size_t size) {
         free_list_insert(rest);
 
         heap_used_bytes += need;
-        void* payload = payload_from_block(alloc);
-        // Zero-initialize
-        for (size_t i = 0; i < payload_size; i++) {
-            ((char*)payload)[i] = 0;
-        }
-        return payload;
+        return payload_from_block(alloc);
     } else {
         // Use entire block
         cur->size_and_flags = (cur_size | ALLOCATED_FLAG);
         write_footer(cur);
         heap_used_bytes += cur_size;
-        void* payload = payload_from_block(cur);
-        for (size_t i = 0; i < payload_size; i++) {
-            ((char*)payload)[i] = 0;
-        }
-        return payload;
+        return payload_from_block(cur);
     }
 }
 
+void* kmalloc(size_t size) {
+    if (size == 0) return nullptr;
+
+    size_t payload_size = align_up(size, HEAP_ALIGN);
+    void* payload = alloc_block(size, payload_size);
+    if (!payload) return nullptr;
+    // Zero-initialize outside the heap lock, which masks IRQs; big payloads
+    // are cleared by all cores
+    parallel_memset(payload, 0, payload_size);
+    return payload;
+}
+
 void kfree(void* ptr) {
     if (!ptr) return;
 
-    LockGuard<SpinLock> g(heap_lock);
+    LockGuard<InterruptSafeLock> g(heap_lock);
 
     BlockHeader* b = block_from_payload(ptr);
     if (!block_is_allocated(b)) {
@@ -239,13 +242,31 @@ void kfree(void* ptr) {
     if (heap_used_bytes >= freed) heap_used_bytes -= freed; else heap_used_bytes = 0;
 }
 
+void* kmalloc_aligned(size_t size, size_t align) {
+    if (size == 0) return nullptr;
+    if (align <= HEAP_ALIGN) align = HEAP_ALIGN;
+
+    // Over-allocate and stash the original payload pointer just below the
+    // aligned address so kfree_aligned can find it.
+    char* raw = (char*)kmalloc(size + align);
+    if (!raw) return nullptr;
+    uintptr_t aligned = align_up((uintptr_t)raw + HEAP_ALIGN, align);
+    ((void**)aligned)[-1] = raw;
+    return (void*)aligned;
+}
+
+void kfree_aligned(void* ptr) {
+    if (!ptr) return;
+    kfree(((void**)ptr)[-1]);
+}
+
 size_t get_heap_used() {
-    LockGuard<SpinLock> g(heap_lock);
+    LockGuard<InterruptSafeLock> g(heap_lock);
     return heap_used_bytes;
 }
 
 size_t get_heap_free() {
-    LockGuard<SpinLock> g(heap_lock);
+    LockGuard<InterruptSafeLock> g(heap_lock);
     size_t total = (size_t)(heap_end - heap_start);
     return (total >= heap_used_bytes) ? (total - heap_used_bytes) : 0;
 }
@@ -261,3 +282,15 @@ void operator delete(void* ptr) { kfree(ptr); }
 void operator delete[](void* ptr) { kfree(ptr); }
 void operator delete(void* ptr, unsigned long /*size*/) { kfree(ptr); }
 void operator delete[](void* ptr, unsigned long /*size*/) { kfree(ptr); }
+
+void* operator new(unsigned long size, std::align_val_t align) {
+    return kmalloc_aligned(size, (size_t)align);
+}
+void* operator new[](unsigned long size, std::align_val_t align) {
+    return kmalloc_aligned(size, (size_t)align);
+}
+
+void operator delete(void* ptr, std::align_val_t) { kfree_aligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) { kfree_aligned(ptr); }
+void operator delete(void* ptr, unsigned long, std::align_val_t) { kfree_aligned(ptr); }
+void operator delete[](void* ptr, unsigned long, std::align_val_t) { kfree_aligned(ptr); }
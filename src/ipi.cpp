@@ -0,0 +1,208 @@
+#include "ipi.h"
+#include "atomic.h"
+#include "irq.h"
+#include "percpu.h"
+#include "printf.h"
+#include "utils.h"
+#include "peripherals/local_intc.h"
+
+struct CallRequest {
+    void (*fn)(void*) = nullptr;
+    void* arg = nullptr;
+    CallRequest* next = nullptr;
+    Atomic<bool> done{false};
+};
+
+struct IpiCpu {
+    CallRequest* calls = nullptr;       // pushed by any core, drained by the owner
+    Atomic<uint32_t> tlb_wanted{0};     // last flush generation requested
+    Atomic<uint32_t> tlb_done{0};       // last generation the owner has flushed for
+    uint64_t received[IPI_TYPES] = {};  // only touched by the owner's IRQ handler
+};
+
+static PerCPU<IpiCpu> ipi_cpus;
+
+static void ipi_irq(void*);
+
+void ipi_init() {
+    request_irq(irq_local_mailbox(IPI_MBOX), ipi_irq, nullptr);
+    enable_irq(irq_local_mailbox(IPI_MBOX));
+}
+
+void ipi_send(uint32_t core, IpiType type) {
+    // The mailbox write is a device access; make our memory writes (queued
+    // calls, flush generations) visible to the target before it lands
+    asm volatile("dsb sy" ::: "memory");
+    put32(CORE_MBOX_SET(core, IPI_MBOX), 1u << (uint32_t)type);
+}
+
+void ipi_broadcast(IpiType type) {
+    uint32_t me = this_core();
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core != me) ipi_send(core, type);
+    }
+}
+
+static void run_calls(IpiCpu& cpu) {
+    CallRequest* list = __atomic_exchange_n(&cpu.calls, (CallRequest*)nullptr, __ATOMIC_ACQUIRE);
+
+    // Pushed LIFO; run them in the order they were queued
+    CallRequest* fifo = nullptr;
+    while (list) {
+        CallRequest* next = list->next;
+        list->next = fifo;
+        fifo = list;
+        list = next;
+    }
+    while (fifo) {
+        // The caller may pop its request off the stack once done is set
+        CallRequest* next = fifo->next;
+        fifo->fn(fifo->arg);
+        fifo->done.store_release(true);
+        fifo = next;
+    }
+}
+
+static void flush_local_tlb() {
+    asm volatile("dsb ishst\n\ttlbi vmalle1\n\tdsb nsh\n\tisb" ::: "memory");
+}
+
+static void ack_tlb_flush(IpiCpu& cpu) {
+    // Read the generation before flushing: every request up to it was made
+    // after its page table update, so this flush covers all of them
+    uint32_t wanted = cpu.tlb_wanted.load_acquire();
+    flush_local_tlb();
+    cpu.tlb_done.store_release(wanted);
+}
+
+static void ipi_irq(void*) {
+    uint32_t me = this_core();
+    IpiCpu& cpu = ipi_cpus.mine();
+
+    uint32_t pending = get32(CORE_MBOX_RDCLR(me, IPI_MBOX));
+    put32(CORE_MBOX_RDCLR(me, IPI_MBOX), pending);
+
+    if (pending & (1u << (uint32_t)IpiType::Reschedule)) {
+        cpu.received[(uint32_t)IpiType::Reschedule]++;
+        Preempt::setNeedResched(true);
+    }
+    if (pending & (1u << (uint32_t)IpiType::TlbFlush)) {
+        cpu.received[(uint32_t)IpiType::TlbFlush]++;
+        ack_tlb_flush(cpu);
+    }
+    if (pending & (1u << (uint32_t)IpiType::CallFunction)) {
+        cpu.received[(uint32_t)IpiType::CallFunction]++;
+        run_calls(cpu);
+    }
+    pending &= ~((1u << IPI_TYPES) - 1);
+    if (pending) {
+        printf("ipi: unknown message bits 0x%x on core %d\n", pending, (int)me);
+    }
+}
+
+static void check_can_wait(const char* what) {
+#ifdef LOCK_DEBUG
+    if (Interrupts::isDisabled() || Interrupts::inIRQ()) {
+        panic("ipi: %s on core %d would wait with IRQs masked", what, (int)this_core());
+    }
+#else
+    (void)what;
+#endif
+}
+
+static void queue_call(uint32_t core, CallRequest& req) {
+    IpiCpu& cpu = ipi_cpus.forCPU(core);
+    CallRequest* head = __atomic_load_n(&cpu.calls, __ATOMIC_RELAXED);
+    do {
+        req.next = head;
+    } while (!__atomic_compare_exchange_n(&cpu.calls, &head, &req, true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+    ipi_send(core, IpiType::CallFunction);
+}
+
+static void wait_call(CallRequest& req) {
+    // IRQs stay enabled so calls aimed at this core keep being served
+    while (!req.done.load_acquire()) {
+        cpu_relax();
+    }
+}
+
+void smp_call_function_single(uint32_t core, void (*fn)(void*), void* arg) {
+    if (core == this_core()) {
+        uint64_t daif = Interrupts::disable();
+        fn(arg);
+        Interrupts::restore(daif);
+        return;
+    }
+    check_can_wait("smp_call_function_single");
+
+    CallRequest req;
+    req.fn = fn;
+    req.arg = arg;
+    queue_call(core, req);
+    wait_call(req);
+}
+
+void smp_call_function(void (*fn)(void*), void* arg) {
+    check_can_wait("smp_call_function");
+
+    // Queue on every core first so they all run fn in parallel
+    uint32_t me = this_core();
+    CallRequest reqs[CORE_COUNT];
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me) continue;
+        reqs[core].fn = fn;
+        reqs[core].arg = arg;
+        queue_call(core, reqs[core]);
+    }
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core != me) wait_call(reqs[core]);
+    }
+}
+
+void smp_call_function_mask(uint32_t mask, void (*fn)(void*), void* arg) {
+    uint32_t me = this_core();
+    if (mask & ~(1u << me)) check_can_wait("smp_call_function_mask");
+
+    CallRequest reqs[CORE_COUNT];
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me || !(mask & (1u << core))) continue;
+        reqs[core].fn = fn;
+        reqs[core].arg = arg;
+        queue_call(core, reqs[core]);
+    }
+    if (mask & (1u << me)) {
+        uint64_t daif = Interrupts::disable();
+        fn(arg);
+        Interrupts::restore(daif);
+    }
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core != me && (mask & (1u << core))) wait_call(reqs[core]);
+    }
+}
+
+void smp_flush_tlb_all() {
+    check_can_wait("smp_flush_tlb_all");
+
+    uint32_t me = this_core();
+    uint32_t wanted[CORE_COUNT];
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me) continue;
+        wanted[core] = ipi_cpus.forCPU(core).tlb_wanted.add_fetch(1);
+        ipi_send(core, IpiType::TlbFlush);
+    }
+    flush_local_tlb();
+
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me) continue;
+        Atomic<uint32_t>& done = ipi_cpus.forCPU(core).tlb_done;
+        // Wrap-safe: the target may already be past our generation
+        while ((int32_t)(done.load_acquire() - wanted[core]) < 0) {
+            cpu_relax();
+        }
+    }
+}
+
+uint64_t ipi_received(uint32_t core, IpiType type) {
+    return __atomic_load_n(&ipi_cpus.forCPU(core).received[(uint32_t)type], __ATOMIC_RELAXED);
+}
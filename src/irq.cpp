@@ -0,0 +1,212 @@
+#include "irq.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "printf.h"
+#include "softirq.h"
+#include "utils.h"
+#include "peripherals/irq.h"
+#include "peripherals/local_intc.h"
+
+struct IrqDesc {
+    IrqHandler handler = nullptr;  // published after ctx
+    void* ctx = nullptr;
+};
+
+// Unhandled sources are reported from a tasklet rather than printed with
+// IRQs masked
+static void report_unhandled(Tasklet* t);
+
+struct IrqCpu {
+    Tasklet unhandled_tasklet{report_unhandled};  // must stay first
+    uint32_t unhandled_last = 0;
+    uint32_t unhandled_since = 0;  // since the last report
+    uint64_t entry = 0;            // counter at the vector of the IRQ being handled
+    uint64_t counts[IRQ_COUNT] = {};
+};
+
+static IrqDesc descs[IRQ_COUNT];
+static PerCPU<IrqCpu> irq_cpus;
+static InterruptSafeLock irq_lock("irq");
+
+// Enabled GPU/ARM interrupts, to filter the pending registers with
+static uint32_t gpu_enabled[2];
+static uint32_t arm_enabled;
+
+static void report_unhandled(Tasklet* t) {
+    IrqCpu* cpu = (IrqCpu*)t;
+    uint32_t since = __atomic_exchange_n(&cpu->unhandled_since, 0, __ATOMIC_RELAXED);
+    printf("Unhandled IRQ %u on Core %d (%u since the last report)\n", cpu->unhandled_last,
+           getCoreID(), since);
+}
+
+static bool is_shared(uint32_t irq) {
+    return irq < IRQ_LOCAL_BASE;
+}
+
+void irq_init() {
+    put32(DISABLE_IRQS_1, 0xFFFFFFFF);
+    put32(DISABLE_IRQS_2, 0xFFFFFFFF);
+    put32(DISABLE_BASIC_IRQS, BASIC_ARM_MASK);
+    put32(FIQ_CONTROL, 0);
+    put32(GPU_INT_ROUTING, GPU_IRQ_CORE(0));
+}
+
+// Set or clear bit in one of this core's control registers. Only the owning
+// core writes them, so masking IRQs is enough to keep the update atomic.
+static void update_local(volatile unsigned int* reg, uint32_t bit, bool on) {
+    Interrupts::protect([=] {
+        uint32_t v = get32(reg);
+        put32(reg, on ? v | bit : v & ~bit);
+    });
+}
+
+static void set_enabled(uint32_t irq, bool on) {
+    uint32_t me = this_core();
+    if (irq < IRQ_ARM_BASE) {
+        uint32_t bit = 1u << (irq % 32);
+        uint32_t* shadow = &gpu_enabled[irq / 32];
+        if (on) {
+            __atomic_fetch_or(shadow, bit, __ATOMIC_RELAXED);
+            put32(irq < 32 ? ENABLE_IRQS_1 : ENABLE_IRQS_2, bit);
+        } else {
+            put32(irq < 32 ? DISABLE_IRQS_1 : DISABLE_IRQS_2, bit);
+            __atomic_fetch_and(shadow, ~bit, __ATOMIC_RELAXED);
+        }
+    } else if (irq < IRQ_LOCAL_BASE) {
+        uint32_t bit = 1u << (irq - IRQ_ARM_BASE);
+        if (on) {
+            __atomic_fetch_or(&arm_enabled, bit, __ATOMIC_RELAXED);
+            put32(ENABLE_BASIC_IRQS, bit);
+        } else {
+            put32(DISABLE_BASIC_IRQS, bit);
+            __atomic_fetch_and(&arm_enabled, ~bit, __ATOMIC_RELAXED);
+        }
+    } else if (irq <= IRQ_LOCAL_CNTV) {
+        update_local(CORE_TIMER_IRQCNTL(me), 1u << (irq - IRQ_LOCAL_CNTPS), on);
+    } else if (irq < IRQ_LOCAL_GPU) {
+        update_local(CORE_MAILBOX_IRQCNTL(me), MBOX_IRQ(irq - irq_local_mailbox(0)), on);
+    } else if (irq == IRQ_LOCAL_PMU) {
+        put32(on ? PMU_ROUTING_SET : PMU_ROUTING_CLR, PMU_IRQ(me));
+    }
+    // The GPU line follows GPU_INT_ROUTING, AXI and the local timer have no
+    // per-core enable
+}
+
+void enable_irq(uint32_t irq) {
+    if (irq < IRQ_COUNT) set_enabled(irq, true);
+}
+
+void disable_irq(uint32_t irq) {
+    if (irq < IRQ_COUNT) set_enabled(irq, false);
+}
+
+bool request_irq(uint32_t irq, IrqHandler handler, void* ctx) {
+    if (irq >= IRQ_COUNT || irq == IRQ_LOCAL_GPU || !handler) return false;
+
+    LockGuard<InterruptSafeLock> g(irq_lock);
+    IrqDesc& d = descs[irq];
+    if (d.handler) return d.handler == handler && d.ctx == ctx;
+    d.ctx = ctx;
+    __atomic_store_n(&d.handler, handler, __ATOMIC_RELEASE);
+    if (is_shared(irq)) set_enabled(irq, true);
+    return true;
+}
+
+void free_irq(uint32_t irq) {
+    if (irq >= IRQ_COUNT) return;
+
+    LockGuard<InterruptSafeLock> g(irq_lock);
+    if (is_shared(irq)) set_enabled(irq, false);
+    __atomic_store_n(&descs[irq].handler, (IrqHandler) nullptr, __ATOMIC_RELEASE);
+    descs[irq].ctx = nullptr;
+}
+
+bool irq_set_affinity(uint32_t irq, uint32_t core) {
+    if (core >= CORE_COUNT) return false;
+    if (is_shared(irq)) {
+        put32(GPU_INT_ROUTING, GPU_IRQ_CORE(core));
+        return true;
+    }
+    if (irq == IRQ_LOCAL_TIMER) {
+        put32(LOCAL_TIMER_ROUTING, LOCAL_TIMER_IRQ_CORE(core));
+        return true;
+    }
+    return false;
+}
+
+static void handle(IrqCpu& cpu, uint32_t irq) {
+    cpu.counts[irq]++;
+    IrqDesc& d = descs[irq];
+    IrqHandler h = __atomic_load_n(&d.handler, __ATOMIC_ACQUIRE);
+    if (h) {
+        h(d.ctx);
+        return;
+    }
+
+    // Nothing will clear a shared source; mask it rather than loop on it
+    if (is_shared(irq)) set_enabled(irq, false);
+    cpu.unhandled_last = irq;
+    cpu.unhandled_since++;
+    tasklet_schedule(cpu.unhandled_tasklet);
+}
+
+// Run the handlers for the set bits of pending, lowest first. __builtin_ctz
+// is rbit + clz on AArch64, so this costs one step per pending source.
+static inline void handle_bits(IrqCpu& cpu, uint32_t pending, uint32_t base) {
+    while (pending) {
+        uint32_t bit = __builtin_ctz(pending);
+        pending &= pending - 1;
+        handle(cpu, base + bit);
+    }
+}
+
+static void dispatch_gpu(IrqCpu& cpu) {
+    uint32_t basic = get32(IRQ_BASIC_PENDING);
+    handle_bits(cpu, basic & BASIC_ARM_MASK & __atomic_load_n(&arm_enabled, __ATOMIC_RELAXED),
+                IRQ_ARM_BASE);
+    if (!(basic & BASIC_GPU_MASK)) return;
+    handle_bits(cpu, get32(IRQ_PENDING_1) & __atomic_load_n(&gpu_enabled[0], __ATOMIC_RELAXED),
+                IRQ_GPU_BASE);
+    handle_bits(cpu, get32(IRQ_PENDING_2) & __atomic_load_n(&gpu_enabled[1], __ATOMIC_RELAXED),
+                IRQ_GPU_BASE + 32);
+}
+
+void irq_dispatch(uint64_t entry) {
+    IrqCpu& cpu = irq_cpus.mine();
+    cpu.entry = entry;
+    uint32_t source = get32(CORE_IRQ_SOURCE(this_core()));
+    while (source) {
+        uint32_t bit = __builtin_ctz(source);
+        source &= source - 1;
+        if (IRQ_LOCAL_BASE + bit == IRQ_LOCAL_GPU) {
+            dispatch_gpu(cpu);
+        } else {
+            handle(cpu, IRQ_LOCAL_BASE + bit);
+        }
+    }
+}
+
+uint64_t irq_entry_count() {
+    return irq_cpus.mine().entry;
+}
+
+uint64_t irq_count(uint32_t irq, uint32_t core) {
+    return irq < IRQ_COUNT ? irq_cpus.forCPU(core).counts[irq] : 0;
+}
+
+void irq_stats_dump() {
+    printf("IRQ  ");
+    for (uint32_t core = 0; core < CORE_COUNT; core++) printf("       core%u", core);
+    printf("\n");
+    for (uint32_t irq = 0; irq < IRQ_COUNT; irq++) {
+        uint64_t total = 0;
+        for (uint32_t core = 0; core < CORE_COUNT; core++) total += irq_count(irq, core);
+        bool used = __atomic_load_n(&descs[irq].handler, __ATOMIC_RELAXED) != nullptr;
+        if (!total && !used) continue;
+        printf("%3u: ", irq);
+        for (uint32_t core = 0; core < CORE_COUNT; core++) {
+            printf(" %11llu", irq_count(irq, core));
+        }
+        printf("%s\n", used ? "" : "  (no handler)");
+    }
+}
@@ -0,0 +1,142 @@
+#include "irqlat.h"
+#include "atomic.h"
+#include "heap.h"
+#include "irq.h"
+#include "percpu.h"
+#include "printf.h"
+#include "timer.h"
+
+static constexpr uint64_t CNTP_CTL_ENABLE = 1 << 0;
+
+// Values below 2 * LAT_SUB_BUCKETS get a bucket each; above, every power of
+// two is split into LAT_SUB_BUCKETS by the bits below its top one
+static uint32_t bucket_of(uint64_t v) {
+    if (v < 2 * LAT_SUB_BUCKETS) return (uint32_t)v;
+    uint32_t shift = 63 - __builtin_clzll(v) - 5;
+    uint64_t b = (shift + 1) * LAT_SUB_BUCKETS + (v >> shift) - LAT_SUB_BUCKETS;
+    return b < LAT_BUCKETS ? (uint32_t)b : LAT_BUCKETS - 1;
+}
+
+static uint64_t bucket_low(uint32_t b) {
+    if (b < 2 * LAT_SUB_BUCKETS) return b;
+    uint32_t shift = b / LAT_SUB_BUCKETS - 1;
+    return (uint64_t)(b % LAT_SUB_BUCKETS + LAT_SUB_BUCKETS) << shift;
+}
+
+void LatencyHist::reset() {
+    count = 0;
+    min = ~0ull;
+    max = 0;
+    for (uint32_t& b : buckets) b = 0;
+}
+
+void LatencyHist::add(uint64_t v) {
+    count++;
+    if (v < min) min = v;
+    if (v > max) max = v;
+    buckets[bucket_of(v)]++;
+}
+
+uint64_t LatencyHist::percentile(uint32_t pct) const {
+    if (!count) return 0;
+    uint64_t rank = (count * pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < LAT_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen >= rank) {
+            uint64_t v = bucket_low(b);
+            return v < min ? min : v > max ? max : v;
+        }
+    }
+    return max;
+}
+
+// Handed from the CNTP handler to the spinning loop
+struct LatCpu {
+    uint64_t entry;
+    uint64_t handler;
+    uint32_t fired;
+};
+
+static PerCPU<LatCpu> lat_cpus;
+
+static void lat_irq(void*) {
+    // No isb: this wants the earliest read it can get
+    uint64_t now;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(now));
+    LatCpu& c = lat_cpus.mine();
+    c.handler = now;
+    c.entry = irq_entry_count();
+    asm volatile("msr cntp_ctl_el0, xzr\n\tisb");  // drops the IRQ line
+    __atomic_store_n(&c.fired, 1, __ATOMIC_RELEASE);
+}
+
+void irq_latency_run(IrqLatency& lat, uint32_t rounds) {
+    for (LatencyHist& h : lat.stages) h.reset();
+    // Same handler and ctx on every core, so each may ask
+    request_irq(IRQ_LOCAL_CNTPNS, lat_irq, nullptr);
+    enable_irq(IRQ_LOCAL_CNTPNS);
+
+    // A switch would make resume the time until this thread runs again
+    Preempt::disable();
+    LatCpu& c = lat_cpus.mine();
+    uint64_t span = timer_frequency() / 10000;  // deadlines 100-200us out
+    uint32_t x = 2463534242u + this_core();
+    for (uint32_t i = 0; i < rounds; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        __atomic_store_n(&c.fired, 0, __ATOMIC_RELAXED);
+        uint64_t deadline = timer_count() + span + x % span;
+        asm volatile("msr cntp_cval_el0, %0\n\tmsr cntp_ctl_el0, %1\n\tisb" ::"r"(deadline),
+                     "r"(CNTP_CTL_ENABLE));
+        while (!__atomic_load_n(&c.fired, __ATOMIC_ACQUIRE)) {
+        }
+        uint64_t resume = timer_count();
+
+        lat.stages[(uint32_t)IrqLatStage::Entry].add(c.entry - deadline);
+        lat.stages[(uint32_t)IrqLatStage::Handler].add(c.handler - deadline);
+        lat.stages[(uint32_t)IrqLatStage::Resume].add(resume - deadline);
+    }
+    Preempt::enable();
+    disable_irq(IRQ_LOCAL_CNTPNS);
+}
+
+void irq_latency_load(IrqLoad load, const volatile bool* stop) {
+    uint32_t x = 88675123u + this_core();
+    if (load == IrqLoad::Heap) {
+        void* slots[16] = {};
+        while (!*stop) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            void*& s = slots[x % 16];
+            kfree(s);
+            s = kmalloc(16 + (x >> 8) % 2048);
+        }
+        for (void* s : slots) kfree(s);
+    } else if (load == IrqLoad::Printf) {
+        for (uint32_t n = 0; !*stop; n++) {
+            printf("irqlat load core %u line %u: the quick brown fox jumps over the lazy dog\n",
+                   this_core(), n);
+        }
+    } else {
+        while (!*stop) cpu_relax();
+    }
+}
+
+static uint64_t counts_to_ns(uint64_t counts) {
+    return counts * 1000000000ull / timer_frequency();
+}
+
+void irq_latency_report(const char* name, const IrqLatency& lat) {
+    static const char* const stage_names[] = {"entry", "handler", "resume"};
+    for (uint32_t s = 0; s < (uint32_t)IrqLatStage::Count; s++) {
+        const LatencyHist& h = lat.stages[s];
+        printf("IRQLAT %s core=%u stage=%s n=%llu min=%llu p50=%llu p99=%llu max=%llu\n", name,
+               this_core(), stage_names[s], h.count, counts_to_ns(h.count ? h.min : 0),
+               counts_to_ns(h.percentile(50)), counts_to_ns(h.percentile(99)),
+               counts_to_ns(h.max));
+    }
+}
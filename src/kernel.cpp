@@ -4,11 +4,21 @@
 #include "percpu.h"
 #include "stdint.h"
 #include "entry.h"
+#include "extable.h"
 #include "core.h"
 #include "vm.h"
 #include "atomic.h"
 #include "dcache.h"
 #include "testframework.h"
+#include "bench.h"
+#include "rcu.h"
+#include "sched.h"
+#include "ipi.h"
+#include "irq.h"
+#include "timekeeping.h"
+#include "coro.h"
+#include "softirq.h"
+#include "sync.h"
 #include "heap.h"
 #include "core.h"
 
@@ -22,14 +32,23 @@ PerCPU<Stack> stacks;
 static bool allowStackInit = false;
 static bool smpInitDone = false;
 
-static Barrier* starting = nullptr;
-static Barrier* stopping = nullptr;
+// Reused for every kernel-wide phase change (start, tests done, benchmarks done)
+static SenseBarrier phase_barrier(CORE_COUNT);
 
 void kernel_init();
 
+// Waiting at a phase barrier is a quiescent state for RCU
+static void phase_sync() {
+    rcu_idle_enter();
+    phase_barrier.sync();
+    rcu_idle_exit();
+}
+
 extern void register_all_tests();
+extern void register_all_benches();
 
-SpinLock lock;
+// Serializes the per-core test runs; cores waiting their turn sleep
+Mutex lock;
 
 extern "C" uint64_t pickKernelStack(void) {
     return (uint64_t) &stacks.forCPU(allowStackInit ? getCoreID() : 0).bytes[Stack::BYTES];
@@ -51,6 +70,7 @@ extern "C" void primary_kernel_init() {
     wake_up_cores();
 
     init_mmu();
+    extable_init();
 
     uart_init();
     init_printf(nullptr, uart_putc_wrapper);
@@ -59,8 +79,9 @@ extern "C" void primary_kernel_init() {
     heap_init();
     printf("Heap allocator initialized!\n");
 
-    starting = new Barrier(CORE_COUNT);
-    stopping = new Barrier(CORE_COUNT);
+    irq_init();
+    uart_enable_irq();
+    timekeeping_init();
 
     // Signal secondaries it's safe to enable MMU on their side
     smpInitDone = true;
@@ -70,9 +91,20 @@ extern "C" void primary_kernel_init() {
 }
 
 void kernel_init(){
-    starting->sync();
+    phase_barrier.sync();
     uint64_t core_id = getCoreID();
-    lock.lock();    
+
+    // From here on this code runs as the core's boot thread
+    sched_init();
+    ipi_init();
+    sched_start();
+    softirq_init();
+    rcu_init();
+    coro_init();
+
+    // Cores start out RCU-idle, so waiting for the test lock is quiescent
+    lock.lock();
+    rcu_idle_exit();
     printf("\n=== CORE %lld: STARTING MULTI-CORE KERNEL TESTS ===\n", core_id);
     printf("Each core will run the same comprehensive test suite...\n");
     printf("Note: Memory protection tests may cause expected page faults\n\n");
@@ -84,9 +116,25 @@ void kernel_init(){
     printf("\n=== CORE %lld: ALL TESTS COMPLETED ===\n", core_id);
     printf("Core %lld entering idle state.\n\n", core_id);
     lock.unlock();
-    stopping->sync();
+    phase_sync();
+
+    if (core_id == 0) {
+        register_all_benches();
+    }
+    phase_sync();
+    BenchFramework::run_all_benches();
+    phase_sync();
+
+    if (core_id == 0) {
+        irq_stats_dump();
+    }
 
-    while(true) {
-        asm volatile("wfe");
+#ifdef LOCK_STATS
+    if (core_id == 0) {
+        lock_stats_dump();
     }
+#endif
+
+    // Leave the core to whatever threads remain and its idle thread
+    thread_exit();
 }
@@ -0,0 +1,50 @@
+#include "atomic.h"
+
+#ifdef LOCK_STATS
+
+#include "printf.h"
+#include "timer.h"
+
+static Atomic<LockStats*> stats_head(nullptr);
+
+void lock_stats_register(LockStats* stats) {
+    if (stats->registered.exchange(true)) return;
+
+    // Lock-free push: registering must not take a lock of its own
+    LockStats* head = stats_head.get();
+    do {
+        stats->next = head;
+    } while (!stats_head.compare_exchange(head, stats));
+}
+
+void lock_stats_dump() {
+    printf("\n=== LOCK STATISTICS (timer %lld Hz, times in ticks) ===\n", timer_frequency());
+
+    for (LockStats* s = stats_head.get(); s != nullptr; s = s->next) {
+        LockCoreStats total = {};
+        for (int core = 0; core < CORE_COUNT; core++) {
+            LockCoreStats& c = s->per_core[core];
+            total.acquisitions += c.acquisitions;
+            total.contended += c.contended;
+            total.wait_total += c.wait_total;
+            if (c.wait_max > total.wait_max) total.wait_max = c.wait_max;
+            if (c.hold_max > total.hold_max) total.hold_max = c.hold_max;
+        }
+
+        printf("LOCKSTAT %s core=all acq=%llu contended=%llu wait_total=%llu wait_max=%llu "
+               "hold_max=%llu\n",
+               s->name, total.acquisitions, total.contended, total.wait_total, total.wait_max,
+               total.hold_max);
+        for (int core = 0; core < CORE_COUNT; core++) {
+            LockCoreStats& c = s->per_core[core];
+            if (c.acquisitions == 0) continue;
+            printf("LOCKSTAT %s core=%d acq=%llu contended=%llu wait_total=%llu wait_max=%llu "
+                   "hold_max=%llu\n",
+                   s->name, core, c.acquisitions, c.contended, c.wait_total, c.wait_max,
+                   c.hold_max);
+        }
+    }
+    printf("=========================\n\n");
+}
+
+#endif
@@ -31,9 +31,9 @@ static void* stdout_putp;
 
 extern uint64_t PGD[512]; // Reference to kernel page tables
 
-SpinLock printf_err_lock;
-SpinLock printf_lock;
-SpinLock panic_lock;
+InterruptSafeLock printf_err_lock("printf_err");
+InterruptSafeLock printf_lock("printf");
+InterruptSafeLock panic_lock("panic");
 
 #ifdef PRINTF_LONG_SUPPORT
 
@@ -265,14 +265,19 @@ void tfp_printf(const char* fmt, ...) {
     va_list va;
 
     va_start(va, fmt);
-    tfp_format(stdout_putp, stdout_putf, fmt, va);
-
+    {
+        LockGuard<InterruptSafeLock> g(printf_lock);
+        tfp_format(stdout_putp, stdout_putf, fmt, va);
+    }
     va_end(va);
+}
 
-    printf_lock.unlock();
+void console_write(const char* s, unsigned long n) {
+    LockGuard<InterruptSafeLock> g(printf_lock);
+    for (unsigned long i = 0; i < n; i++) stdout_putf(stdout_putp, s[i]);
 }
 
-void tfp_sprintf(char* s, char* fmt, ...) {
+void tfp_sprintf(char* s, const char* fmt, ...) {
     va_list va;
     va_start(va, fmt);
     tfp_format(&s, putcp, fmt, va);
@@ -283,10 +288,11 @@ void tfp_sprintf(char* s, char* fmt, ...) {
 void tfp_error_printf(const char* fmt, ...) {
     va_list va;
     va_start(va, fmt);
-    tfp_format(stdout_putp, stdout_putf, fmt, va);
+    {
+        LockGuard<InterruptSafeLock> g(printf_err_lock);
+        tfp_format(stdout_putp, stdout_putf, fmt, va);
+    }
     va_end(va);
-
-    printf_err_lock.unlock();
 }
 
 void tfp_printf_no_lock(const char* fmt, ...) {
@@ -298,6 +304,7 @@ void tfp_printf_no_lock(const char* fmt, ...) {
 
 __attribute__((noreturn)) void tfp_panic(const char* fmt, ...) {
     panic_lock.lock();
+    uart_set_polled();
 
     char buffer[256];
     va_list va;
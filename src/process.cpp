@@ -0,0 +1,258 @@
+#include "process.h"
+#include "atomic.h"
+#include "dcache.h"
+#include "elf.h"
+#include "heap.h"
+#include "libk.h"
+#include "percpu.h"
+#include "printf.h"
+#include "timekeeping.h"
+#include "wait.h"
+
+static constexpr uint64_t PAGE_MASK = PAGE_SIZE_4KB - 1;
+
+// Drop to EL0t at pc with SP_EL0 = sp, restarting this thread's kernel stack
+// at kernel_sp for its exceptions (switch.S)
+extern "C" [[noreturn]] void enter_el0(uint64_t pc, uint64_t sp, uint64_t kernel_sp);
+
+// ASID 0 stays with the kernel's tables
+static uint64_t asid_map[65536 / 64];
+static uint32_t asid_next = 1;
+static SpinLock asid_lock("asid");
+
+// The user tables loaded in TTBR0. Kernel threads leave them in place (entry
+// 0 is the kernel's in every PGD), so switching back to the same process
+// costs nothing.
+static PerCPU<Process*> loaded;
+
+static uint16_t asid_alloc() {
+    LockGuard<SpinLock> g(asid_lock);
+    for (uint32_t i = 0; i < 65535; i++) {
+        uint32_t asid = asid_next;
+        asid_next = asid_next == 65535 ? 1 : asid_next + 1;
+        uint64_t bit = 1ull << (asid % 64);
+        if (!(asid_map[asid / 64] & bit)) {
+            asid_map[asid / 64] |= bit;
+            return (uint16_t)asid;
+        }
+    }
+    return 0;
+}
+
+static void asid_free(uint16_t asid) {
+    LockGuard<SpinLock> g(asid_lock);
+    asid_map[asid / 64] &= ~(1ull << (asid % 64));
+}
+
+static void free_mm(Process* p) {
+    if (p->pgd) vm_user_destroy(p->pgd, p->asid);
+    if (p->asid) asid_free(p->asid);
+    p->pgd = nullptr;
+    p->asid = 0;
+}
+
+static bool load_error(const char* name, const char* why) {
+    printf("process %s: %s\n", name, why);
+    return false;
+}
+
+static uint32_t segment_perms(uint32_t flags) {
+    return (flags & PF_R ? READ_PERM : 0) | (flags & PF_W ? WRITE_PERM : 0) |
+           (flags & PF_X ? EXEC_PERM : 0);
+}
+
+// Map one PT_LOAD segment. Returns false once something could not be mapped;
+// whatever was mapped is freed with the tables.
+static bool load_segment(Process* p, const uint8_t* image, uint64_t size, const Elf64_Phdr& ph,
+                         bool* flush_icache) {
+    uint64_t va = ph.p_vaddr;
+    uint64_t off = ph.p_offset;
+    uint64_t filesz = ph.p_filesz;
+    uint64_t memsz = ph.p_memsz;
+    if (memsz == 0) return true;
+    if (filesz > memsz || off > size || filesz > size - off) {
+        return load_error(p->name, "segment outside the image");
+    }
+    if (va < USER_VA_START || va >= USER_MMAP_BASE || memsz > USER_MMAP_BASE - va) {
+        return load_error(p->name, "segment outside the user range");
+    }
+
+    uint32_t perms = segment_perms(ph.p_flags);
+    // Shared pages show the whole image page, so only segments without bss
+    // that sit at their own page offset in a page-aligned image qualify
+    bool share = !(perms & WRITE_PERM) && filesz == memsz && !((uintptr_t)image & PAGE_MASK) &&
+                 !((va - off) & PAGE_MASK);
+
+    uint64_t end = (va + memsz + PAGE_MASK) & ~PAGE_MASK;
+    for (uint64_t page = va & ~PAGE_MASK; page < end; page += PAGE_SIZE_4KB) {
+        uint64_t file_page = off - (va - page);
+        if (share && file_page + PAGE_SIZE_4KB <= size) {
+            if (!vm_user_map(p->pgd, page, virt_to_phys(image + file_page), perms, false)) {
+                return load_error(p->name, "overlapping segments or no memory");
+            }
+            p->pages_shared++;
+            continue;
+        }
+
+        uint8_t* copy = (uint8_t*)kmalloc_aligned(PAGE_SIZE_4KB, PAGE_SIZE_4KB);
+        if (!copy) return load_error(p->name, "no memory for a segment");
+        K::memset(copy, 0, PAGE_SIZE_4KB);
+        // The part of [va, va + filesz) on this page; the rest stays zero
+        uint64_t lo = page > va ? page : va;
+        uint64_t hi = page + PAGE_SIZE_4KB < va + filesz ? page + PAGE_SIZE_4KB : va + filesz;
+        if (lo < hi) K::memcpy(copy + (lo - page), image + off + (lo - va), (int)(hi - lo));
+        if (!vm_user_map(p->pgd, page, virt_to_phys(copy), perms, true)) {
+            kfree_aligned(copy);
+            return load_error(p->name, "overlapping segments or no memory");
+        }
+        if (perms & EXEC_PERM) {
+            clean_dcache_range(copy, PAGE_SIZE_4KB);
+            *flush_icache = true;
+        }
+        p->pages_copied++;
+    }
+    return true;
+}
+
+static bool load_elf(Process* p, const uint8_t* image, uint64_t size) {
+    const Elf64_Ehdr* eh = (const Elf64_Ehdr*)image;
+    if (((uintptr_t)image & 7) || size < sizeof(Elf64_Ehdr)) {
+        return load_error(p->name, "image too small or misaligned");
+    }
+    for (int i = 0; i < 4; i++) {
+        if (eh->e_ident[i] != ELFMAG[i]) return load_error(p->name, "not an ELF image");
+    }
+    if (eh->e_ident[4] != ELFCLASS64 || eh->e_ident[5] != ELFDATA2LSB || eh->e_type != ET_EXEC ||
+        eh->e_machine != EM_AARCH64) {
+        return load_error(p->name, "not an AArch64 ELF64 executable");
+    }
+    if (eh->e_phentsize != sizeof(Elf64_Phdr) || (eh->e_phoff & 7) || eh->e_phoff > size ||
+        eh->e_phnum > (size - eh->e_phoff) / sizeof(Elf64_Phdr)) {
+        return load_error(p->name, "bad program headers");
+    }
+
+    const Elf64_Phdr* ph = (const Elf64_Phdr*)(image + eh->e_phoff);
+    bool flush_icache = false;
+    for (uint32_t i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type != PT_LOAD) continue;
+        if (!load_segment(p, image, size, ph[i], &flush_icache)) return false;
+    }
+    // Copied code may run on any core
+    if (flush_icache) asm volatile("dsb ish\n\tic ialluis\n\tdsb ish\n\tisb" ::: "memory");
+
+    if (!vm_user_lookup(p->pgd, eh->e_entry, EXEC_PERM)) {
+        return load_error(p->name, "entry point is not executable");
+    }
+    p->entry = eh->e_entry;
+    return true;
+}
+
+static bool map_anonymous(Process* p, uint64_t va, uint64_t len, uint32_t perms) {
+    for (uint64_t off = 0; off < len; off += PAGE_SIZE_4KB) {
+        void* page = kmalloc_aligned(PAGE_SIZE_4KB, PAGE_SIZE_4KB);
+        if (!page) return false;
+        K::memset(page, 0, PAGE_SIZE_4KB);
+        if (!vm_user_map(p->pgd, va + off, virt_to_phys(page), perms, true)) {
+            kfree_aligned(page);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void process_start(void* arg) {
+    Process* p = (Process*)arg;
+    Thread* me = current_thread();
+    Interrupts::disable();
+    me->process = p;
+    me->user_sp = USER_STACK_TOP;
+    me->user_tpidr = 0;  // enter_el0() clears it
+    loaded.mine() = p;
+    vm_user_switch(p->pgd, p->asid);
+    enter_el0(p->entry, USER_STACK_TOP, (uint64_t)me->stack + THREAD_STACK_SIZE);
+}
+
+Process* process_create(const char* name, const void* image, uint64_t size, int core) {
+    Process* p = new Process{name, nullptr, 0, 0, USER_MMAP_BASE, 0, 0, 0, 0};
+    if (!p) return nullptr;
+    p->asid = asid_alloc();
+    if (!p->asid) {
+        load_error(name, "out of ASIDs");
+    } else if (!(p->pgd = vm_user_create())) {
+        load_error(name, "no memory for page tables");
+    } else if (load_elf(p, (const uint8_t*)image, size)) {
+        if (map_anonymous(p, USER_STACK_TOP - USER_STACK_SIZE, USER_STACK_SIZE,
+                          READ_PERM | WRITE_PERM) &&
+            vm_user_map(p->pgd, USER_TIME_PAGE, virt_to_phys(time_page()), READ_PERM, false)) {
+            thread_create(name, process_start, p, core);
+            return p;
+        }
+        load_error(name, "no memory for the stack");
+    }
+    free_mm(p);
+    delete p;
+    return nullptr;
+}
+
+int process_wait(Process* p) {
+    // The exiting thread only uses state as a futex key after setting it,
+    // so p can go as soon as it reads 1
+    while (__atomic_load_n(&p->state, __ATOMIC_ACQUIRE) == 0) futex_wait(&p->state, 0);
+    int code = p->exit_code;
+    delete p;
+    return code;
+}
+
+Process* current_process() {
+    Thread* t = current_thread();
+    return t ? t->process : nullptr;
+}
+
+void process_exit(int code) {
+    Thread* me = current_thread();
+    Process* p = me->process;
+    if (!p) panic("process_exit() from kernel thread %s", me->name);
+
+    // No core but this one can have the tables loaded: the thread never
+    // leaves it
+    Interrupts::protect([me] {
+        me->process = nullptr;
+        loaded.mine() = nullptr;
+        vm_user_switch(nullptr, 0);
+    });
+    free_mm(p);
+
+    p->exit_code = code;
+    __atomic_store_n(&p->state, 1, __ATOMIC_RELEASE);
+    futex_wake(&p->state, 0xFFFFFFFF);
+    thread_exit();
+}
+
+// A process is a single thread, so its mmap_next needs no lock
+uint64_t process_mmap(Process* p, uint64_t len, uint32_t perms) {
+    uint64_t limit = USER_TIME_PAGE;
+    if (len == 0 || len > limit - p->mmap_next) return 0;
+    len = (len + PAGE_MASK) & ~PAGE_MASK;
+    if (len > limit - p->mmap_next) return 0;
+
+    uint64_t va = p->mmap_next;
+    // Pages mapped before a failure stay until exit, so skip the range
+    p->mmap_next += len;
+    return map_anonymous(p, va, len, perms) ? va : 0;
+}
+
+void process_switch_to(Thread* prev, Thread* next) {
+    if (prev->process) {
+        asm volatile("mrs %0, sp_el0" : "=r"(prev->user_sp));
+        asm volatile("mrs %0, tpidr_el0" : "=r"(prev->user_tpidr));
+    }
+    Process* p = next->process;
+    if (!p) return;
+    asm volatile("msr sp_el0, %0" ::"r"(next->user_sp));
+    asm volatile("msr tpidr_el0, %0" ::"r"(next->user_tpidr));
+    Process*& cur = loaded.mine();
+    if (cur != p) {
+        cur = p;
+        vm_user_switch(p->pgd, p->asid);
+    }
+}
@@ -0,0 +1,145 @@
+#include "rcu.h"
+#include "atomic.h"
+#include "core.h"
+#include "percpu.h"
+#include "softirq.h"
+#include "timer.h"
+#include "utils.h"
+
+struct RcuCpu {
+    Atomic<uint32_t> qs{0};       // bumped at every quiescent state
+    Atomic<bool> online{false};   // false while idle: no references held
+
+    // Callback batches, touched only by the owning core with IRQs masked
+    RcuHead* next_list = nullptr;     // queued since the current batch began
+    RcuHead* wait_list = nullptr;     // waiting for the grace period below
+    uint32_t wait_snap[CORE_COUNT] = {};
+    uint32_t pending = 0;
+};
+
+static PerCPU<RcuCpu> rcu_cpu;
+
+static inline bool has_passed(uint32_t core, uint32_t snap) {
+    RcuCpu& cpu = rcu_cpu.forCPU(core);
+    return !cpu.online.get() || cpu.qs.get() != snap;
+}
+
+static void snapshot(uint32_t* snap) {
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        snap[core] = rcu_cpu.forCPU(core).qs.get();
+    }
+}
+
+static void process_callbacks(RcuCpu& me) {
+    RcuHead* ready = nullptr;
+
+    Interrupts::protect([&] {
+        if (me.wait_list) {
+            for (uint32_t core = 0; core < CORE_COUNT; core++) {
+                if (!has_passed(core, me.wait_snap[core])) return;
+            }
+            ready = me.wait_list;
+            me.wait_list = nullptr;
+        }
+        // Start the next batch once the previous one has drained
+        if (me.next_list) {
+            me.wait_list = me.next_list;
+            me.next_list = nullptr;
+            snapshot(me.wait_snap);
+        }
+    });
+
+    uint32_t invoked = 0;
+    while (ready) {
+        RcuHead* next = ready->next;
+        ready->func(ready);
+        ready = next;
+        invoked++;
+    }
+    if (invoked) {
+        Interrupts::protect([&] { me.pending -= invoked; });
+    }
+}
+
+void rcu_quiescent_state() {
+    RcuCpu& me = rcu_cpu.mine();
+    me.qs.add_fetch(1);
+    if (me.wait_list || me.next_list) {
+        process_callbacks(me);
+    }
+}
+
+void rcu_note_context_switch() {
+    rcu_cpu.mine().qs.add_fetch(1);
+}
+
+static void rcu_softirq() {
+    RcuCpu& me = rcu_cpu.mine();
+    if (me.wait_list || me.next_list) {
+        process_callbacks(me);
+    }
+}
+
+void rcu_init() {
+    open_softirq(SoftirqType::Rcu, rcu_softirq);
+}
+
+bool rcu_check_callbacks() {
+    RcuCpu& me = rcu_cpu.mine();
+    // Readers run with preemption disabled, so none was interrupted
+    if (Preempt::isEnabled()) me.qs.add_fetch(1);
+    if (!me.wait_list && !me.next_list) return false;
+    raise_softirq(SoftirqType::Rcu);
+    return true;
+}
+
+bool rcu_needs_cpu() {
+    RcuCpu& me = rcu_cpu.mine();
+    return me.wait_list || me.next_list;
+}
+
+void rcu_idle_enter() {
+    RcuCpu& me = rcu_cpu.mine();
+    me.qs.add_fetch(1);
+    me.online.set(false);
+}
+
+void rcu_idle_exit() {
+    rcu_cpu.mine().online.set(true);
+}
+
+bool rcu_is_online() {
+    return rcu_cpu.mine().online.get();
+}
+
+void synchronize_rcu() {
+    uint32_t me = getCoreID();
+    uint32_t snap[CORE_COUNT];
+    snapshot(snap);
+
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me) continue;
+        while (!has_passed(core, snap[core])) {
+            // We hold no references while waiting; keep reporting so that
+            // two cores synchronizing at once cannot wait on each other.
+            rcu_cpu.forCPU(me).qs.add_fetch(1);
+        }
+    }
+}
+
+void call_rcu(RcuHead* head, void (*func)(RcuHead* head)) {
+    RcuCpu& me = rcu_cpu.mine();
+    head->func = func;
+    Interrupts::protect([&] {
+        head->next = me.next_list;
+        me.next_list = head;
+        me.pending++;
+        // The tick drives the callbacks from here; the scheduler leaves it
+        // on until they have all run
+        timer_tick_enable(true);
+    });
+}
+
+uint32_t rcu_pending_callbacks() {
+    return rcu_cpu.mine().pending;
+}
@@ -0,0 +1,339 @@
+#include "sched.h"
+#include "atomic.h"
+#include "heap.h"
+#include "ipi.h"
+#include "percpu.h"
+#include "printf.h"
+#include "process.h"
+#include "rcu.h"
+#include "timer.h"
+
+extern "C" void cpu_switch_to(CpuContext* prev, CpuContext* next);
+extern "C" void thread_trampoline();
+
+struct RunQueue {
+    ISL lock{"runqueue"};  // guards the queue and the state of its threads
+    Thread* head = nullptr;
+    Thread* tail = nullptr;
+
+    // Owned by this core, touched with IRQs masked
+    Thread* current = nullptr;
+    Thread* idle = nullptr;
+    Thread* dead = nullptr;  // exited thread waiting to be freed
+    uint64_t switches = 0;
+
+    bool ticking = true;  // whether this core's tick is on; under the lock
+};
+
+static PerCPU<RunQueue> runqueues;
+static PerCPU<IdleStats> idle_stats;
+static PerCPU<Thread> boot_threads;
+
+PerCPU<PreemptState> Preempt::state;
+
+static void enqueue(RunQueue& rq, Thread* t) {
+    t->next = nullptr;
+    if (rq.tail) {
+        rq.tail->next = t;
+    } else {
+        rq.head = t;
+    }
+    rq.tail = t;
+}
+
+static Thread* dequeue(RunQueue& rq) {
+    Thread* t = rq.head;
+    if (t) {
+        rq.head = t->next;
+        if (!rq.head) rq.tail = nullptr;
+        t->next = nullptr;
+    }
+    return t;
+}
+
+static Thread* make_thread(const char* name, void (*fn)(void*), void* arg, uint32_t core) {
+    Thread* t = new Thread;
+    t->stack = kmalloc_aligned(THREAD_STACK_SIZE, 16);
+    if (!t->stack) panic("sched: no memory for a stack for %s", name);
+
+    for (int i = 0; i < 10; i++) t->context.x19_x28[i] = 0;
+    t->context.x19_x28[0] = (uint64_t)fn;  // x19
+    t->context.x19_x28[1] = (uint64_t)arg; // x20
+    t->context.fp = 0;
+    t->context.lr = (uint64_t)thread_trampoline;
+    t->context.sp = (uint64_t)t->stack + THREAD_STACK_SIZE;
+
+    t->next = nullptr;
+    t->state = ThreadState::Runnable;
+    t->core = core;
+    t->name = name;
+    t->switches = 0;
+    t->fp_used = false;
+    t->process = nullptr;
+    t->user_sp = 0;
+    t->user_tpidr = 0;
+    return t;
+}
+
+// Runs on the new thread's stack right after every switch
+static void finish_switch() {
+    RunQueue& rq = runqueues.mine();
+    Thread* dead = rq.dead;
+    if (dead) {
+        rq.dead = nullptr;
+        kfree_aligned(dead->stack);
+        delete dead;
+    }
+}
+
+// First thing a new thread does (see thread_trampoline)
+extern "C" void schedule_tail() {
+    finish_switch();
+    Interrupts::enable();
+}
+
+static void idle_loop(void*) {
+    RunQueue& rq = runqueues.mine();
+    IdleStats& stats = idle_stats.mine();
+    while (true) {
+        // Check and sleep with IRQs masked: a wakeup that lands in between
+        // stays pending and ends the wfi, and its handler runs only after
+        // the residency has been accounted
+        Interrupts::disable();
+        if (!__atomic_load_n(&rq.head, __ATOMIC_RELAXED)) {
+            bool online = rcu_is_online();
+            if (online) rcu_idle_enter();
+            uint64_t start = timer_count();
+            wfi();
+            stats.idle_entries++;
+            stats.idle_total += timer_count() - start;
+            if (online) rcu_idle_exit();
+        }
+        Interrupts::enable();
+
+        if (__atomic_load_n(&rq.head, __ATOMIC_RELAXED)) schedule();
+    }
+}
+
+void sched_init() {
+    uint32_t core = this_core();
+    RunQueue& rq = runqueues.mine();
+
+    Thread* boot = &boot_threads.mine();
+    boot->next = nullptr;
+    boot->state = ThreadState::Running;
+    boot->core = core;
+    boot->name = "boot";
+    boot->stack = nullptr;
+    boot->switches = 0;
+    boot->fp_used = false;
+    boot->process = nullptr;
+    boot->user_sp = 0;
+    boot->user_tpidr = 0;
+    fpsimd_init();
+
+    rq.idle = make_thread("idle", idle_loop, nullptr, core);
+    rq.current = boot;
+}
+
+void sched_start() {
+    timer_tick_init(SCHED_TICK_HZ);
+    Interrupts::enable();
+}
+
+// Called under rq's lock after queueing onto core. Returns true if core
+// must be sent a reschedule IPI: it is idle, or busy with its tick stopped.
+// A busy core with the tick running switches at its next tick.
+static bool needs_kick(RunQueue& rq, uint32_t core) {
+    if (core != this_core()) return rq.current == rq.idle || !rq.ticking;
+
+    if (rq.current == rq.idle) {
+        Preempt::setNeedResched(true);
+    } else if (!rq.ticking) {
+        rq.ticking = true;
+        timer_tick_enable(true);
+    }
+    return false;
+}
+
+Thread* thread_create(const char* name, void (*fn)(void*), void* arg, int core) {
+    uint32_t target = core < 0 ? this_core() : (uint32_t)core;
+    Thread* t = make_thread(name, fn, arg, target);
+
+    RunQueue& rq = runqueues.forCPU(target);
+    uint64_t daif = rq.lock.lock();
+    enqueue(rq, t);
+    bool kick = needs_kick(rq, target);
+    rq.lock.unlock(daif);
+
+    if (kick) ipi_send(target, IpiType::Reschedule);
+    return t;
+}
+
+void thread_exit() {
+    Interrupts::disable();
+    RunQueue& rq = runqueues.mine();
+    Thread* me = rq.current;
+    me->state = ThreadState::Dead;
+    fpsimd_thread_exit(me);
+    // The boot thread's stack and Thread are static
+    if (me->stack) rq.dead = me;
+    schedule();
+    panic("sched: exited thread %s was scheduled again", me->name);
+}
+
+Thread* current_thread() {
+    return runqueues.mine().current;
+}
+
+bool sched_can_block() {
+    return current_thread() && !Interrupts::inIRQ() && Preempt::isEnabled();
+}
+
+void yield() {
+    schedule();
+}
+
+void schedule() {
+#ifdef LOCK_DEBUG
+    if (!Preempt::isEnabled()) {
+        panic("sched: schedule() with preemption disabled on core %d", (int)this_core());
+    }
+#endif
+    uint64_t daif = Interrupts::disable();
+    RunQueue& rq = runqueues.mine();
+    Thread* prev = rq.current;
+
+    uint64_t masked = rq.lock.lock();
+    Preempt::setNeedResched(false);
+    // A thread that blocked and was woken before getting here is already
+    // back on the queue as Runnable
+    if (prev->state == ThreadState::Running && prev != rq.idle) {
+        prev->state = ThreadState::Runnable;
+        enqueue(rq, prev);
+    }
+    Thread* next = dequeue(rq);
+    if (!next) next = rq.idle;
+    next->state = ThreadState::Running;
+    rq.current = next;
+    // Round robin only needs the tick while someone else is waiting; RCU
+    // callbacks need it until they have run
+    bool tick = rq.head != nullptr || rcu_needs_cpu();
+    if (tick != rq.ticking) {
+        rq.ticking = tick;
+        timer_tick_enable(tick);
+    }
+    rq.lock.unlock(masked);
+
+    if (next != prev) {
+        rq.switches++;
+        next->switches++;
+        rcu_note_context_switch();
+        fpsimd_switch_to(next);
+        process_switch_to(prev, next);
+        cpu_switch_to(&prev->context, &next->context);
+        // Back on prev's stack, possibly much later
+        finish_switch();
+    }
+    Interrupts::restore(daif);
+}
+
+void preempt_schedule() {
+    schedule();
+}
+
+void preempt_schedule_irq() {
+    if (!current_thread() || !Preempt::isEnabled() || !Preempt::needResched()) return;
+    // The interrupted thread's FP/SIMD registers stay live until someone
+    // else traps on them
+    schedule();
+}
+
+void sched_block_if(bool (*still_blocked)(void* arg), void* arg) {
+    uint64_t daif = Interrupts::disable();
+    RunQueue& rq = runqueues.mine();
+
+    uint64_t masked = rq.lock.lock();
+    bool block = still_blocked(arg);
+    if (block) rq.current->state = ThreadState::Blocked;
+    rq.lock.unlock(masked);
+
+    if (block) schedule();
+    Interrupts::restore(daif);
+}
+
+void sched_wakeup(Thread* t) {
+    RunQueue& rq = runqueues.forCPU(t->core);
+    bool kick = false;
+
+    uint64_t daif = rq.lock.lock();
+    if (t->state == ThreadState::Blocked) {
+        t->state = ThreadState::Runnable;
+        enqueue(rq, t);
+        kick = needs_kick(rq, t->core);
+    }
+    rq.lock.unlock(daif);
+
+    if (kick) ipi_send(t->core, IpiType::Reschedule);
+}
+
+struct SleepTimer {
+    TimerEvent ev;  // must stay first, the callback casts back from it
+    Thread* thread;
+    volatile bool fired;
+};
+
+static void sleep_timer_fired(TimerEvent* ev) {
+    SleepTimer* s = (SleepTimer*)ev;
+    s->fired = true;
+    sched_wakeup(s->thread);
+}
+
+void sleep_until(uint64_t deadline) {
+    if (timer_count() >= deadline) return;
+    if (!sched_can_block()) {
+        while (timer_count() < deadline) cpu_relax();
+        return;
+    }
+
+    // Queued and fired on this core, so the event can live on our stack
+    SleepTimer s{{deadline, sleep_timer_fired}, current_thread(), false};
+    timer_add(s.ev);
+    sched_block_if([](void* arg) { return !((SleepTimer*)arg)->fired; }, &s);
+
+    uint64_t late = timer_count() - deadline;
+    Interrupts::protect([late] {
+        IdleStats& stats = idle_stats.mine();
+        stats.wakeups++;
+        stats.wakeup_latency_total += late;
+        if (late > stats.wakeup_latency_max) stats.wakeup_latency_max = late;
+    });
+}
+
+bool sched_tick() {
+    RunQueue& rq = runqueues.mine();
+    if (!rq.current) return false;
+
+    bool rcu = rcu_check_callbacks();
+
+    // Round robin with a one-tick slice: switch whenever someone is waiting,
+    // otherwise stop ticking until someone is queued here or RCU is done
+    uint64_t masked = rq.lock.lock();
+    bool waiting = rq.head != nullptr;
+    if (waiting) Preempt::setNeedResched(true);
+    rq.ticking = waiting || rcu;
+    rq.lock.unlock(masked);
+    return waiting || rcu;
+}
+
+uint64_t sched_switch_count(uint32_t core) {
+    return runqueues.forCPU(core).switches;
+}
+
+IdleStats sched_idle_stats(uint32_t core) {
+    return idle_stats.forCPU(core);
+}
+
+void sched_idle_stats_reset() {
+    Interrupts::protect([] { idle_stats.mine() = IdleStats{0, 0, 0, 0, 0}; });
+}
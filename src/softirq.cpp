@@ -0,0 +1,156 @@
+#include "softirq.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "sched.h"
+#include "timer.h"
+#include "wait.h"
+
+PerCPU<uint32_t> Interrupts::softirq_depth;
+
+struct SoftirqCpu {
+    uint32_t pending = 0;  // raised types, only changed on this core with IRQs masked
+    bool running = false;  // a pass is in progress, possibly with IRQs enabled
+    Tasklet* tasklets = nullptr;
+    Tasklet* tasklets_tail = nullptr;
+    WaitQueue wq{"softirqd"};
+    SoftirqStats stats = {};
+};
+
+static void (*handlers[SOFTIRQ_TYPES])();
+static PerCPU<SoftirqCpu> cpus;
+
+static inline uint64_t pass_budget() {
+    return timer_frequency() / 1000000 * SOFTIRQ_BUDGET_US;
+}
+
+// Run rounds of pending handlers until nothing is pending or the budget is
+// spent. Called with IRQs masked and preemption disabled; returns the time
+// the pass took.
+static uint64_t run_pass(SoftirqCpu& s) {
+    uint64_t start = timer_count();
+    uint64_t deadline = start + pass_budget();
+
+    s.running = true;
+    Interrupts::enterSoftirq();
+    for (uint32_t round = 0; s.pending && round < SOFTIRQ_MAX_ROUNDS; round++) {
+        uint32_t pending = s.pending;
+        s.pending = 0;
+        Interrupts::enable();
+        while (pending) {
+            uint32_t type = __builtin_ctz(pending);
+            pending &= pending - 1;
+            uint64_t t0 = timer_count();
+            if (handlers[type]) handlers[type]();
+            s.stats.runs[type]++;
+            s.stats.cycles[type] += timer_count() - t0;
+        }
+        Interrupts::disable();
+        if (timer_count() >= deadline) break;
+    }
+    Interrupts::exitSoftirq();
+    s.running = false;
+    return timer_count() - start;
+}
+
+void open_softirq(SoftirqType type, void (*handler)()) {
+    handlers[(uint32_t)type] = handler;
+}
+
+void raise_softirq(SoftirqType type) {
+    SoftirqCpu& s = cpus.mine();
+    uint64_t daif = Interrupts::disable();
+    s.pending |= 1u << (uint32_t)type;
+    bool kick = !Interrupts::inIRQ() && !s.running;
+    Interrupts::restore(daif);
+
+    // Outside an IRQ nothing would run it before the next interrupt
+    if (kick) s.wq.wake_one();
+}
+
+void softirq_irq_exit(uint64_t irq_start) {
+    SoftirqCpu& s = cpus.mine();
+    uint64_t spent = timer_count() - irq_start;
+    s.stats.hardirqs++;
+    s.stats.hardirq_cycles += spent;
+    if (spent > s.stats.hardirq_max) s.stats.hardirq_max = spent;
+
+    // An IRQ that interrupted a pass leaves its work to that pass
+    if (!s.pending || s.running) return;
+
+    Preempt::disable();
+    s.stats.exit_cycles += run_pass(s);
+    s.stats.exit_passes++;
+    bool left = s.pending != 0;
+    if (left) s.stats.deferred++;
+    // IRQs are still masked, so this can't switch; handle_irq does that
+    Preempt::enable();
+
+    if (left) s.wq.wake_one();
+}
+
+static void softirqd(void*) {
+    SoftirqCpu& s = cpus.mine();
+    while (true) {
+        wait_event(s.wq, [&s] { return __atomic_load_n(&s.pending, __ATOMIC_RELAXED) != 0; });
+
+        uint64_t daif = Interrupts::disable();
+        Preempt::disable();
+        if (!s.running && s.pending) {
+            s.stats.thread_cycles += run_pass(s);
+            s.stats.thread_passes++;
+        }
+        Preempt::enable();
+        Interrupts::restore(daif);
+
+        // Whatever is left waits its turn behind the other runnable threads
+        yield();
+    }
+}
+
+static void tasklet_softirq() {
+    SoftirqCpu& s = cpus.mine();
+    uint64_t daif = Interrupts::disable();
+    Tasklet* list = s.tasklets;
+    s.tasklets = nullptr;
+    s.tasklets_tail = nullptr;
+    Interrupts::restore(daif);
+
+    // Tasklets scheduled from here on go to the next round
+    while (list) {
+        Tasklet* next = list->next;
+        __atomic_store_n(&list->queued, 0, __ATOMIC_RELEASE);
+        list->fn(list);
+        list = next;
+    }
+}
+
+bool tasklet_schedule(Tasklet& t) {
+    if (__atomic_exchange_n(&t.queued, 1, __ATOMIC_ACQUIRE)) return false;
+
+    SoftirqCpu& s = cpus.mine();
+    uint64_t daif = Interrupts::disable();
+    t.next = nullptr;
+    if (s.tasklets_tail) {
+        s.tasklets_tail->next = &t;
+    } else {
+        s.tasklets = &t;
+    }
+    s.tasklets_tail = &t;
+    Interrupts::restore(daif);
+
+    raise_softirq(SoftirqType::Tasklet);
+    return true;
+}
+
+void softirq_init() {
+    open_softirq(SoftirqType::Tasklet, tasklet_softirq);
+    thread_create("softirqd", softirqd, nullptr, this_core());
+}
+
+SoftirqStats softirq_stats(uint32_t core) {
+    return cpus.forCPU(core).stats;
+}
+
+void softirq_stats_reset() {
+    Interrupts::protect([] { cpus.mine().stats = SoftirqStats{}; });
+}
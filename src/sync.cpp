@@ -0,0 +1,69 @@
+#include "sync.h"
+#include "atomic.h"
+#include "wait.h"
+
+void Mutex::lock_slow() {
+    // Spin while the holder is the only contender; once someone is asleep,
+    // queue behind them instead of barging
+    for (uint32_t i = 0; i < SYNC_SPIN_LIMIT; i++) {
+        uint32_t s = __atomic_load_n(&state, __ATOMIC_RELAXED);
+        if (s == 0 && try_lock()) return;
+        if (s == 2) break;
+        cpu_relax();
+    }
+
+    // We can't tell whether others are asleep, so take the lock as "2" and
+    // let our unlock do a (possibly needless) wake
+    while (__atomic_exchange_n(&state, 2, __ATOMIC_ACQUIRE) != 0) {
+        futex_wait(&state, 2);
+    }
+}
+
+void Mutex::unlock_slow() {
+    futex_wake(&state, 1);
+}
+
+void Semaphore::down() {
+    for (uint32_t i = 0; i < SYNC_SPIN_LIMIT; i++) {
+        if (try_down()) return;
+        cpu_relax();
+    }
+
+    // sleepers is raised before count is re-checked, and up() raises count
+    // before reading sleepers, so one of the two always sees the other
+    __atomic_fetch_add(&sleepers, 1, __ATOMIC_SEQ_CST);
+    while (!try_down()) {
+        futex_wait(&count, 0);
+    }
+    __atomic_fetch_sub(&sleepers, 1, __ATOMIC_RELAXED);
+}
+
+void Semaphore::up() {
+    __atomic_fetch_add(&count, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&count, 1);
+    }
+}
+
+void CondVar::wait(Mutex& m) {
+    uint32_t snap = __atomic_load_n(&seq, __ATOMIC_SEQ_CST);
+    __atomic_fetch_add(&sleepers, 1, __ATOMIC_SEQ_CST);
+    m.unlock();
+    futex_wait(&seq, snap);
+    __atomic_fetch_sub(&sleepers, 1, __ATOMIC_RELAXED);
+    m.lock();
+}
+
+void CondVar::signal() {
+    __atomic_fetch_add(&seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&seq, 1);
+    }
+}
+
+void CondVar::broadcast() {
+    __atomic_fetch_add(&seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) != 0) {
+        futex_wake(&seq, 0xFFFFFFFF);
+    }
+}
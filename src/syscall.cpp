@@ -0,0 +1,89 @@
+#include "syscall.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "printf.h"
+#include "process.h"
+#include "timekeeping.h"
+#include "uaccess.h"
+
+extern "C" SyscallCpu syscall_stats_table[CORE_COUNT];
+SyscallCpu syscall_stats_table[CORE_COUNT];
+
+static long sys_null(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t) {
+    return 0;
+}
+
+static long sys_write(uint64_t fd, uint64_t buf, uint64_t len, uint64_t, uint64_t, uint64_t) {
+    if (fd != 1 && fd != 2) return -EBADF;
+    if ((long)len < 0) return -EINVAL;
+    // The console lock masks IRQs, so hold it a chunk at a time. A fault
+    // part way ends the write at the bytes already out.
+    char chunk[256];
+    for (uint64_t done = 0; done < len;) {
+        uint64_t n = len - done < sizeof(chunk) ? len - done : sizeof(chunk);
+        uint64_t got = n - copy_from_user(chunk, (const char*)buf + done, n);
+        console_write(chunk, got);
+        done += got;
+        if (got < n) return done ? (long)done : -EFAULT;
+    }
+    return (long)len;
+}
+
+static long sys_exit(uint64_t code, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t) {
+    if (!current_process()) return -EPERM;
+    process_exit((int)code);
+}
+
+static long sys_mmap(uint64_t addr, uint64_t len, uint64_t prot, uint64_t flags, uint64_t fd,
+                     uint64_t off) {
+    (void)addr;  // only a hint without MAP_FIXED
+    Process* p = current_process();
+    if (!p) return -EPERM;
+    if (flags != (MAP_PRIVATE | MAP_ANONYMOUS) || (long)fd != -1 || off ||
+        (prot & ~(uint64_t)(PROT_READ | PROT_WRITE | PROT_EXEC))) {
+        return -EINVAL;
+    }
+    uint64_t va = process_mmap(p, len, (uint32_t)prot);
+    return va ? (long)va : -ENOMEM;
+}
+
+static long sys_yield(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t, uint64_t) {
+    yield();
+    return 0;
+}
+
+static long sys_clock_gettime(uint64_t clock, uint64_t ts, uint64_t, uint64_t, uint64_t,
+                              uint64_t) {
+    if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC) return -EINVAL;
+    // The same read a process can do on its own from USER_TIME_PAGE
+    Timespec now;
+    time_page_gettime(time_page(), clock, &now);
+    return copy_to_user((void*)ts, &now, sizeof(now)) ? -EFAULT : 0;
+}
+
+extern "C" const SyscallFn sys_call_table[NR_SYSCALLS] = {
+    [SYS_NULL] = sys_null,
+    [SYS_WRITE] = sys_write,
+    [SYS_EXIT] = sys_exit,
+    [SYS_MMAP] = sys_mmap,
+    [SYS_YIELD] = sys_yield,
+    [SYS_CLOCK_GETTIME] = sys_clock_gettime,
+};
+
+// Full-frame path, for any svc immediate but 0. Runs with IRQs masked.
+extern "C" void syscall_handler(TrapFrame* f) {
+    uint64_t nr = f->x[8];
+    if (nr >= NR_SYSCALLS) {
+        f->x[0] = (uint64_t)-ENOSYS;
+        return;
+    }
+    f->x[0] = (uint64_t)sys_call_table[nr](f->x[0], f->x[1], f->x[2], f->x[3], f->x[4], f->x[5]);
+}
+
+SyscallStats syscall_stats(uint32_t core, uint32_t nr) {
+    return nr < NR_SYSCALLS ? syscall_stats_table[core].stats[nr] : SyscallStats{};
+}
+
+void syscall_stats_reset() {
+    Interrupts::protect([] { syscall_stats_table[this_core()] = SyscallCpu{}; });
+}
@@ -1,6 +1,7 @@
 #include "testframework.h"
 #include "libk.h"
 #include "atomic.h"
+#include "uaccess.h"
 
 TestEntry* TestFramework::first_test = nullptr;
 TestResult TestFramework::current_result;
@@ -172,30 +173,14 @@ void TestFramework::assert_string_equal(const char* expected, const char* actual
 
 void TestFramework::assert_memory_access_fails(void* ptr, const char* message,
                                               const char* file, int line) {
-    if (!test_running) return;
-
-    (void)file;
-    (void)message;
-    (void)line;
-    
-    // This is a placeholder - in a real implementation, you would need
-    // exception handling to catch page faults
-    // For now, we'll assume the test knows what it's doing
-    printf("  [Memory access test at %p - manual verification needed]", ptr);
+    // Faults on the probe resume through the exception table
+    uint8_t byte;
+    assert_true(probe_read(&byte, ptr, 1) == -EFAULT, message, file, line);
 }
 
-bool TestFramework::test_null_pointer_protection(uint64_t address, uint64_t value) {    
-    printf("  Testing memory protection at address 0x%llx...", address);
-    
-    // Note: In a real implementation, you would set up exception handlers
-    // to catch the page fault and return true if it occurs
-    // For now, this is a simplified version
-    
-    volatile uint64_t* ptr = (volatile uint64_t*)address;
-    
-    *ptr = value;
-    
-    return false; // Protection failed if we can write
+bool TestFramework::test_null_pointer_protection(uint64_t address, uint64_t value) {
+    // True if the write faulted
+    return probe_write((void*)address, &value, sizeof(value)) == -EFAULT;
 }
 
 void TestFramework::fail_test(const char* reason, const char* file, int line) {
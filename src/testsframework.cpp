@@ -4,6 +4,30 @@
 #include "utils.h"
 #include "heap.h"
 #include "queue.h"
+#include "rcu.h"
+#include "channel.h"
+#include "percpu.h"
+#include "wait.h"
+#include "sync.h"
+#include "sched.h"
+#include "fpsimd.h"
+#include "ipi.h"
+#include "timer.h"
+#include "timerwheel.h"
+#include "workpool.h"
+#include "coro.h"
+#include "softirq.h"
+#include "bulkmem.h"
+#include "parallel.h"
+#include "irq.h"
+#include "irqlat.h"
+#include "syscall.h"
+#include "process.h"
+#include "elf.h"
+#include "timekeeping.h"
+#include "uart.h"
+#include "uaccess.h"
+#include "peripherals/local_intc.h"
 
 static bool tests_registered = false;
 
@@ -65,6 +89,177 @@ void test_atomic_bool() {
     TEST_ASSERT_TRUE(atomic_bool.get(), "atomic bool should be true after set");
 }
 
+// Every core goes through one barrier BARRIER_ROUNDS times, counting its
+// arrival before each round. Past round k all CORE_COUNT * (k + 1) arrivals
+// must be in and none of round k + 2, or some core got through early.
+static constexpr uint32_t BARRIER_ROUNDS = 200;
+
+struct BarrierRounds {
+    SenseBarrier sense{CORE_COUNT};
+    TreeBarrier<CORE_COUNT, 2> tree{CORE_COUNT};
+    bool use_tree;
+    Atomic<uint32_t> arrivals{0};
+    Atomic<uint32_t> early{0};
+    Atomic<uint32_t> finished{0};
+};
+
+static void barrier_rounds(BarrierRounds& r) {
+    for (uint32_t k = 0; k < BARRIER_ROUNDS; k++) {
+        r.arrivals.add_fetch(1);
+        if (r.use_tree) {
+            r.tree.sync(this_core());
+        } else {
+            r.sense.sync();
+        }
+        uint32_t seen = r.arrivals.get();
+        if (seen < CORE_COUNT * (k + 1) || seen >= CORE_COUNT * (k + 2)) {
+            r.early.add_fetch(1);
+        }
+    }
+}
+
+static void barrier_rounds_thread(void* arg) {
+    BarrierRounds* r = (BarrierRounds*)arg;
+    barrier_rounds(*r);
+    r->finished.add_fetch(1);
+}
+
+// Runs the rounds here and on a thread on every other core
+static void run_barrier_rounds(BarrierRounds& r) {
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core != this_core()) {
+            thread_create("barrier_rounds", barrier_rounds_thread, &r, (int)core);
+        }
+    }
+    barrier_rounds(r);
+    while (r.finished.get() != CORE_COUNT - 1) {
+        yield();
+    }
+}
+
+void test_sense_barrier_reuse() {
+    SenseBarrier single(1);
+
+    // A single participant must pass straight through, round after round
+    for (int i = 0; i < 3; i++) {
+        single.sync();
+    }
+
+    BarrierRounds r;
+    r.use_tree = false;
+    run_barrier_rounds(r);
+    TEST_ASSERT_EQUAL((int)(CORE_COUNT * BARRIER_ROUNDS), (int)r.arrivals.get(),
+                      "every core should finish every round");
+    TEST_ASSERT_EQUAL(0, (int)r.early.get(), "no core should leave a round before all arrived");
+}
+
+void test_tree_barrier_reuse() {
+    TreeBarrier<4, 2> single(1);
+    for (int i = 0; i < 3; i++) {
+        single.sync(0);
+    }
+    TEST_ASSERT_EQUAL(1, single.count(), "tree barrier should track participant count");
+
+    TreeBarrier<8, 2> wide(5);
+    TEST_ASSERT_EQUAL(5, wide.count(), "tree barrier should support more than 4 cores");
+
+    BarrierRounds r;
+    r.use_tree = true;
+    run_barrier_rounds(r);
+    TEST_ASSERT_EQUAL((int)(CORE_COUNT * BARRIER_ROUNDS), (int)r.arrivals.get(),
+                      "every core should finish every round");
+    TEST_ASSERT_EQUAL(0, (int)r.early.get(), "no core should leave a round before all arrived");
+}
+
+void test_interrupts_protect() {
+    uint64_t before = Interrupts::getFlags();
+    bool ran_masked = false;
+
+    Interrupts::protect([&ran_masked] { ran_masked = Interrupts::isDisabled(); });
+
+    TEST_ASSERT_TRUE(ran_masked, "protect() should run work with IRQs masked");
+    TEST_ASSERT_EQUAL((int)before, (int)Interrupts::getFlags(), "protect() should restore DAIF");
+}
+
+void test_interrupt_safe_lock() {
+    InterruptSafeLock lock;
+    uint64_t before = Interrupts::getFlags();
+
+    lock.lock();
+    TEST_ASSERT_TRUE(lock.isMine(), "lock should be taken after lock()");
+    TEST_ASSERT_TRUE(Interrupts::isDisabled(), "IRQs should be masked while held");
+    lock.unlock();
+
+    TEST_ASSERT_FALSE(lock.isMine(), "lock should be free after unlock()");
+    TEST_ASSERT_EQUAL((int)before, (int)Interrupts::getFlags(), "unlock() should restore DAIF");
+
+    ISL flexible;
+    uint64_t saved = flexible.lock();
+    TEST_ASSERT_TRUE(Interrupts::isDisabled(), "ISL should mask IRQs while held");
+    flexible.unlock(saved);
+    TEST_ASSERT_EQUAL((int)before, (int)Interrupts::getFlags(), "ISL unlock should restore DAIF");
+}
+
+static int rcu_callbacks_run = 0;
+
+static void count_rcu_callback(RcuHead*) {
+    rcu_callbacks_run++;
+}
+
+void test_rcu_synchronize() {
+    static int* shared = nullptr;
+    int* first = new int(1);
+    rcu_assign_pointer(shared, first);
+
+    int* second = new int(2);
+    rcu_read_lock();
+    TEST_ASSERT_EQUAL(1, *rcu_dereference(shared), "reader should see the published value");
+    rcu_read_unlock();
+
+    rcu_assign_pointer(shared, second);
+    synchronize_rcu();
+    delete first;
+
+    TEST_ASSERT_EQUAL(2, *rcu_dereference(shared), "reader should see the replacement");
+    rcu_assign_pointer(shared, (int*)nullptr);
+    synchronize_rcu();
+    delete second;
+}
+
+void test_rcu_call_rcu_deferred() {
+    RcuHead heads[3];
+    rcu_callbacks_run = 0;
+
+    for (int i = 0; i < 3; i++) {
+        call_rcu(&heads[i], count_rcu_callback);
+    }
+    TEST_ASSERT_EQUAL(0, rcu_callbacks_run, "call_rcu should not run callbacks immediately");
+    TEST_ASSERT_EQUAL(3, (int)rcu_pending_callbacks(), "callbacks should be queued on this core");
+
+    // The other cores are idle or waiting for the test lock, so the grace
+    // period completes after this core reports a couple of quiescent states
+    for (int i = 0; i < 1000 && rcu_pending_callbacks() != 0; i++) {
+        rcu_quiescent_state();
+    }
+    TEST_ASSERT_EQUAL(3, rcu_callbacks_run, "callbacks should run after a grace period");
+}
+
+void test_rcu_callbacks_run_unprompted() {
+    static RcuHead head;  // outlives the test if the callback never runs
+    rcu_callbacks_run = 0;
+    call_rcu(&head, count_rcu_callback);
+
+    // Nothing here reports a quiescent state: the tick and the RCU softirq
+    // have to get the callback run by themselves
+    uint64_t give_up = timer_count() + timer_frequency() / 2;
+    while (__atomic_load_n(&rcu_callbacks_run, __ATOMIC_RELAXED) == 0 && timer_count() < give_up) {
+        cpu_relax();
+    }
+    TEST_ASSERT_EQUAL(1, __atomic_load_n(&rcu_callbacks_run, __ATOMIC_RELAXED),
+                      "a callback should run without rcu_quiescent_state()");
+    TEST_ASSERT_EQUAL(0, (int)rcu_pending_callbacks(), "nothing should be left queued");
+}
+
 void test_spinlock_basic() {
     SpinLock lock;
     
@@ -127,57 +322,36 @@ void test_valid_memory_access() {
 }
 
 void test_null_pointer_protection() {
-    uint64_t core_id = getCoreID();
-    printf("\n  Core %lld: Testing null pointer protection at 0x0", core_id);
-    
-    uint64_t address = 0x0;
-    uint64_t test_value = 0xDEADBEEF;
-    
-    printf("\n  Core %lld: Attempting to write 0x%llx to address 0x%llx", core_id, test_value, address);
-    
-    volatile uint64_t* ptr = (volatile uint64_t*)address;
-    *ptr = test_value;
-    
-    TEST_FAIL("Write to null pointer succeeded - protection may not be enabled");
+    // Page 0 is left unmapped, so these fault and resume through the
+    // exception table
+    TEST_ASSERT_MEMORY_ACCESS_FAILS((void*)0, "Read from null pointer should fault");
+    TEST_ASSERT_TRUE(TestFramework::test_null_pointer_protection(0x0, 0xDEADBEEF),
+                     "Write to null pointer should fault");
 }
 
 void test_low_memory_protection() {
     uint64_t core_id = getCoreID();
-    
     uint64_t test_addresses[] = {0x0, 0xf0, 0xe8, 0xe0, 0x8, 0x10, 0x18, 0x20};
     uint64_t address = test_addresses[core_id % (sizeof(test_addresses) / sizeof(test_addresses[0]))];
-    
-    printf("\n  Core %lld: Testing low memory protection at 0x%llx", core_id, address);
-    
-    uint64_t test_value = 0xDEADBEEF;
-    
-    printf("\n  Core %lld: Attempting to write 0x%llx to address 0x%llx", core_id, test_value, address);
-    
-    volatile uint64_t* ptr = (volatile uint64_t*)address;
-    *ptr = test_value;
-    
-    TEST_FAIL("Write to protected low memory succeeded - protection may not be enabled");
+
+    uint64_t value = 0xDEADBEEF;
+    TEST_ASSERT_EQUAL(-EFAULT, probe_write((void*)address, &value, sizeof(value)),
+                      "Write to protected low memory should fault");
+    TEST_ASSERT_MEMORY_ACCESS_FAILS((void*)address, "Read from protected low memory should fault");
 }
 
 void test_memory_protection_boundaries() {
-    uint64_t core_id = getCoreID();
-    printf("\n  Core %lld: Testing memory protection boundaries", core_id);
-    
-    uint64_t protected_addresses[] = {0x0, 0x8, 0x10, 0x18, 0x20, 0xe0, 0xe8, 0xf0, 0xf8};
-    int num_addresses = sizeof(protected_addresses) / sizeof(protected_addresses[0]);
-    
-    printf("\n  Core %lld: Testing %d potentially protected addresses:", core_id, num_addresses);
-    
-    int start_idx = core_id * 2;
-    int end_idx = start_idx + 2;
-    if (end_idx > num_addresses) end_idx = num_addresses;
-    
-    for (int i = start_idx; i < end_idx; i++) {
-        printf("\n    Core %lld testing address 0x%llx: ", core_id, protected_addresses[i]);
-        printf("(would attempt write here)");
+    uint64_t protected_addresses[] = {0x0, 0x8, 0x10, 0x18, 0x20, 0xe0, 0xe8, 0xf0, 0xf8, 0xff8};
+    for (uint64_t address : protected_addresses) {
+        TEST_ASSERT_MEMORY_ACCESS_FAILS((void*)address, "Page 0 should not be readable");
     }
-    
-    TEST_ASSERT_TRUE(true, "Memory protection boundary test completed");
+
+    // The page after it is the identity map, so the fault is exactly at 0x1000
+    uint8_t bytes[16];
+    TEST_ASSERT_MEMORY_ACCESS_FAILS((void*)0xfff, "The last byte of page 0 should not be readable");
+    TEST_ASSERT_EQUAL(0, probe_read(bytes, (void*)0x1000, 1), "Page 1 should be readable");
+    TEST_ASSERT_EQUAL(16, (int)uaccess_copy(bytes, (void*)0xff8, 16),
+                      "A copy starting in page 0 should copy nothing");
 }
 
 void test_stack_isolation() {
@@ -477,6 +651,1031 @@ void test_queue_fill_and_drain() {
     }
 }
 
+void test_queue_generic_type() {
+    struct Pair {
+        int a, b;
+    };
+    Queue<Pair, SpinLock> q(2);
+    q.enqueue(Pair{1, 2});
+    q.enqueue(Pair{3, 4});
+    Pair first = q.dequeue();
+    Pair second = q.dequeue();
+    TEST_ASSERT_EQUAL(1, first.a, "Queue should store the element type, not int");
+    TEST_ASSERT_EQUAL(2, first.b, "Queue should store the element type, not int");
+    TEST_ASSERT_EQUAL(3, second.a, "Queue should preserve order for struct elements");
+    TEST_ASSERT_EQUAL(4, second.b, "Queue should preserve order for struct elements");
+}
+
+void test_mpmc_ring_basic() {
+    MPMCRing<int> ring(3);
+    TEST_ASSERT_EQUAL(4, (int)ring.capacity(), "capacity should round up to a power of two");
+
+    int value = -1;
+    TEST_ASSERT_FALSE(ring.try_dequeue(value), "empty ring should refuse dequeue");
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.try_enqueue(i), "enqueue should succeed until full");
+    }
+    TEST_ASSERT_FALSE(ring.try_enqueue(99), "full ring should refuse enqueue");
+
+    // Drain and refill a few times so the cursors wrap past the mask
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 4; i++) {
+            TEST_ASSERT_TRUE(ring.try_dequeue(value), "dequeue should succeed");
+            TEST_ASSERT_EQUAL(round * 4 + i, value, "ring should be FIFO");
+        }
+        for (int i = 0; i < 4; i++) ring.try_enqueue((round + 1) * 4 + i);
+    }
+}
+
+void test_mpmc_ring_bulk() {
+    MPMCRing<int> ring(8);
+    int in[10];
+    int out[10];
+    for (int i = 0; i < 10; i++) in[i] = i * 3;
+
+    TEST_ASSERT_EQUAL(8, (int)ring.enqueue_bulk(in, 10), "bulk enqueue should stop when full");
+    TEST_ASSERT_EQUAL(0, (int)ring.enqueue_bulk(in, 1), "bulk enqueue into a full ring is 0");
+    TEST_ASSERT_EQUAL(5, (int)ring.dequeue_bulk(out, 5), "bulk dequeue should take 5");
+    TEST_ASSERT_EQUAL(3, (int)ring.dequeue_bulk(out + 5, 10), "bulk dequeue takes what is left");
+    for (int i = 0; i < 8; i++) {
+        TEST_ASSERT_EQUAL(in[i], out[i], "bulk operations should preserve order");
+    }
+    TEST_ASSERT_EQUAL(0, (int)ring.dequeue_bulk(out, 4), "bulk dequeue from empty ring is 0");
+}
+void test_spsc_channel_basic() {
+    SPSCChannel<int, 4> ch;
+    int value = -1;
+
+    TEST_ASSERT_FALSE(ch.try_recv(value), "empty channel should refuse receive");
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ch.try_send(i), "send should succeed until full");
+    }
+    TEST_ASSERT_FALSE(ch.try_send(4), "full channel should refuse send");
+
+    int* front = ch.peek();
+    TEST_ASSERT_NOT_NULL(front, "peek should see the oldest message");
+    TEST_ASSERT_EQUAL(0, *front, "peek should not consume");
+    ch.pop();
+    for (int i = 1; i < 4; i++) {
+        TEST_ASSERT_TRUE(ch.try_recv(value), "receive should succeed");
+        TEST_ASSERT_EQUAL(i, value, "channel should be FIFO");
+    }
+    TEST_ASSERT_TRUE(ch.empty(), "channel should be empty after draining");
+}
+
+void test_core_channel_mesh() {
+    uint32_t me = getCoreID();
+    CoreMessage msg;
+
+    TEST_ASSERT_TRUE(core_channels.try_send(me, CoreMessage{7, 1, 2}), "send to self");
+    TEST_ASSERT_TRUE(core_channels.try_recv(me, msg), "receive from self");
+    TEST_ASSERT_EQUAL(7, (int)msg.type, "message type should survive the trip");
+    TEST_ASSERT_EQUAL(2, (int)msg.arg1, "message payload should survive the trip");
+
+    core_channels.try_send(me, CoreMessage{8, 0, 0});
+    int seen = 0;
+    uint32_t delivered = core_channels.poll([&seen](uint32_t, CoreMessage& m) { seen = m.type; });
+    TEST_ASSERT_EQUAL(1, (int)delivered, "poll should deliver the pending message");
+    TEST_ASSERT_EQUAL(8, seen, "poll should pass the message to the handler");
+}
+
+void test_percpu_layout() {
+    PerCPU<uint32_t> pc;
+    uint32_t me = getCoreID();
+
+    TEST_ASSERT_EQUAL(me, this_core(), "TPIDR_EL1 should hold the core id");
+    TEST_ASSERT_TRUE(&pc.mine() == &pc.forCPU(me), "mine() should be this core's slot");
+    TEST_ASSERT_TRUE((char*)&pc.forCPU(1) - (char*)&pc.forCPU(0) >= CACHE_LINE_SIZE,
+                     "slots should not share a cache line");
+    TEST_ASSERT_EQUAL(0, (int)((uint64_t)&pc.forCPU(0) % CACHE_LINE_SIZE), "slots should be line aligned");
+}
+
+void test_percpu_counter() {
+    PerCPUCounter<uint64_t> counter;
+    counter.reset();
+
+    counter.inc();
+    counter.add(41);
+    TEST_ASSERT_EQUAL(42, (int)counter.forCPU(getCoreID()), "updates should land in this core's slot");
+    TEST_ASSERT_EQUAL(42, (int)counter.sum(), "sum should fold every core's slot");
+
+    counter.reset();
+    TEST_ASSERT_EQUAL(0, (int)counter.sum(), "reset should clear every slot");
+}
+
+void test_wait_queue_wake() {
+    WaitQueue wq;
+    Waiter w;
+
+    TEST_ASSERT_TRUE(wq.enqueue_if(w, nullptr, [] { return true; }), "waiter should be queued");
+    TEST_ASSERT_TRUE(wq.has_waiters(), "queue should report the waiter");
+    TEST_ASSERT_EQUAL(1, (int)wq.wake_one(), "wake_one should wake the waiter");
+    TEST_ASSERT_TRUE(w.woken.get(), "waiter should be marked woken");
+    WaitQueue::block(w);  // already woken: must return at once
+    wq.finish(w);
+    TEST_ASSERT_TRUE(!wq.has_waiters(), "queue should be empty after the wake");
+    TEST_ASSERT_EQUAL(0, (int)wq.wake_all(), "nothing left to wake");
+
+    TEST_ASSERT_TRUE(!wq.enqueue_if(w, nullptr, [] { return false; }), "false predicate should not queue");
+    int calls = 0;
+    wait_event(wq, [&calls] { calls++; return true; });
+    TEST_ASSERT_EQUAL(1, calls, "wait_event should not sleep on a true condition");
+}
+
+void test_futex_value_changed() {
+    uint32_t word = 5;
+
+    TEST_ASSERT_TRUE(!futex_wait(&word, 4), "futex_wait should not sleep on a stale value");
+    TEST_ASSERT_EQUAL(0, (int)futex_wake(&word, 1), "no one is sleeping on the word");
+}
+
+void test_mutex_basic() {
+    Mutex m;
+
+    m.lock();
+    TEST_ASSERT_TRUE(!m.try_lock(), "try_lock should fail while held");
+    m.unlock();
+    TEST_ASSERT_TRUE(m.try_lock(), "try_lock should succeed once released");
+    m.unlock();
+}
+
+void test_semaphore_counting() {
+    Semaphore s(2);
+
+    s.down();
+    s.down();
+    TEST_ASSERT_TRUE(!s.try_down(), "count should be exhausted");
+    s.up();
+    TEST_ASSERT_EQUAL(1, (int)s.value(), "up should raise the count");
+    TEST_ASSERT_TRUE(s.try_down(), "try_down should take the released unit");
+}
+
+void test_condvar_predicate() {
+    Mutex m;
+    CondVar cv;
+    bool ready = true;
+
+    cv.signal();  // no sleepers: must not block or wake anything
+    m.lock();
+    cv.wait(m, [&ready] { return ready; });
+    TEST_ASSERT_TRUE(!m.try_lock(), "mutex should still be held after wait");
+    m.unlock();
+}
+
+static void set_flag_thread(void* arg) {
+    *(volatile bool*)arg = true;
+}
+
+void test_thread_runs_and_exits() {
+    volatile bool ran = false;
+    uint32_t core = getCoreID();
+    uint64_t switches = sched_switch_count(core);
+
+    thread_create("test", set_flag_thread, (void*)&ran);
+    while (!ran) {
+        yield();
+    }
+    TEST_ASSERT_TRUE(ran, "created thread should run once we yield");
+    TEST_ASSERT_TRUE(sched_switch_count(core) > switches, "yielding to it should switch contexts");
+    TEST_ASSERT_TRUE(current_thread() != nullptr, "boot thread should still be current");
+}
+
+struct SleeperArgs {
+    Semaphore sem{0};
+    volatile bool done = false;
+};
+
+static void sleeper_thread(void* arg) {
+    SleeperArgs* a = (SleeperArgs*)arg;
+    a->sem.down();
+    a->done = true;
+}
+
+void test_thread_blocks_and_wakes() {
+    SleeperArgs args;
+
+    thread_create("sleeper", sleeper_thread, &args);
+    yield();  // let it block on the semaphore
+    TEST_ASSERT_TRUE(!args.done, "sleeper should be blocked");
+    args.sem.up();
+    while (!args.done) {
+        yield();
+    }
+    TEST_ASSERT_TRUE(args.done, "sleeper should finish once woken");
+}
+
+struct FpProbe {
+    volatile bool wrote;
+    volatile bool done;
+    volatile uint64_t seen;
+};
+
+static void fp_probe_thread(void* arg) {
+    FpProbe* p = (FpProbe*)arg;
+    fpsimd_probe_write(0x2222);
+    p->wrote = true;
+    while (!p->done) {
+        yield();
+    }
+    p->seen = fpsimd_probe_read();
+    p->done = false;
+}
+
+void test_fpsimd_lazy_switch() {
+    FpProbe probe{false, false, 0};
+    uint32_t core = getCoreID();
+
+    fpsimd_probe_write(0x1111);
+    uint64_t traps = fpsimd_stats(core).traps;
+    thread_create("fp_probe", fp_probe_thread, &probe);
+    while (!probe.wrote) {
+        yield();
+    }
+    TEST_ASSERT_EQUAL(0x1111, (int)fpsimd_probe_read(), "our SIMD register should survive the other thread");
+    TEST_ASSERT_TRUE(fpsimd_stats(core).traps > traps, "FP use after a switch should trap");
+
+    probe.done = true;
+    while (probe.done) {
+        yield();
+    }
+    TEST_ASSERT_EQUAL(0x2222, (int)probe.seen, "the other thread's SIMD register should survive too");
+}
+
+void test_preempt_count() {
+    SpinLock spin;
+
+    TEST_ASSERT_TRUE(Preempt::isEnabled(), "thread context should be preemptible");
+    spin.lock();
+    TEST_ASSERT_TRUE(!Preempt::isEnabled(), "holding a SpinLock should disable preemption");
+    spin.unlock();
+    TEST_ASSERT_TRUE(Preempt::isEnabled(), "unlock should re-enable preemption");
+
+    // printf and the console take their own locks; they must leave the count
+    // where it was
+    printf("");
+    console_write("", 0);
+    TEST_ASSERT_TRUE(Preempt::isEnabled(), "printing should leave preemption enabled");
+}
+
+static void spin_until_stopped(void* arg) {
+    volatile bool* stop = (volatile bool*)arg;
+    while (!*stop) {
+    }
+    *stop = false;
+}
+
+void test_timer_tick_running() {
+    uint32_t core = getCoreID();
+    volatile bool stop = false;
+
+    // A second runnable thread on this core needs the round-robin tick
+    thread_create("tick_spinner", spin_until_stopped, (void*)&stop);
+    uint64_t before = timer_tick_stats(core).ticks;
+    uint64_t deadline = timer_count() + 3 * timer_frequency() / SCHED_TICK_HZ;
+
+    while (timer_tick_stats(core).ticks == before && timer_count() < deadline) {
+    }
+    TEST_ASSERT_TRUE(timer_tick_stats(core).ticks > before, "scheduler tick should be firing");
+
+    stop = true;
+    while (stop) {
+        yield();
+    }
+}
+
+void test_tick_stops_when_alone() {
+    uint32_t core = getCoreID();
+    uint64_t period = timer_frequency() / SCHED_TICK_HZ;
+
+    // Give a tick that was already armed the chance to fire and stop itself
+    uint64_t settle = timer_count() + 2 * period;
+    while (timer_count() < settle) {
+    }
+    uint64_t before = timer_tick_stats(core).ticks;
+    uint64_t deadline = timer_count() + 3 * period;
+    while (timer_count() < deadline) {
+    }
+    TEST_ASSERT_EQUAL((int)before, (int)timer_tick_stats(core).ticks,
+                      "a lone thread should run without a tick");
+}
+
+void test_sleep_until() {
+    uint32_t core = getCoreID();
+    uint64_t wakeups = sched_idle_stats(core).wakeups;
+    uint64_t deadline = timer_count() + timer_frequency() / 500;  // 2ms
+
+    sleep_until(deadline);
+    TEST_ASSERT_TRUE(timer_count() >= deadline, "sleep should last until the deadline");
+    TEST_ASSERT_TRUE(sched_idle_stats(core).wakeups > wakeups, "the wakeup should be counted");
+    TEST_ASSERT_TRUE(sched_idle_stats(core).idle_entries > 0, "the core should have idled in wfi");
+}
+
+void test_timer_wheel_cascade() {
+    static TimerWheel wheel;
+    TimerEvent near, mid, far, farther, cancelled;
+    uint32_t count;
+
+    wheel.init(1000);
+    wheel.add(near, 1005);
+    wheel.add(mid, 1070);          // level 1
+    wheel.add(far, 6000);          // level 2
+    wheel.add(farther, 301000);    // level 3
+    wheel.add(cancelled, 5100);
+    TEST_ASSERT_TRUE(wheel.remove(cancelled), "a queued timer should be removable");
+    TEST_ASSERT_EQUAL(4, (int)wheel.size(), "four timers should be queued");
+
+    TEST_ASSERT_TRUE(wheel.advance(1004, count) == nullptr, "nothing is due before 1005");
+    TEST_ASSERT_TRUE(wheel.advance(1005, count) == &near && count == 1, "near should expire at 1005");
+    TEST_ASSERT_TRUE(wheel.advance(1069, count) == nullptr, "mid is not due yet");
+    TEST_ASSERT_TRUE(wheel.advance(1070, count) == &mid, "mid should expire after cascading");
+    TEST_ASSERT_TRUE(wheel.advance(5999, count) == nullptr, "far is not due yet");
+    TEST_ASSERT_TRUE(wheel.advance(6000, count) == &far, "far should expire on time");
+    TEST_ASSERT_TRUE(wheel.advance(300999, count) == nullptr, "farther is not due yet");
+    TEST_ASSERT_TRUE(wheel.advance(301000, count) == &farther, "farther should expire on time");
+
+    TEST_ASSERT_EQUAL(0, (int)wheel.size(), "wheel should be empty");
+    TEST_ASSERT_TRUE(!wheel.remove(cancelled), "an unqueued timer can't be removed again");
+    TEST_ASSERT_TRUE(wheel.cascades() > 0, "the far timers should have cascaded");
+}
+
+struct FlagTimer {
+    TimerEvent ev;  // must stay first, set_flag casts back from it
+    volatile bool fired;
+};
+
+static void set_flag(TimerEvent* ev) {
+    ((FlagTimer*)ev)->fired = true;
+}
+
+void test_timer_event_fires() {
+    FlagTimer t{{timer_count() + timer_frequency() / 1000, set_flag}, false};  // 1ms
+    timer_add(t.ev);
+
+    uint64_t give_up = timer_count() + timer_frequency() / 50;
+    while (!t.fired && timer_count() < give_up) {
+    }
+    TEST_ASSERT_TRUE(t.fired, "the timer should have fired");
+    TEST_ASSERT_TRUE(timer_count() >= t.ev.deadline, "not before its deadline");
+    TEST_ASSERT_TRUE(!timer_cancel(t.ev), "a fired timer can't be cancelled");
+}
+
+struct RemoteCancel {
+    TimerEvent* ev;
+    bool removed;
+};
+
+static void cancel_from_here(void* arg) {
+    RemoteCancel* c = (RemoteCancel*)arg;
+    c->removed = timer_cancel(*c->ev);
+}
+
+void test_timer_cancel_remote() {
+    uint32_t core = this_core();
+    FlagTimer t{{timer_count() + timer_frequency(), set_flag}, false};  // 1s
+    uint64_t active = timer_active(core);
+    timer_add(t.ev);
+
+    RemoteCancel c{&t.ev, false};
+    smp_call_function_single((core + 1) % CORE_COUNT, cancel_from_here, &c);
+    TEST_ASSERT_TRUE(c.removed, "another core should be able to cancel our timer");
+    TEST_ASSERT_EQUAL((int)active, (int)timer_active(core), "the wheel should be back to its size");
+    TEST_ASSERT_TRUE(!t.fired, "a cancelled timer must not fire");
+}
+
+struct PairTimer {
+    TimerEvent ev;  // must stay first, cancel_other casts back from it
+    PairTimer* other;
+    volatile bool fired;
+    volatile bool cancelled_other;
+};
+
+static void cancel_other(TimerEvent* ev) {
+    PairTimer* p = (PairTimer*)ev;
+    p->fired = true;
+    p->cancelled_other = timer_cancel(p->other->ev);
+}
+
+void test_timer_cancel_in_batch() {
+    // Same deadline, so one batch; whichever runs first cancels the other
+    uint64_t deadline = timer_count() + timer_frequency() / 1000;  // 1ms
+    PairTimer a{{deadline, cancel_other}, nullptr, false, false};
+    PairTimer b{{deadline, cancel_other}, &a, false, false};
+    a.other = &b;
+    timer_add(a.ev);
+    timer_add(b.ev);
+
+    uint64_t give_up = timer_count() + timer_frequency() / 50;
+    while (timer_count() < give_up) {
+    }
+    TEST_ASSERT_TRUE(a.fired != b.fired, "the cancelled half of the batch must not run");
+    TEST_ASSERT_TRUE(a.cancelled_other || b.cancelled_other,
+                     "cancelling a later event of the running batch should succeed");
+}
+
+void test_work_deque_ends() {
+    static WorkDeque dq;
+    Task a{nullptr, nullptr}, b{nullptr, nullptr}, c{nullptr, nullptr};
+
+    TEST_ASSERT_TRUE(dq.push(&a) && dq.push(&b) && dq.push(&c), "pushes should succeed");
+    TEST_ASSERT_TRUE(dq.steal() == &a, "thieves should take the oldest task");
+    TEST_ASSERT_TRUE(dq.pop() == &c, "the owner should take the newest task");
+    TEST_ASSERT_TRUE(dq.pop() == &b, "the owner should drain the rest");
+    TEST_ASSERT_TRUE(dq.pop() == nullptr && dq.steal() == nullptr, "deque should be empty");
+    TEST_ASSERT_TRUE(dq.empty(), "empty() should agree");
+}
+
+static uint64_t pool_sum(uint64_t lo, uint64_t hi) {
+    if (hi - lo <= 64) {
+        uint64_t s = 0;
+        for (uint64_t i = lo; i < hi; i++) s += i;
+        return s;
+    }
+    uint64_t mid = lo + (hi - lo) / 2, left = 0;
+    TaskGroup g;
+    auto t = make_task([&left, lo, mid] { left = pool_sum(lo, mid); });
+    g.spawn(t);
+    uint64_t right = pool_sum(mid, hi);
+    g.sync();
+    return left + right;
+}
+
+void test_workpool_fork_join() {
+    WorkPool::start();
+    uint64_t sum = pool_sum(0, 10000);
+    WorkPool::stop();
+    TEST_ASSERT_EQUAL(49995000, (int)sum, "fork-join sum should match the closed form");
+}
+
+static void record_core(void* arg) {
+    uint32_t* seen = (uint32_t*)arg;
+    seen[this_core()] = this_core() + 1;
+}
+
+void test_ipi_call_single() {
+    uint32_t seen[CORE_COUNT] = {};
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        smp_call_function_single(core, record_core, seen);
+    }
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        TEST_ASSERT_EQUAL((int)core + 1, (int)seen[core], "call should run on its target core");
+    }
+}
+
+void test_ipi_call_all() {
+    uint32_t seen[CORE_COUNT] = {};
+    smp_call_function(record_core, seen);
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        int want = core == this_core() ? 0 : (int)core + 1;
+        TEST_ASSERT_EQUAL(want, (int)seen[core], "call should run on every other core only");
+    }
+}
+
+void test_tlb_shootdown() {
+    uint32_t other = (this_core() + 1) % CORE_COUNT;
+    uint64_t before = ipi_received(other, IpiType::TlbFlush);
+    smp_flush_tlb_all();
+    TEST_ASSERT_TRUE(ipi_received(other, IpiType::TlbFlush) > before,
+                     "other cores should have acknowledged the flush");
+}
+
+static CoTask<int> coro_add(int a, int b) {
+    co_return a + b;
+}
+
+static CoTask<int> coro_sum_to(int n) {
+    int sum = 0;
+    for (int i = 1; i <= n; i++) sum = co_await coro_add(sum, i);
+    co_return sum;
+}
+
+void test_coro_task_chain() {
+    TEST_ASSERT_EQUAL(5050, block_on(coro_sum_to(100)), "awaited tasks should hand back their values");
+}
+
+static CoTask<uint64_t> coro_nap(uint64_t counts) {
+    uint64_t start = timer_count();
+    co_await co_sleep_for(counts);
+    co_return timer_count() - start;
+}
+
+void test_coro_sleep() {
+    uint64_t ms = timer_frequency() / 1000;
+    uint64_t slept = block_on(coro_nap(2 * ms));
+    TEST_ASSERT_TRUE(slept >= 2 * ms, "a coroutine sleep should not end early");
+    TEST_ASSERT_TRUE(slept < 50 * ms, "a coroutine sleep should end");
+}
+
+struct CoroReceived {
+    volatile uint32_t sum = 0;
+    Atomic<bool> done{false};
+};
+
+static CoTask<void> coro_receive(AsyncChannel<uint32_t, 8>& ch, uint32_t n, CoroReceived& r) {
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < n; i++) sum += co_await ch.recv();
+    r.sum = sum;
+    r.done.store_release(true);
+}
+
+void test_coro_channel_cross_core() {
+    // Fresh for every core's run; the receiver has references to both
+    AsyncChannel<uint32_t, 8> ch;
+    CoroReceived r;
+    coro_spawn(coro_receive(ch, 1000, r), (this_core() + 1) % CORE_COUNT);
+
+    // The ring is much smaller than the message count, so the receiver
+    // keeps parking on an empty channel and being posted back
+    for (uint32_t i = 1; i <= 1000; i++) {
+        while (!ch.try_send(i)) cpu_relax();
+    }
+    uint64_t give_up = timer_count() + timer_frequency() / 10;
+    while (!r.done.load_acquire() && timer_count() < give_up) {
+    }
+    TEST_ASSERT_TRUE(r.done.load_acquire(), "the receiver should have seen every message");
+    // Late or not, it must be done with ch and r before they go away
+    while (!r.done.load_acquire()) cpu_relax();
+    TEST_ASSERT_EQUAL(500500, (int)r.sum, "messages should arrive intact");
+}
+
+static bool wait_tx_bytes(uint64_t want) {
+    uint64_t deadline = timer_count() + timer_frequency();
+    while (uart_stats().tx_bytes < want && timer_count() < deadline) cpu_relax();
+    return uart_stats().tx_bytes >= want;
+}
+
+static CoTask<void> uart_write_all(const char* buf, size_t len, Atomic<bool>& done) {
+    co_await co_uart_write(buf, len);
+    done.store_release(true);
+}
+
+void test_uart_ring_write() {
+    // Dots, and a CR LF every 64 bytes, as in bench_uart_write
+    static char burst[UART_TX_RING + UART_TX_RING / 2];
+    for (uint32_t i = 0; i < sizeof(burst); i++) {
+        burst[i] = i % 64 == 63 ? '\n' : i % 64 == 62 ? '\r' : '.';
+    }
+
+    // Queued while held; the release sends a FIFO's worth and leaves the
+    // rest to the TX interrupt
+    uint64_t len = 256;
+    UartStats before = uart_stats();
+    uart_tx_hold(true);
+    TEST_ASSERT_EQUAL((int)len, (int)uart_write(burst, len), "the write should fit in the ring");
+    TEST_ASSERT_TRUE(uart_stats().tx_pending >= len, "held, the bytes should wait in the ring");
+    uart_tx_hold(false);
+    TEST_ASSERT_TRUE(wait_tx_bytes(before.tx_bytes + len), "the ring should reach the FIFO");
+    TEST_ASSERT_TRUE(uart_stats().tx_irqs > before.tx_irqs, "the TX interrupt should drain the ring");
+
+    // More than the ring holds, written while held: the writer parks on the
+    // full ring and only the TX interrupt can post it once that has drained
+    // to half. Static, so a writer that outlives the test touches nothing dead.
+    static Atomic<bool> written{false};
+    written.store_release(false);
+    len = sizeof(burst);
+    before = uart_stats();
+    uart_tx_hold(true);
+    coro_spawn(uart_write_all(burst, len, written));
+    uint64_t give_up = timer_count() + timer_frequency() / 10;
+    while (uart_stats().tx_waits == before.tx_waits && timer_count() < give_up) yield();
+    UartStats parked = uart_stats();
+    uart_tx_hold(false);
+    TEST_ASSERT_TRUE(parked.tx_waits > before.tx_waits, "the writer should park on a full ring");
+
+    give_up = timer_count() + timer_frequency();
+    while (!written.load_acquire() && timer_count() < give_up) yield();
+    TEST_ASSERT_TRUE(written.load_acquire(), "the TX interrupt should post the parked writer");
+    UartStats after = uart_stats();
+    TEST_ASSERT_TRUE(after.tx_irqs > parked.tx_irqs, "the ring should drain through the interrupt");
+    TEST_ASSERT_TRUE(after.tx_bytes + UART_TX_RING >= before.tx_bytes + len,
+                     "the writer should not finish before the ring drained");
+    TEST_ASSERT_TRUE(wait_tx_bytes(before.tx_bytes + len), "all of it should reach the FIFO");
+}
+
+struct ContextProbe {
+    TimerEvent ev;  // must stay first, probe_context casts back from it
+    volatile bool fired;
+    volatile bool irqs_on;
+    volatile bool in_softirq;
+};
+
+static void probe_context(TimerEvent* ev) {
+    ContextProbe* p = (ContextProbe*)ev;
+    p->irqs_on = !Interrupts::isDisabled();
+    p->in_softirq = Interrupts::inInterrupt() && !Interrupts::inIRQ();
+    p->fired = true;
+}
+
+void test_timer_runs_in_softirq() {
+    ContextProbe p{{timer_count() + timer_frequency() / 1000, probe_context}, false, false, false};
+    timer_add(p.ev);
+
+    uint64_t give_up = timer_count() + timer_frequency() / 50;
+    while (!p.fired && timer_count() < give_up) {
+    }
+    TEST_ASSERT_TRUE(p.fired, "the timer should have fired");
+    TEST_ASSERT_TRUE(p.irqs_on, "timer callbacks should run with IRQs enabled");
+    TEST_ASSERT_TRUE(p.in_softirq, "timer callbacks should run as a softirq");
+}
+
+struct CountingTasklet {
+    Tasklet t;  // must stay first, count_runs casts back from it
+    volatile uint32_t runs;
+    uint32_t again;  // times to reschedule itself
+};
+
+static void count_runs(Tasklet* t) {
+    CountingTasklet* c = (CountingTasklet*)t;
+    c->runs = c->runs + 1;
+    if (c->again) {
+        c->again--;
+        tasklet_schedule(c->t);
+    }
+}
+
+static bool wait_runs(CountingTasklet& c, uint32_t want) {
+    // softirqd runs work raised from a thread, so let it in
+    uint64_t give_up = timer_count() + timer_frequency() / 5;
+    while (c.runs < want && timer_count() < give_up) yield();
+    return c.runs == want;
+}
+
+void test_tasklet_runs_once() {
+    CountingTasklet c{{count_runs}, 0, 0};
+    bool first = false, second = false;
+    // With IRQs masked nothing can run it in between
+    Interrupts::protect([&] {
+        first = tasklet_schedule(c.t);
+        second = tasklet_schedule(c.t);
+    });
+    TEST_ASSERT_TRUE(first, "an idle tasklet should queue");
+    TEST_ASSERT_TRUE(!second, "a queued tasklet should not queue twice");
+    TEST_ASSERT_TRUE(wait_runs(c, 1), "the tasklet should run exactly once");
+}
+
+void test_softirq_flood_is_budgeted() {
+    static constexpr uint32_t FLOOD = 200;
+    uint32_t core = this_core();
+    SoftirqStats before = softirq_stats(core);
+
+    // Every run raises the softirq again; no single pass may take them all
+    CountingTasklet c{{count_runs}, 0, FLOOD - 1};
+    tasklet_schedule(c.t);
+    TEST_ASSERT_TRUE(wait_runs(c, FLOOD), "every rescheduled run should happen");
+
+    SoftirqStats after = softirq_stats(core);
+    uint64_t passes = after.exit_passes + after.thread_passes - before.exit_passes -
+                      before.thread_passes;
+    TEST_ASSERT_TRUE(passes >= FLOOD / SOFTIRQ_MAX_ROUNDS, "the flood should be split into passes");
+}
+
+void test_parallel_memset_memcpy() {
+    // Big enough to be split, with ragged ends on both sides
+    static constexpr size_t N = 1024 * 1024 + 37;
+    uint8_t* a = (uint8_t*)kmalloc(N + 16);
+    uint8_t* b = (uint8_t*)kmalloc(N + 16);
+    TEST_ASSERT_TRUE(a && b, "kmalloc should provide the buffers");
+
+    a[0] = 0x11;
+    a[N + 6] = 0x22;
+    parallel_memset(a + 5, 0xA5, N);
+    bool filled = true;
+    for (size_t i = 5; i < N + 5; i++) filled = filled && a[i] == 0xA5;
+    TEST_ASSERT_TRUE(filled, "every byte of the range should be set");
+    TEST_ASSERT_TRUE(a[0] == 0x11 && a[N + 6] == 0x22, "bytes around the range should be untouched");
+
+    for (size_t i = 0; i < N; i++) a[i + 5] = (uint8_t)(i * 7 + (i >> 12));
+    parallel_memcpy(b + 3, a + 5, N);
+    bool copied = true;
+    for (size_t i = 0; i < N; i++) copied = copied && b[i + 3] == (uint8_t)(i * 7 + (i >> 12));
+    TEST_ASSERT_TRUE(copied, "a misaligned copy should match the source");
+    TEST_ASSERT_TRUE(b[2] == 0 && b[N + 3] == 0, "the copy should not spill over");
+
+    kfree(a);
+    kfree(b);
+}
+
+void test_parallel_algorithms() {
+    static constexpr uint32_t N = 20000;
+    // Small grain so every algorithm really splits
+    static constexpr PartitionPolicy POLICY = {512, 16};
+    uint32_t* a = new uint32_t[N];
+    uint32_t* b = new uint32_t[N];
+    uint32_t x = 1;
+    for (uint32_t i = 0; i < N; i++) {
+        x = x * 1103515245 + 12345;
+        a[i] = x >> 8;
+    }
+
+    WorkPool::start();
+    par::for_each(a, a + N, [](uint32_t& v) { v &= 0xffff; }, POLICY);
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < N; i++) sum += a[i];
+    auto add = [](uint64_t s, uint32_t v) { return s + v; };
+    uint64_t psum = par::reduce(a, a + N, (uint64_t)0, add, POLICY);
+
+    par::inclusive_scan(a, a + N, b, [](uint32_t s, uint32_t v) { return s + v; }, POLICY);
+    bool scanned = true;
+    uint32_t run = 0;
+    for (uint32_t i = 0; i < N; i++) {
+        run += a[i];
+        scanned = scanned && b[i] == run;
+    }
+
+    par::sort(a, a + N, POLICY);
+    WorkPool::stop();
+
+    bool sorted = true;
+    for (uint32_t i = 1; i < N; i++) sorted = sorted && a[i - 1] <= a[i];
+    TEST_ASSERT_TRUE(psum == sum, "parallel reduce should match the sequential sum");
+    TEST_ASSERT_TRUE(scanned, "parallel scan should match the running sum");
+    TEST_ASSERT_TRUE(sorted, "parallel sort should order the array");
+    TEST_ASSERT_TRUE(par::reduce(a, a + N, (uint64_t)0, add, PAR_SEQUENTIAL) == sum,
+                     "sorting should keep every element");
+
+    delete[] a;
+    delete[] b;
+}
+
+// Mailbox 2 is free; a core can raise it on itself
+static constexpr uint32_t TEST_MBOX = 2;
+static PerCPU<uint32_t> test_mbox_hits;
+
+static void test_mbox_irq(void* ctx) {
+    PerCPU<uint32_t>* hits = (PerCPU<uint32_t>*)ctx;
+    uint32_t me = this_core();
+    put32(CORE_MBOX_RDCLR(me, TEST_MBOX), get32(CORE_MBOX_RDCLR(me, TEST_MBOX)));
+    __atomic_add_fetch(&hits->mine(), 1, __ATOMIC_RELAXED);
+}
+
+void test_irq_request_dispatch() {
+    uint32_t irq = irq_local_mailbox(TEST_MBOX);
+    uint32_t me = this_core();
+    TEST_ASSERT_TRUE(request_irq(irq, test_mbox_irq, &test_mbox_hits), "a free IRQ should be granted");
+    TEST_ASSERT_TRUE(request_irq(irq, test_mbox_irq, &test_mbox_hits),
+                     "requesting the same handler again should succeed");
+    TEST_ASSERT_TRUE(!request_irq(irq, test_mbox_irq, nullptr), "a different ctx should be refused");
+    TEST_ASSERT_TRUE(!request_irq(IRQ_COUNT, test_mbox_irq, nullptr), "out of range should be refused");
+
+    uint64_t before = irq_count(irq, me);
+    uint32_t hits = __atomic_load_n(&test_mbox_hits.mine(), __ATOMIC_RELAXED);
+    enable_irq(irq);
+    put32(CORE_MBOX_SET(me, TEST_MBOX), 1);
+    uint64_t deadline = timer_count() + timer_frequency() / 10;
+    while (__atomic_load_n(&test_mbox_hits.mine(), __ATOMIC_RELAXED) == hits &&
+           timer_count() < deadline) {
+        cpu_relax();
+    }
+    disable_irq(irq);
+    free_irq(irq);
+
+    TEST_ASSERT_TRUE(__atomic_load_n(&test_mbox_hits.mine(), __ATOMIC_RELAXED) == hits + 1,
+                     "the handler should run once on this core");
+    TEST_ASSERT_TRUE(irq_count(irq, me) == before + 1, "the dispatch should be counted");
+    TEST_ASSERT_TRUE(!irq_set_affinity(irq, 0), "per-core sources can't be rerouted");
+}
+
+static PerCPU<IrqLatency> test_irqlat;
+
+void test_irq_latency() {
+    static PerCPU<LatencyHist> hists;
+    LatencyHist& h = hists.mine();
+    h.reset();
+    for (uint64_t v = 1; v <= 100; v++) h.add(v);
+    TEST_ASSERT_TRUE(h.count == 100 && h.min == 1 && h.max == 100, "count, min and max are exact");
+    TEST_ASSERT_TRUE(h.percentile(50) == 50, "percentiles below 64 counts are exact");
+    TEST_ASSERT_TRUE(h.percentile(99) >= 96 && h.percentile(99) <= 99,
+                     "percentiles above are within a bucket");
+    h.add(1ull << 40);
+    TEST_ASSERT_TRUE(h.percentile(100) == 1ull << 40, "out-of-range values still give the max");
+
+    IrqLatency& lat = test_irqlat.mine();
+    irq_latency_run(lat, 50);
+    const LatencyHist& entry = lat[IrqLatStage::Entry];
+    const LatencyHist& handler = lat[IrqLatStage::Handler];
+    const LatencyHist& resume = lat[IrqLatStage::Resume];
+    TEST_ASSERT_TRUE(entry.count == 50 && resume.count == 50, "every round should be recorded");
+    TEST_ASSERT_TRUE(entry.min <= handler.min && handler.min <= resume.min &&
+                         entry.max <= handler.max && handler.max <= resume.max,
+                     "the vector should come before the handler and the handler before resume");
+    TEST_ASSERT_TRUE(resume.max < timer_frequency() / 100, "no round should take 10ms");
+}
+
+void test_syscall_null() {
+    uint32_t core = this_core();
+    uint64_t before = syscall_stats(core, SYS_NULL).calls;
+    TEST_ASSERT_EQUAL(0, (int)syscall0(SYS_NULL), "the null syscall should return 0");
+    TEST_ASSERT_EQUAL(-ENOSYS, (int)syscall0(NR_SYSCALLS), "an unknown number should fail");
+    TEST_ASSERT_EQUAL(0, (int)syscall0_full_frame(SYS_NULL), "the full-frame path should agree");
+    TEST_ASSERT_TRUE(syscall_stats(core, SYS_NULL).calls == before + 1,
+                     "the lean path should count the call");
+
+    // Everything but x0 must survive, the lean path saves only part of it
+    register uint64_t x8 asm("x8") = SYS_NULL;
+    register uint64_t x0 asm("x0") = 0;
+    register uint64_t x9 asm("x9") = 9;
+    register uint64_t x12 asm("x12") = 12;
+    register uint64_t x15 asm("x15") = 15;
+    register uint64_t x18 asm("x18") = 18;
+    register uint64_t x19 asm("x19") = 19;
+    register uint64_t x28 asm("x28") = 28;
+    asm volatile("svc #0"
+                 : "+r"(x0), "+r"(x9), "+r"(x12), "+r"(x15), "+r"(x18), "+r"(x19), "+r"(x28)
+                 : "r"(x8)
+                 : "memory");
+    TEST_ASSERT_TRUE(x9 == 9 && x12 == 12 && x15 == 15 && x18 == 18 && x19 == 19 && x28 == 28,
+                     "registers should be preserved across a syscall");
+}
+
+// A minimal executable: one read-only text page at USER_VA_START + 0x1000,
+// and one page of data followed by a page of bss at USER_VA_START + 0x2000.
+// The data starts with 41 and then data1.
+struct alignas(4096) TestElf {
+    Elf64_Ehdr eh;
+    Elf64_Phdr ph[2];
+    alignas(4096) uint32_t text[1024];
+    alignas(4096) uint64_t data[512];
+};
+
+static constexpr uint64_t TEST_TEXT_VA = USER_VA_START + 0x1000;
+static constexpr uint64_t TEST_DATA_VA = USER_VA_START + 0x2000;
+
+template <uint32_t N>
+static constexpr TestElf make_test_elf(const uint32_t (&code)[N], uint64_t data1 = 0) {
+    TestElf e{};
+    e.eh.e_ident[0] = ELFMAG[0];
+    e.eh.e_ident[1] = ELFMAG[1];
+    e.eh.e_ident[2] = ELFMAG[2];
+    e.eh.e_ident[3] = ELFMAG[3];
+    e.eh.e_ident[4] = ELFCLASS64;
+    e.eh.e_ident[5] = ELFDATA2LSB;
+    e.eh.e_ident[6] = 1;  // EV_CURRENT
+    e.eh.e_type = ET_EXEC;
+    e.eh.e_machine = EM_AARCH64;
+    e.eh.e_version = 1;
+    e.eh.e_entry = TEST_TEXT_VA;
+    e.eh.e_phoff = __builtin_offsetof(TestElf, ph);
+    e.eh.e_ehsize = sizeof(Elf64_Ehdr);
+    e.eh.e_phentsize = sizeof(Elf64_Phdr);
+    e.eh.e_phnum = 2;
+    e.ph[0] = {PT_LOAD, PF_R | PF_X, __builtin_offsetof(TestElf, text), TEST_TEXT_VA,
+               TEST_TEXT_VA, sizeof(e.text), sizeof(e.text), 4096};
+    e.ph[1] = {PT_LOAD, PF_R | PF_W, __builtin_offsetof(TestElf, data), TEST_DATA_VA,
+               TEST_DATA_VA, sizeof(e.data), 2 * sizeof(e.data), 4096};
+    for (uint32_t i = 0; i < N; i++) e.text[i] = code[i];
+    e.data[0] = 41;
+    e.data[1] = data1;
+    return e;
+}
+
+// write(1, msg, 15); bumps data[0] and adds the first bss word; yield();
+// stores through a fresh mmap() page; clock_gettime(CLOCK_MONOTONIC) into
+// the stack; exit(42) if everything worked
+static constexpr uint32_t hello_code[] = {
+    0xd2800020, 0x10000521, 0xd28001e2, 0xd2800028,  // x0 = 1, x1 = msg, x2 = 15, x8 = SYS_WRITE
+    0xd4000001, 0xaa0003f3, 0x10007f49, 0xf940012a,  // svc; x19 = x0; x9 = data; x10 = [x9]
+    0x9100054a, 0xf900012a, 0xf948012b, 0x8b0b014a,  // x10++; [x9] = x10; x11 = bss; x10 += x11
+    0xd2800088, 0xd4000001, 0xd2800000, 0xd2820001,  // yield; x0 = 0, x1 = 4096
+    0xd2800062, 0xd2800443, 0x92800004, 0xd2800005,  // x2 = RW, x3 = PRIVATE|ANON, x4 = -1, x5 = 0
+    0xd2800068, 0xd4000001, 0xd28000ec, 0xf900000c,  // mmap; [x0] = 7
+    0xf940000d, 0x8b0d014a, 0xd1001d4a, 0xd10043ff,  // x10 += [x0] - 7; sp -= 16
+    0xd2800020, 0x910003e1, 0xd28000a8, 0xd4000001,  // clock_gettime(1, sp)
+    0x910043ff, 0x8b00014a, 0xf1003e7f, 0x54000081,  // sp += 16; x10 += x0; if x19 != 15 exit(1)
+    0xaa0a03e0, 0xd2800048, 0xd4000001, 0xd2800020,  // exit(x10)
+    0xd2800048, 0xd4000001,                          // exit(1)
+    0x6c6c6568, 0x7266206f, 0x45206d6f, 0x000a304c,  // "hello from EL0\n"
+};
+
+// Stores to its own (read-only) text
+static constexpr uint32_t fault_code[] = {
+    0x10000000, 0xf900001f, 0xd2800000, 0xd2800048, 0xd4000001,
+};
+
+static const TestElf hello_elf = make_test_elf(hello_code);
+static const TestElf fault_elf = make_test_elf(fault_code);
+
+void test_process_elf() {
+    Process* p = process_create("hello", &hello_elf, sizeof(hello_elf));
+    TEST_ASSERT_NOT_NULL(p, "a valid image should load");
+    TEST_ASSERT_EQUAL(1, (int)p->pages_shared, "the text page should come straight from the image");
+    TEST_ASSERT_EQUAL(2, (int)p->pages_copied, "data and bss should get their own pages");
+    TEST_ASSERT_EQUAL(42, process_wait(p), "every syscall should have worked from EL0");
+    TEST_ASSERT_TRUE(hello_elf.data[0] == 41, "stores to data should not reach the image");
+
+    p = process_create("fault", &fault_elf, sizeof(fault_elf));
+    TEST_ASSERT_NOT_NULL(p, "the faulting image should load");
+    TEST_ASSERT_EQUAL(-EFAULT, process_wait(p), "a store to text should kill the process");
+
+    TEST_ASSERT_NULL(process_create("bad", hello_elf.text, sizeof(hello_elf.text)),
+                     "something that isn't ELF should be rejected");
+    TEST_ASSERT_EQUAL(-EPERM, (int)syscall6(SYS_EXIT, 0, 0, 0, 0, 0, 0),
+                      "kernel threads can't exit through the syscall");
+}
+
+// Puts "uaccess\n" in the last 8 bytes of bss and writes 16 bytes from
+// there (8 of them, then the unmapped page after bss); writes from a kernel
+// address; clock_gettime() into its text and across the end of bss. The
+// last of those must leave tv_sec in the 8 bytes before the fault: it is
+// compared with a second clock_gettime() onto the stack. exit(0) if the
+// writes gave 8 and -EFAULT, the copies -EFAULT twice and tv_sec matched.
+static constexpr uint32_t uaccess_code[] = {
+    0x10017fc9, 0xd28c2eaa, 0xf2ac6c6a, 0xf2ce6caa,  // x9 = bss end - 8; x10 = "uaccess\n"
+    0xf2e14e6a, 0xf900012a, 0xd2800020, 0xaa0903e1,  // [x9] = x10; write(1, x9, 16)
+    0xd2800202, 0xd2800028, 0xd4000001, 0xd1002013,  //   x19 = x0 - 8
+    0xd2800020, 0xd2ffffe1, 0xf2a00101, 0xd2800102,  // write(1, 0xffff000000080000, 8)
+    0xd2800028, 0xd4000001, 0x91003814, 0xd2800020,  //   x20 = x0 + EFAULT
+    0x10fffd81, 0xd28000a8, 0xd4000001, 0x91003815,  // clock_gettime(1, text); x21 = x0 + EFAULT
+    0xd2800020, 0xaa0903e1, 0xd28000a8, 0xd4000001,  // clock_gettime(1, x9)
+    0x91003816, 0xd10043ff, 0xd2800020, 0x910003e1,  //   x22 = x0 + EFAULT; clock_gettime(1, sp)
+    0xd28000a8, 0xd4000001, 0xf94003eb, 0x910043ff,  //   x11 = tv_sec
+    0xf940012a, 0xcb0a016a, 0xf100055f, 0x9a9f97f7,  // x23 = x11 - [x9] > 1
+    0xaa140260, 0xaa150000, 0xaa160000, 0xaa170000,  // x0 = x19-x23 ORed
+    0xd2800048, 0xd4000001,                          // exit(x0)
+};
+
+static const TestElf uaccess_elf = make_test_elf(uaccess_code);
+
+// Puts the counter in TPIDR_EL0, yields 8 times; exit(0) if it is still there
+static constexpr uint32_t tls_code[] = {
+    0xd53be053, 0xd51bd053, 0xd2800114,  // x19 = cntvct_el0; tpidr_el0 = x19; x20 = 8
+    0xd2800088, 0xd4000001, 0xf1000694,  // yield; x20--
+    0x54ffffa1, 0xd53bd040, 0xeb13001f,  //   until 0; x0 = tpidr_el0 != x19
+    0x9a9f07e0, 0xd2800048, 0xd4000001,  // exit(x0)
+};
+
+static const TestElf tls_elf = make_test_elf(tls_code);
+
+void test_user_copy() {
+    // Kernel threads pass kernel pointers straight through
+    uint64_t src[5] = {1, 2, 3, 4, 5}, dst[5] = {};
+    TEST_ASSERT_EQUAL(0, (int)copy_from_user(dst, src, sizeof(src)), "a valid copy should finish");
+    TEST_ASSERT_TRUE(dst[0] == 1 && dst[4] == 5, "the copy should have the source's bytes");
+    TEST_ASSERT_EQUAL(0, (int)copy_to_user((uint8_t*)dst + 1, src, 7), "misaligned copies work");
+    TEST_ASSERT_TRUE(dst[0] == 0x101, "the byte copy should land one byte in");
+    TEST_ASSERT_EQUAL(-EFAULT, probe_write((void*)0x10, src, 8), "page 0 should not be writable");
+
+    Process* p = process_create("uaccess", &uaccess_elf, sizeof(uaccess_elf));
+    TEST_ASSERT_NOT_NULL(p, "the image should load");
+    TEST_ASSERT_EQUAL(0, process_wait(p), "faulting copies should report what they copied");
+}
+
+void test_process_tls() {
+    // Both on this core, so each runs between the other's yields
+    Process* a = process_create("tls_a", &tls_elf, sizeof(tls_elf));
+    Process* b = process_create("tls_b", &tls_elf, sizeof(tls_elf));
+    TEST_ASSERT_TRUE(a && b, "the images should load");
+    TEST_ASSERT_EQUAL(0, process_wait(a), "TPIDR_EL0 should survive a switch to another process");
+    TEST_ASSERT_EQUAL(0, process_wait(b), "TPIDR_EL0 should survive a switch to another process");
+}
+
+// Reads the counter frequency from USER_TIME_PAGE, whose address is the
+// second data word, and the virtual counter itself; exit(page freq -
+// cntfrq_el0)
+static constexpr uint32_t time_code[] = {
+    0x58008049, 0xf9400520, 0xd53be001,  // x9 = USER_TIME_PAGE; x0 = freq
+    0xcb010000, 0xd53be042, 0xd2800048,  // x0 -= cntfrq_el0; mrs cntvct_el0
+    0xd4000001,                          // exit(x0)
+};
+
+static_assert(__builtin_offsetof(TimePage, freq) == 8, "time_code loads freq from offset 8");
+
+static const TestElf time_elf = make_test_elf(time_code, USER_TIME_PAGE);
+
+static int64_t timespec_ns(const Timespec& ts) {
+    return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void test_time_page() {
+    const TimePage* tp = time_page();
+    Timespec a, b, c;
+    TEST_ASSERT_TRUE(time_page_gettime(tp, CLOCK_MONOTONIC, &a), "the page should be readable");
+    TEST_ASSERT_EQUAL(0, (int)syscall6(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (uint64_t)&b, 0, 0, 0, 0),
+                      "the syscall should succeed");
+    time_page_gettime(tp, CLOCK_MONOTONIC, &c);
+    uint64_t raw[3];  // any writable destination will do, aligned or not
+    TEST_ASSERT_EQUAL(0, (int)syscall6(SYS_CLOCK_GETTIME, CLOCK_MONOTONIC, (uint64_t)raw + 1, 0, 0, 0, 0),
+                      "a misaligned timespec should be written");
+    TEST_ASSERT_TRUE(timespec_ns(a) <= timespec_ns(b) && timespec_ns(b) <= timespec_ns(c),
+                     "the page and the syscall should read one monotonic clock");
+    TEST_ASSERT_FALSE(time_page_gettime(tp, 7, &a), "unknown clocks should be rejected");
+
+    // A rate change rebases, so the clock carries on from where it was
+    timekeeping_adjust(2000000000);
+    TEST_ASSERT_TRUE(tp->adjust_ppb == 500000, "the adjustment should be clamped to 500ppm");
+    time_page_gettime(tp, CLOCK_MONOTONIC, &a);
+    timekeeping_adjust(0);
+    time_page_gettime(tp, CLOCK_MONOTONIC, &b);
+    TEST_ASSERT_TRUE(timespec_ns(c) <= timespec_ns(a) && timespec_ns(a) <= timespec_ns(b),
+                     "adjusting should not step the clock");
+
+    timekeeping_set_realtime(1700000000ll * 1000000000);
+    time_page_gettime(tp, CLOCK_REALTIME, &a);
+    TEST_ASSERT_TRUE(a.tv_sec >= 1700000000 && a.tv_sec < 1700000010,
+                     "CLOCK_REALTIME should follow the value it was set to");
+
+    Process* p = process_create("time", &time_elf, sizeof(time_elf));
+    TEST_ASSERT_NOT_NULL(p, "the time image should load");
+    TEST_ASSERT_EQUAL(0, process_wait(p), "EL0 should read the page and the counter");
+}
 
 void register_all_tests() {
     if(tests_registered) return;
@@ -507,9 +1706,9 @@ void register_all_tests() {
     // MANUAL_REGISTER_TEST(test_stack_isolation);
     
     // Multi-core memory protection tests (the main event!)
-    // MANUAL_REGISTER_TEST(test_null_pointer_protection);
-    // MANUAL_REGISTER_TEST(test_low_memory_protection);
-    // MANUAL_REGISTER_TEST(test_memory_protection_boundaries);
+    MANUAL_REGISTER_TEST(test_null_pointer_protection);
+    MANUAL_REGISTER_TEST(test_low_memory_protection);
+    MANUAL_REGISTER_TEST(test_memory_protection_boundaries);
     
     // // Heap allocator tests
     // MANUAL_REGISTER_TEST(test_heap_basic_allocation);
@@ -524,8 +1723,93 @@ void register_all_tests() {
     // MANUAL_REGISTER_TEST(test_cpp_new_delete);
     // MANUAL_REGISTER_TEST(test_cpp_alignment);
 
+    // Interrupt-safe locking tests
+    MANUAL_REGISTER_TEST(test_interrupts_protect);
+    MANUAL_REGISTER_TEST(test_interrupt_safe_lock);
+
+    // RCU tests
+    MANUAL_REGISTER_TEST(test_rcu_synchronize);
+    MANUAL_REGISTER_TEST(test_rcu_call_rcu_deferred);
+    MANUAL_REGISTER_TEST(test_rcu_callbacks_run_unprompted);
+
+    // Barrier tests
+    MANUAL_REGISTER_TEST(test_sense_barrier_reuse);
+    MANUAL_REGISTER_TEST(test_tree_barrier_reuse);
+
     // Queue tests
     MANUAL_REGISTER_TEST(test_queue_basic_enq_deq);
     MANUAL_REGISTER_TEST(test_queue_wraparound);
     MANUAL_REGISTER_TEST(test_queue_fill_and_drain);
+    MANUAL_REGISTER_TEST(test_queue_generic_type);
+    MANUAL_REGISTER_TEST(test_mpmc_ring_basic);
+    MANUAL_REGISTER_TEST(test_mpmc_ring_bulk);
+
+    // Inter-core channel tests
+    MANUAL_REGISTER_TEST(test_spsc_channel_basic);
+    MANUAL_REGISTER_TEST(test_core_channel_mesh);
+
+    // Per-CPU storage tests
+    MANUAL_REGISTER_TEST(test_percpu_layout);
+    MANUAL_REGISTER_TEST(test_percpu_counter);
+
+    // Blocking primitive tests
+    MANUAL_REGISTER_TEST(test_wait_queue_wake);
+    MANUAL_REGISTER_TEST(test_futex_value_changed);
+    MANUAL_REGISTER_TEST(test_mutex_basic);
+    MANUAL_REGISTER_TEST(test_semaphore_counting);
+    MANUAL_REGISTER_TEST(test_condvar_predicate);
+
+    // Scheduler tests
+    MANUAL_REGISTER_TEST(test_thread_runs_and_exits);
+    MANUAL_REGISTER_TEST(test_thread_blocks_and_wakes);
+    MANUAL_REGISTER_TEST(test_fpsimd_lazy_switch);
+    MANUAL_REGISTER_TEST(test_preempt_count);
+    MANUAL_REGISTER_TEST(test_timer_tick_running);
+    MANUAL_REGISTER_TEST(test_tick_stops_when_alone);
+    MANUAL_REGISTER_TEST(test_sleep_until);
+
+    // Timer wheel tests
+    MANUAL_REGISTER_TEST(test_timer_wheel_cascade);
+    MANUAL_REGISTER_TEST(test_timer_event_fires);
+    MANUAL_REGISTER_TEST(test_timer_cancel_remote);
+    MANUAL_REGISTER_TEST(test_timer_cancel_in_batch);
+
+    // Work-stealing pool tests
+    MANUAL_REGISTER_TEST(test_work_deque_ends);
+    MANUAL_REGISTER_TEST(test_workpool_fork_join);
+
+    // Inter-processor interrupt tests
+    MANUAL_REGISTER_TEST(test_ipi_call_single);
+    MANUAL_REGISTER_TEST(test_ipi_call_all);
+    MANUAL_REGISTER_TEST(test_tlb_shootdown);
+
+    // Coroutine tests
+    MANUAL_REGISTER_TEST(test_coro_task_chain);
+    MANUAL_REGISTER_TEST(test_coro_sleep);
+    MANUAL_REGISTER_TEST(test_coro_channel_cross_core);
+    MANUAL_REGISTER_TEST(test_uart_ring_write);
+
+    // Softirq tests
+    MANUAL_REGISTER_TEST(test_timer_runs_in_softirq);
+    MANUAL_REGISTER_TEST(test_tasklet_runs_once);
+    MANUAL_REGISTER_TEST(test_softirq_flood_is_budgeted);
+
+    // Bulk memory tests
+    MANUAL_REGISTER_TEST(test_parallel_memset_memcpy);
+
+    // Parallel algorithm tests
+    MANUAL_REGISTER_TEST(test_parallel_algorithms);
+
+    // Interrupt controller tests
+    MANUAL_REGISTER_TEST(test_irq_request_dispatch);
+    MANUAL_REGISTER_TEST(test_irq_latency);
+
+    // Syscall tests
+    MANUAL_REGISTER_TEST(test_syscall_null);
+
+    // Process tests
+    MANUAL_REGISTER_TEST(test_process_elf);
+    MANUAL_REGISTER_TEST(test_time_page);
+    MANUAL_REGISTER_TEST(test_user_copy);
+    MANUAL_REGISTER_TEST(test_process_tls);
 } 
\ No newline at end of file
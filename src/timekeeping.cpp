@@ -0,0 +1,69 @@
+#include "timekeeping.h"
+#include "atomic.h"
+#include "timer.h"
+
+static TimePage page;
+static InterruptSafeLock time_lock("time");
+
+static constexpr int64_t MAX_ADJUST_PPB = 500000;
+
+// Nominal ns per count in 32.32, scaled by the adjustment. Stays in 64 bits
+// (no 128-bit division without libgcc): nominal is below 2^42 for any
+// counter over 1MHz, and |ppb| is below 2^19.
+static uint64_t scaled_mult(uint64_t freq, int64_t ppb) {
+    uint64_t nominal = (1000000000ull << 32) / freq;
+    return nominal + (uint64_t)((int64_t)nominal * ppb / 1000000000);
+}
+
+// Writer side of the sequence count; callers hold time_lock
+static void update_begin() {
+    __atomic_store_n(&page.seq, page.seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void update_end() {
+    __atomic_store_n(&page.seq, page.seq + 1, __ATOMIC_RELEASE);
+}
+
+// Move the base to now so a new rate only applies from here on
+static void rebase() {
+    uint64_t count = timer_count();
+    uint64_t elapsed = (uint64_t)(((unsigned __int128)(count - page.base_count) * page.mult) >> 32);
+    __atomic_store_n(&page.base_ns, page.base_ns + elapsed, __ATOMIC_RELAXED);
+    __atomic_store_n(&page.base_count, count, __ATOMIC_RELAXED);
+}
+
+void timekeeping_init() {
+    LockGuard<InterruptSafeLock> g(time_lock);
+    update_begin();
+    page.freq = timer_frequency();
+    page.base_count = timer_count();
+    page.base_ns = 0;
+    page.mult = scaled_mult(page.freq, 0);
+    page.realtime_offset = 0;
+    page.adjust_ppb = 0;
+    update_end();
+}
+
+const TimePage* time_page() {
+    return &page;
+}
+
+void timekeeping_adjust(int64_t ppb) {
+    if (ppb > MAX_ADJUST_PPB) ppb = MAX_ADJUST_PPB;
+    if (ppb < -MAX_ADJUST_PPB) ppb = -MAX_ADJUST_PPB;
+    LockGuard<InterruptSafeLock> g(time_lock);
+    update_begin();
+    rebase();
+    __atomic_store_n(&page.mult, scaled_mult(page.freq, ppb), __ATOMIC_RELAXED);
+    page.adjust_ppb = ppb;
+    update_end();
+}
+
+void timekeeping_set_realtime(int64_t ns) {
+    LockGuard<InterruptSafeLock> g(time_lock);
+    update_begin();
+    rebase();
+    __atomic_store_n(&page.realtime_offset, ns - (int64_t)page.base_ns, __ATOMIC_RELAXED);
+    update_end();
+}
@@ -0,0 +1,246 @@
+#include "timer.h"
+#include "atomic.h"
+#include "irq.h"
+#include "percpu.h"
+#include "sched.h"
+#include "softirq.h"
+#include "utils.h"
+
+static constexpr uint64_t NEVER = ~0ull;
+
+static constexpr uint64_t CNTV_CTL_ENABLE = 1 << 0;
+
+struct TimerCpu {
+    // The tick is owned by this core and only touched with IRQs masked
+    bool tick_on = false;
+    uint64_t next_tick = 0;
+
+    // The wheel can be cancelled from any core, so it has its own lock
+    ISL lock{"timer_wheel"};
+    TimerWheel wheel;
+    uint64_t armed = NEVER;    // compare value the timer is running with
+    TimerEvent* expired = nullptr;  // taken off the wheel, waiting for the softirq
+    uint32_t expired_count = 0;
+    TimerEvent* running = nullptr;  // rest of the batch the softirq is running
+    uint32_t expire_seq = 0;   // odd from expiry until the callbacks have run
+    TimerStats stats = {};
+};
+
+static uint64_t tick_interval;  // timer counts per tick, same on every core
+static PerCPU<TimerCpu> timers;
+static PerCPU<TickStats> tick_stats;
+
+static inline void write_cval(uint64_t cval) {
+    asm volatile("msr cntv_cval_el0, %0" ::"r"(cval));
+}
+
+static inline void write_ctl(uint64_t ctl) {
+    asm volatile("msr cntv_ctl_el0, %0\n\tisb" ::"r"(ctl));
+}
+
+static void timer_softirq();
+
+static inline uint64_t to_granules(uint64_t count) {
+    return (count + (1ull << TIMER_GRANULE_SHIFT) - 1) >> TIMER_GRANULE_SHIFT;
+}
+
+// Arm the timer for whichever comes first, the tick or the wheel's next
+// expiry or cascade. Called on the owning core with the wheel locked.
+static void reprogram(TimerCpu& t) {
+    uint64_t next = t.tick_on ? t.next_tick : NEVER;
+    uint64_t wheel = t.wheel.next_pending();
+    if (wheel != TimerWheel::NEVER && (wheel << TIMER_GRANULE_SHIFT) < next) {
+        next = wheel << TIMER_GRANULE_SHIFT;
+    }
+
+    t.armed = next;
+    if (next == NEVER) {
+        write_ctl(0);
+        return;
+    }
+    // A deadline already in the past fires as soon as the timer is enabled
+    write_cval(next);
+    write_ctl(CNTV_CTL_ENABLE);
+}
+
+static void timer_irq(void*);
+
+void timer_tick_init(uint32_t hz) {
+    tick_interval = timer_frequency() / hz;
+    open_softirq(SoftirqType::Timer, timer_softirq);
+
+    TimerCpu& t = timers.mine();
+    uint64_t daif = t.lock.lock();
+    uint64_t now = timer_count();
+    t.wheel.init(now >> TIMER_GRANULE_SHIFT);
+    t.tick_on = true;
+    t.next_tick = now + tick_interval;
+    reprogram(t);
+    t.lock.unlock(daif);
+    request_irq(IRQ_LOCAL_CNTV, timer_irq, nullptr);
+    enable_irq(IRQ_LOCAL_CNTV);
+}
+
+void timer_tick_enable(bool on) {
+    TimerCpu& t = timers.mine();
+    if (on == t.tick_on) return;
+
+    uint64_t daif = t.lock.lock();
+    t.tick_on = on;
+    if (on) t.next_tick = timer_count() + tick_interval;
+    reprogram(t);
+    t.lock.unlock(daif);
+}
+
+void timer_add(TimerEvent& ev) {
+    TimerCpu& t = timers.mine();
+    uint64_t daif = t.lock.lock();
+    ev.core = this_core();
+    t.wheel.add(ev, to_granules(ev.deadline));
+    if ((ev.expires << TIMER_GRANULE_SHIFT) < t.armed) reprogram(t);
+    t.lock.unlock(daif);
+}
+
+// Unlink ev from a list of expired events; false if it is not on it
+static bool unlink_expired(TimerEvent** p, TimerEvent& ev) {
+    for (; *p; p = &(*p)->next) {
+        if (*p == &ev) {
+            *p = ev.next;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool timer_cancel(TimerEvent& ev) {
+    uint32_t core = ev.core;
+    TimerCpu& t = timers.forCPU(core);
+
+    // Leaves the hardware alone: an IRQ for a cancelled event finds nothing
+    // due and re-arms for what is left
+    uint64_t daif = t.lock.lock();
+    bool removed = t.wheel.remove(ev);
+    if (!removed && unlink_expired(&t.expired, ev)) {
+        // Expired, but the softirq has not taken it yet
+        t.expired_count--;
+        removed = true;
+    }
+    if (!removed) {
+        // In the batch the softirq is running, but not reached yet
+        removed = unlink_expired(&t.running, ev);
+    }
+    uint32_t seq = t.expire_seq;
+    t.lock.unlock(daif);
+
+    // Otherwise ev's callback may be running right now. On its own core we
+    // can only be inside that batch (a callback cancelling): the softirq runs
+    // with preemption disabled. From interrupt context on another core,
+    // waiting could deadlock with a callback there cancelling one of ours.
+    // So wait only from a thread on another core.
+    if (!removed && (seq & 1) && core != this_core() && !Interrupts::inInterrupt()) {
+        while (__atomic_load_n(&t.expire_seq, __ATOMIC_ACQUIRE) == seq) {
+            cpu_relax();
+        }
+    }
+    return removed;
+}
+
+static void run_tick(TimerCpu& t, uint64_t now) {
+    // Advance from the previous deadline so ticks don't drift with IRQ
+    // latency; skip missed ones rather than firing them back to back
+    t.next_tick += tick_interval;
+    if (t.next_tick <= now) t.next_tick = now + tick_interval;
+
+    // The scheduler stops the tick once nothing is waiting to run
+    t.tick_on = sched_tick();
+
+    uint64_t spent = timer_count() - now;
+    TickStats& s = tick_stats.mine();
+    s.ticks++;
+    s.cycles_total += spent;
+    if (spent > s.cycles_max) s.cycles_max = spent;
+}
+
+// Take everything due off the wheel for the softirq, keeping the IRQ short
+static void collect_expired(TimerCpu& t, uint64_t now) {
+    uint32_t count;
+    TimerEvent* batch = t.wheel.advance(now >> TIMER_GRANULE_SHIFT, count);
+    if (!batch) return;
+
+    if (!(t.expire_seq & 1)) t.expire_seq++;
+    TimerEvent** tail = &t.expired;
+    while (*tail) tail = &(*tail)->next;
+    *tail = batch;
+    t.expired_count += count;
+    raise_softirq(SoftirqType::Timer);
+}
+
+static void timer_softirq() {
+    TimerCpu& t = timers.mine();
+    uint64_t start = timer_count();
+    uint64_t daif = t.lock.lock();
+    t.running = t.expired;
+    t.expired = nullptr;
+    t.expired_count = 0;
+    t.lock.unlock(daif);
+    if (!t.running) return;
+
+    // One event off the batch at a time, so a cancel can still take out the
+    // ones not reached yet
+    uint32_t count = 0;
+    while (true) {
+        daif = t.lock.lock();
+        TimerEvent* ev = t.running;
+        if (ev) t.running = ev->next;
+        t.lock.unlock(daif);
+        if (!ev) break;
+        // fn may free or requeue ev
+        ev->fn(ev);
+        count++;
+    }
+
+    // More may have expired meanwhile; the batch stays open until they ran
+    daif = t.lock.lock();
+    if (!t.expired) __atomic_add_fetch(&t.expire_seq, 1, __ATOMIC_RELEASE);
+    t.lock.unlock(daif);
+
+    TimerStats& s = t.stats;
+    s.batches++;
+    s.expired += count;
+    if (count > s.batch_max) s.batch_max = count;
+    s.cycles_total += timer_count() - start;
+}
+
+// CNTV IRQ: runs the tick, hands expired events to the timer softirq, then
+// programs the next deadline
+static void timer_irq(void*) {
+    TimerCpu& t = timers.mine();
+    uint64_t now = timer_count();
+
+    if (t.tick_on && t.next_tick <= now) run_tick(t, now);
+
+    uint64_t daif = t.lock.lock();
+    collect_expired(t, now);
+    reprogram(t);
+    t.lock.unlock(daif);
+}
+
+TickStats timer_tick_stats(uint32_t core) {
+    return tick_stats.forCPU(core);
+}
+
+void timer_tick_stats_reset() {
+    Interrupts::protect([] { tick_stats.mine() = TickStats{0, 0, 0}; });
+}
+
+TimerStats timer_stats(uint32_t core) {
+    return timers.forCPU(core).stats;
+}
+
+void timer_stats_reset() {
+    Interrupts::protect([] { timers.mine().stats = TimerStats{0, 0, 0, 0}; });
+}
+
+uint64_t timer_active(uint32_t core) {
+    return timers.forCPU(core).wheel.size();
+}
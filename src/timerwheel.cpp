@@ -0,0 +1,128 @@
+#include "timerwheel.h"
+
+static constexpr uint64_t SLOT_MASK = TimerWheel::SLOTS - 1;
+
+static inline uint64_t ror64(uint64_t x, uint32_t n) {
+    return n ? (x >> n) | (x << (64 - n)) : x;
+}
+
+void TimerWheel::place(TimerEvent& ev) {
+    uint64_t e = ev.expires < clk ? clk : ev.expires;  // overdue: next step
+    uint64_t delta = e - clk;
+    if (delta > MAX_DELTA) {
+        e = clk + MAX_DELTA;
+        delta = MAX_DELTA;
+    }
+
+    uint32_t level = 0;
+    while (level < LEVELS - 1 && delta >= (1ull << (SLOT_BITS * (level + 1)))) level++;
+    uint32_t slot = (e >> (SLOT_BITS * level)) & SLOT_MASK;
+
+    TimerEvent** head = &slots[level][slot];
+    ev.next = *head;
+    if (ev.next) ev.next->pprev = &ev.next;
+    ev.pprev = head;
+    *head = &ev;
+    ev.bucket = level * SLOTS + slot;
+    pending[level] |= 1ull << slot;
+}
+
+void TimerWheel::add(TimerEvent& ev, uint64_t expires) {
+    ev.expires = expires;
+    place(ev);
+    active++;
+}
+
+bool TimerWheel::remove(TimerEvent& ev) {
+    if (!ev.pprev) return false;
+    *ev.pprev = ev.next;
+    if (ev.next) ev.next->pprev = ev.pprev;
+
+    uint32_t level = ev.bucket / SLOTS;
+    uint32_t slot = ev.bucket % SLOTS;
+    if (!slots[level][slot]) pending[level] &= ~(1ull << slot);
+
+    ev.next = nullptr;
+    ev.pprev = nullptr;
+    active--;
+    return true;
+}
+
+void TimerWheel::cascade(uint32_t level, uint32_t slot) {
+    TimerEvent* list = slots[level][slot];
+    if (!list) return;
+    slots[level][slot] = nullptr;
+    pending[level] &= ~(1ull << slot);
+
+    while (list) {
+        TimerEvent* next = list->next;
+        place(*list);
+        cascaded++;
+        list = next;
+    }
+}
+
+// Process granule clk: cascade the upper slots whose boundary it is, then
+// expire level 0
+void TimerWheel::step(TimerEvent**& tail, uint32_t& count) {
+    uint32_t idx = clk & SLOT_MASK;
+    if (idx == 0) {
+        for (uint32_t level = 1; level < LEVELS; level++) {
+            uint32_t slot = (clk >> (SLOT_BITS * level)) & SLOT_MASK;
+            cascade(level, slot);
+            if (slot != 0) break;
+        }
+    }
+
+    TimerEvent* list = slots[0][idx];
+    if (list) {
+        slots[0][idx] = nullptr;
+        pending[0] &= ~(1ull << idx);
+        for (TimerEvent* ev = list; ev; ev = ev->next) {
+            ev->pprev = nullptr;
+            count++;
+            active--;
+            *tail = ev;
+            tail = &ev->next;
+        }
+        *tail = nullptr;
+    }
+    clk++;
+}
+
+uint64_t TimerWheel::next_pending() {
+    uint64_t best = NEVER;
+
+    // Level 0 slots expire at their own granule
+    if (pending[0]) {
+        uint64_t r = ror64(pending[0], clk & SLOT_MASK);
+        if (r) best = clk + __builtin_ctzll(r);
+    }
+
+    // Upper slots only need attention at the boundary where they cascade
+    for (uint32_t level = 1; level < LEVELS; level++) {
+        if (!pending[level]) continue;
+        uint32_t shift = SLOT_BITS * level;
+        uint64_t boundary = ((clk + (1ull << shift) - 1) >> shift) << shift;
+        uint64_t r = ror64(pending[level], (boundary >> shift) & SLOT_MASK);
+        uint64_t at = boundary + ((uint64_t)__builtin_ctzll(r) << shift);
+        if (at < best) best = at;
+    }
+    return best;
+}
+
+TimerEvent* TimerWheel::advance(uint64_t now, uint32_t& count) {
+    TimerEvent* expired = nullptr;
+    TimerEvent** tail = &expired;
+    count = 0;
+
+    while (true) {
+        uint64_t next = next_pending();
+        if (next > now) break;
+        clk = next;
+        step(tail, count);
+    }
+    // Nothing is due in between, so the granules up to now can be skipped
+    if (clk <= now) clk = now + 1;
+    return expired;
+}
@@ -1,4 +1,7 @@
 #include "uart.h"
+#include "atomic.h"
+#include "coro.h"
+#include "irq.h"
 #include "utils.h"
 #include "vm.h"
 #include "peripherals/base.h"
@@ -15,9 +18,54 @@
 #define UART0_FBRD      ((volatile unsigned int*)(UART0_BASE + 0x28))
 #define UART0_LCRH      ((volatile unsigned int*)(UART0_BASE + 0x2C))
 #define UART0_CR        ((volatile unsigned int*)(UART0_BASE + 0x30))
+#define UART0_IFLS      ((volatile unsigned int*)(UART0_BASE + 0x34))
 #define UART0_IMSC      ((volatile unsigned int*)(UART0_BASE + 0x38))
+#define UART0_MIS       ((volatile unsigned int*)(UART0_BASE + 0x40))
 #define UART0_ICR       ((volatile unsigned int*)(UART0_BASE + 0x44))
 
+// UART0_FR
+#define FR_RXFE         (1 << 4)
+#define FR_TXFF         (1 << 5)
+
+// UART0_IMSC/MIS/ICR
+#define INT_RX          (1 << 4)
+#define INT_TX          (1 << 5)
+#define INT_RT          (1 << 6)    // receive timeout: data sat below the RX level
+#define INT_ALL         0x7FF
+
+// PL011 transmit FIFO depth
+#define TX_FIFO_DEPTH   16
+
+// UART0_IFLS: TX interrupt at 1/8 full, RX at 1/2
+#define IFLS_TX_1_8     (0 << 0)
+#define IFLS_RX_1_2     (2 << 3)
+
+// Byte ring; head and tail run freely, so head - tail is the fill level.
+// Only used as a zero-initialized static.
+template <uint32_t N>
+struct ByteRing {
+    static_assert((N & (N - 1)) == 0, "ring size must be a power of two");
+    uint32_t head;
+    uint32_t tail;
+    char buf[N];
+
+    uint32_t used() const { return head - tail; }
+    bool empty() const { return head == tail; }
+    bool full() const { return used() == N; }
+    void push(char c) { buf[head++ % N] = c; }
+    char pop() { return buf[tail++ % N]; }
+};
+
+static ByteRing<UART_TX_RING> tx_ring;
+static ByteRing<UART_RX_RING> rx_ring;
+static InterruptSafeLock uart_lock("uart");
+static bool irq_mode = false;           // rings in use; cleared for good by uart_set_polled()
+static uint32_t imsc = 0;               // UART0_IMSC as last written
+static ReadyNode* rx_waiters = nullptr;  // chained through next
+static ReadyNode* tx_waiters = nullptr;
+static bool tx_held = false;            // uart_tx_hold()
+static UartStats stats;
+
 void uart_init(void) {
     unsigned int selector;
 
@@ -36,8 +84,10 @@ void uart_init(void) {
     delay(150);
     put32(GPPUDCLK0, 0);
 
-    // Disable UART0.
+    // Disable UART0, polled until uart_enable_irq()
     put32(UART0_CR, 0);
+    put32(UART0_IMSC, 0);
+    put32(UART0_ICR, INT_ALL);
 
     // Set integer & fractional part of baud rate
     put32(UART0_IBRD, 26); // Integer part of baud rate divisor
@@ -50,20 +100,196 @@ void uart_init(void) {
     put32(UART0_CR, (1 << 0) | (1 << 8) | (1 << 9)); // UARTEN, TXE, RXE
 }
 
-char uart_getc(void) {
-    // Wait until the UART has received data (RXFE - Receive FIFO Empty flag is clear)
-    while (get32(UART0_FR) & (1 << 4)) {
-        // Wait for data to be available
+static bool polled() {
+    return !__atomic_load_n(&irq_mode, __ATOMIC_RELAXED);
+}
+
+static void set_imsc(uint32_t v) {
+    if (v != imsc) put32(UART0_IMSC, imsc = v);
+}
+
+// The rest of these run with uart_lock held
+
+// Move up to a FIFO's worth from the TX ring into the FIFO. Without the
+// bound a UART that sends at once and never sets TXFF (QEMU's) would take
+// every write straight from the ring and never need the interrupt.
+static void tx_push() {
+    for (uint32_t n = 0; n < TX_FIFO_DEPTH && !tx_ring.empty() && !(get32(UART0_FR) & FR_TXFF); n++) {
+        put32(UART0_DR, tx_ring.pop());
+        stats.tx_bytes++;
+    }
+}
+
+// Feed the FIFO unless held, and keep the TX interrupt on for as long as
+// the ring has more
+static void tx_fill() {
+    if (!tx_held) tx_push();
+    set_imsc(tx_held || tx_ring.empty() ? imsc & ~INT_TX : imsc | INT_TX);
+}
+
+static bool tx_room() {
+    return tx_ring.used() <= UART_TX_RING / 2;
+}
+
+// Drain the RX FIFO into the ring
+static void rx_drain() {
+    while (!(get32(UART0_FR) & FR_RXFE)) {
+        char c = (char)(get32(UART0_DR) & 0xFF);
+        if (rx_ring.full()) {
+            stats.rx_dropped++;
+        } else {
+            rx_ring.push(c);
+            stats.rx_bytes++;
+        }
+    }
+}
+
+static ReadyNode* take(ReadyNode*& list) {
+    ReadyNode* n = list;
+    list = nullptr;
+    return n;
+}
+
+static void post_all(ReadyNode* n) {
+    while (n) {
+        ReadyNode* next = n->next;  // coro_post() reuses it
+        coro_post(*n);
+        n = next;
+    }
+}
+
+static void uart_irq(void*) {
+    ReadyNode* rx_wake = nullptr;
+    ReadyNode* tx_wake = nullptr;
+    {
+        LockGuard<InterruptSafeLock> g(uart_lock);
+        uint32_t mis = get32(UART0_MIS);
+        put32(UART0_ICR, mis);
+        if (mis & (INT_RX | INT_RT)) {
+            stats.rx_irqs++;
+            rx_drain();
+            if (!rx_ring.empty()) rx_wake = take(rx_waiters);
+        }
+        if (mis & INT_TX) {
+            stats.tx_irqs++;
+            tx_fill();
+            if (tx_room()) tx_wake = take(tx_waiters);
+        }
     }
+    post_all(rx_wake);
+    post_all(tx_wake);
+}
+
+void uart_enable_irq() {
+    // Nothing is unmasked yet, so nothing can fire before the handler is in
+    put32(UART0_IFLS, IFLS_TX_1_8 | IFLS_RX_1_2);
+    put32(UART0_ICR, INT_ALL);
+    request_irq(IRQ_PL011, uart_irq, nullptr);
+
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    set_imsc(INT_RX | INT_RT);
+    __atomic_store_n(&irq_mode, true, __ATOMIC_RELAXED);
+}
+
+void uart_set_polled() {
+    if (!__atomic_exchange_n(&irq_mode, false, __ATOMIC_RELAXED)) return;
+    put32(UART0_IMSC, 0);
+    while (!tx_ring.empty()) {
+        while (get32(UART0_FR) & FR_TXFF) {
+        }
+        put32(UART0_DR, tx_ring.pop());
+    }
+}
+
+uint64_t uart_write(const char* buf, uint64_t len) {
+    if (polled()) {
+        for (uint64_t i = 0; i < len; i++) uart_putc(buf[i]);
+        return len;
+    }
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    uint64_t n = 0;
+    while (n < len && !tx_ring.full()) tx_ring.push(buf[n++]);
+    tx_fill();
+    return n;
+}
+
+uint64_t uart_read(char* buf, uint64_t len) {
+    uint64_t n = 0;
+    if (polled()) {
+        while (n < len && !(get32(UART0_FR) & FR_RXFE)) buf[n++] = (char)(get32(UART0_DR) & 0xFF);
+        return n;
+    }
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    while (n < len && !rx_ring.empty()) buf[n++] = rx_ring.pop();
+    return n;
+}
+
+bool uart_wait_rx(ReadyNode& n) {
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    if (polled() || !rx_ring.empty()) return false;
+    n.next = rx_waiters;
+    rx_waiters = &n;
+    return true;
+}
+
+bool uart_wait_tx(ReadyNode& n) {
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    if (polled() || tx_room()) return false;
+    n.next = tx_waiters;
+    tx_waiters = &n;
+    stats.tx_waits++;
+    return true;
+}
+
+void uart_tx_hold(bool on) {
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    tx_held = on;
+    tx_fill();
+}
+
+UartStats uart_stats() {
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    UartStats s = stats;
+    s.tx_pending = tx_ring.used();
+    return s;
+}
 
-    // Read and return the character from the UART Data Register
-    return (char)(get32(UART0_DR) & 0xFF);
+char uart_getc(void) {
+    char c;
+    while (!uart_read(&c, 1)) cpu_relax();
+    return c;
+}
+
+bool uart_rx_ready(void) {
+    if (polled()) return !(get32(UART0_FR) & FR_RXFE);
+    // A hint only, like the FIFO flag it replaces
+    return __atomic_load_n(&rx_ring.head, __ATOMIC_RELAXED) !=
+           __atomic_load_n(&rx_ring.tail, __ATOMIC_RELAXED);
+}
+
+bool uart_tx_ready(void) {
+    if (polled()) return !(get32(UART0_FR) & FR_TXFF);
+    return __atomic_load_n(&tx_ring.head, __ATOMIC_RELAXED) -
+               __atomic_load_n(&tx_ring.tail, __ATOMIC_RELAXED) <
+           UART_TX_RING;
 }
 
 void uart_putc(char c) {
-    // Wait until transmit FIFO has space
-    while (get32(UART0_FR) & 0x20);
-    put32(UART0_DR, c);
+    if (polled()) {
+        while (get32(UART0_FR) & FR_TXFF) {
+        }
+        put32(UART0_DR, c);
+        return;
+    }
+    LockGuard<InterruptSafeLock> g(uart_lock);
+    // Full: feed the FIFO ourselves rather than drop output, held or not
+    while (tx_ring.full()) {
+        while (get32(UART0_FR) & FR_TXFF) {
+        }
+        tx_push();
+    }
+    tx_ring.push(c);
+    tx_fill();
 }
 
 void uart_puts(const char* str) {
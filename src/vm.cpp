@@ -2,6 +2,7 @@
 #include "libk.h"
 #include "stdint.h"
 #include "dcache.h"
+#include "heap.h"
 
 uint64_t PGD[512] __attribute__((aligned(4096), section(".paging")));
 uint64_t PUD[512] __attribute__((aligned(4096), section(".paging")));
@@ -25,6 +26,11 @@ static int next_pmd_table = 0;
 #define PTE_AP_RO           (1ULL << 6)   // Read-only for EL1
 #define PTE_UXN             (1ULL << 54)  // Execute Never (user)
 #define PTE_PXN             (1ULL << 53)  // Execute Never (privileged)
+#define PTE_AP_EL0          (1ULL << 6)   // EL0 has the same access as EL1
+#define PTE_AP_READONLY     (1ULL << 7)   // read-only at every level
+#define PTE_NG              (1ULL << 11)  // Not global: tagged with the ASID
+#define PTE_SW_OWNED        (1ULL << 55)  // software bit: page is freed with the tables
+#define PTE_ADDR_MASK       0x0000FFFFFFFFF000ULL
 
 #define PTE_ATTRINDX_NORMAL      (4ULL << 2)
 #define PTE_ATTRINDX_DEVICE      (0ULL << 2)
@@ -81,13 +87,14 @@ static inline uint64_t get_memory_attributes(uint64_t phys_addr) {
         return PTE_AP_RW | PTE_UXN | PTE_PXN | PTE_ATTRINDX_DEVICE;
     }
 
-    // normal memory (0x0 - 0x3F000000)
-    return PTE_SHARED | PTE_AP_RW | PTE_ATTRINDX_NORMAL;
+    // normal memory (0x0 - 0x3F000000); EL0 can't access it, and UXN keeps
+    // it from executing it too
+    return PTE_SHARED | PTE_AP_RW | PTE_ATTRINDX_NORMAL | PTE_UXN;
 }
 
 // Export a helper for normal cached page attributes for heap expansion
 uint64_t vm_get_normal_page_attrs() {
-    return PTE_SHARED | PTE_AP_RW | PTE_ATTRINDX_NORMAL;
+    return PTE_SHARED | PTE_AP_RW | PTE_ATTRINDX_NORMAL | PTE_UXN;
 }
 
 // Map a 2MB block
@@ -318,4 +325,104 @@ void check_address_mapping(uint64_t addr) {
     
     printf("Address 0x%llx: %s (PAR_EL1=0x%llx)\n", 
            addr, is_faulted ? "UNMAPPED" : "MAPPED", par);
-}
\ No newline at end of file
+}
+
+// Table walks are non-cacheable (TCR_VALUE), so every table write has to
+// reach memory before the walker can see it
+static uint64_t* user_table_alloc() {
+    uint64_t* table = (uint64_t*)kmalloc_aligned(PAGE_SIZE_4KB, PAGE_SIZE_4KB);
+    if (!table) return nullptr;
+    for (int i = 0; i < 512; i++) table[i] = 0;
+    clean_dcache_range(table, PAGE_SIZE_4KB);
+    return table;
+}
+
+static void user_table_set(uint64_t* entry, uint64_t desc) {
+    *entry = desc;
+    clean_dcache_line(entry);
+    asm volatile("dsb ishst");
+}
+
+uint64_t* vm_user_create() {
+    uint64_t* pgd = user_table_alloc();
+    if (pgd) user_table_set(&pgd[0], PGD[0]);
+    return pgd;
+}
+
+// The next-level table for va at level shift, allocating it if asked
+static uint64_t* user_next_table(uint64_t* table, uint64_t va, int shift, bool alloc) {
+    uint64_t* entry = &table[(va >> shift) & 0x1FF];
+    if (*entry & PTE_VALID) return (uint64_t*)phys_to_virt(*entry & PTE_ADDR_MASK);
+    if (!alloc) return nullptr;
+    uint64_t* next = user_table_alloc();
+    if (next) user_table_set(entry, create_table_descriptor(virt_to_phys(next)));
+    return next;
+}
+
+static uint64_t* user_pte(uint64_t* pgd, uint64_t va, bool alloc) {
+    if (va < USER_VA_START || va >= USER_VA_END) return nullptr;
+    uint64_t* table = pgd;
+    for (int shift = 39; table && shift > 12; shift -= 9) {
+        table = user_next_table(table, va, shift, alloc);
+    }
+    return table ? &table[(va >> 12) & 0x1FF] : nullptr;
+}
+
+bool vm_user_map(uint64_t* pgd, uint64_t va, uint64_t pa, uint32_t perms, bool owned) {
+    uint64_t* pte = user_pte(pgd, va, true);
+    if (!pte || (*pte & PTE_VALID)) return false;
+
+    // The kernel never runs user code, and EL0 only runs what was mapped
+    // executable
+    uint64_t attrs = PTE_SHARED | PTE_ATTRINDX_NORMAL | PTE_AP_EL0 | PTE_NG | PTE_PXN;
+    if (!(perms & WRITE_PERM)) attrs |= PTE_AP_READONLY;
+    if (!(perms & EXEC_PERM)) attrs |= PTE_UXN;
+    if (owned) attrs |= PTE_SW_OWNED;
+    user_table_set(pte, create_page_descriptor(pa, attrs));
+    return true;
+}
+
+bool vm_user_lookup(uint64_t* pgd, uint64_t va, uint32_t perms, uint64_t* pa) {
+    uint64_t* pte = user_pte(pgd, va, false);
+    if (!pte || !(*pte & PTE_VALID)) return false;
+    uint64_t desc = *pte;
+    if ((perms & WRITE_PERM) && (desc & PTE_AP_READONLY)) return false;
+    if ((perms & EXEC_PERM) && (desc & PTE_UXN)) return false;
+    if (pa) *pa = (desc & PTE_ADDR_MASK) | (va & 0xFFF);
+    return true;
+}
+
+// Free table and everything below it; level 3 holds the pages
+static void user_free_table(uint64_t* table, int level) {
+    for (int i = 0; i < 512; i++) {
+        uint64_t desc = table[i];
+        if (!(desc & PTE_VALID)) continue;
+        if (level < 3) {
+            user_free_table((uint64_t*)phys_to_virt(desc & PTE_ADDR_MASK), level + 1);
+        } else if (desc & PTE_SW_OWNED) {
+            kfree_aligned(phys_to_virt(desc & PTE_ADDR_MASK));
+        }
+    }
+    kfree_aligned(table);
+}
+
+void vm_user_destroy(uint64_t* pgd, uint16_t asid) {
+    asm volatile("dsb ishst\n\ttlbi aside1is, %0\n\tdsb ish\n\tisb" ::"r"((uint64_t)asid << 48)
+                 : "memory");
+    // Entry 0 belongs to the kernel
+    for (int i = 1; i < 512; i++) {
+        if (pgd[i] & PTE_VALID) user_free_table((uint64_t*)phys_to_virt(pgd[i] & PTE_ADDR_MASK), 1);
+    }
+    kfree_aligned(pgd);
+}
+
+void vm_user_switch(uint64_t* pgd, uint16_t asid) {
+    // TTBR1 always holds the kernel's tables
+    uint64_t ttbr;
+    if (pgd) {
+        ttbr = virt_to_phys(pgd) | ((uint64_t)asid << 48);
+    } else {
+        asm volatile("mrs %0, ttbr1_el1" : "=r"(ttbr));
+    }
+    asm volatile("msr ttbr0_el1, %0\n\tisb" ::"r"(ttbr) : "memory");
+}
@@ -0,0 +1,112 @@
+#include "wait.h"
+#include "atomic.h"
+#include "rcu.h"
+
+void WaitQueue::link(Waiter& w) {
+    w.next = nullptr;
+    w.prev = tail;
+    if (tail) {
+        tail->next = &w;
+    } else {
+        __atomic_store_n(&head, &w, __ATOMIC_RELAXED);
+    }
+    tail = &w;
+}
+
+void WaitQueue::unlink(Waiter& w) {
+    if (w.prev) {
+        w.prev->next = w.next;
+    } else {
+        __atomic_store_n(&head, w.next, __ATOMIC_RELAXED);
+    }
+    if (w.next) {
+        w.next->prev = w.prev;
+    } else {
+        tail = w.prev;
+    }
+    w.next = nullptr;
+    w.prev = nullptr;
+}
+
+void WaitQueue::finish(Waiter& w) {
+    LockGuard<InterruptSafeLock> g{lock};
+    // A woken waiter has already been unlinked by the waker
+    if (!w.woken.load_relaxed()) {
+        unlink(w);
+    }
+}
+
+static bool not_woken(void* arg) {
+    return !((Waiter*)arg)->woken.load_acquire();
+}
+
+void WaitQueue::block(Waiter& w) {
+    if (w.thread) {
+        while (not_woken(&w)) {
+            sched_block_if(not_woken, &w);
+        }
+        return;
+    }
+    if (w.woken.load_acquire()) return;
+
+    bool online = rcu_is_online();
+    if (online) rcu_idle_enter();
+    while (!w.woken.load_acquire()) {
+        wfe();
+    }
+    if (online) rcu_idle_exit();
+}
+
+uint32_t WaitQueue::wake(uint32_t n, const void* key) {
+    uint32_t woken = 0;
+    {
+        LockGuard<InterruptSafeLock> g{lock};
+        Waiter* w = head;
+        while (w && woken < n) {
+            Waiter* next = w->next;
+            if (key == nullptr || w->key == key) {
+                unlink(*w);
+                // The sleeper can't return from finish() until we drop the
+                // lock, so its thread is still around for sched_wakeup()
+                w->woken.store_release(true);
+                if (w->thread) sched_wakeup(w->thread);
+                woken++;
+            }
+            w = next;
+        }
+    }
+    if (woken) sev();
+    return woken;
+}
+
+/*
+ * Futex hash table. Waiters on different addresses may share a bucket; wake
+ * only dequeues the ones whose key matches.
+ */
+
+static constexpr uint32_t FUTEX_BUCKET_BITS = 6;
+static constexpr uint32_t FUTEX_BUCKETS = 1u << FUTEX_BUCKET_BITS;
+
+static WaitQueue futex_queues[FUTEX_BUCKETS];
+
+static inline WaitQueue& futex_bucket(const uint32_t* addr) {
+    uint64_t a = (uint64_t)addr >> 2;
+    a ^= a >> 7;
+    a *= 0x9E3779B97F4A7C15ull;
+    return futex_queues[a >> (64 - FUTEX_BUCKET_BITS)];
+}
+
+bool futex_wait(const uint32_t* addr, uint32_t expected) {
+    WaitQueue& wq = futex_bucket(addr);
+    Waiter w;
+    if (!wq.enqueue_if(w, addr, [&] { return __atomic_load_n(addr, __ATOMIC_SEQ_CST) == expected; })) {
+        return false;
+    }
+    WaitQueue::block(w);
+    wq.finish(w);
+    return true;
+}
+
+uint32_t futex_wake(const uint32_t* addr, uint32_t n) {
+    return futex_bucket(addr).wake(n, addr);
+}
@@ -0,0 +1,188 @@
+#include "workpool.h"
+#include "atomic.h"
+#include "percpu.h"
+#include "rcu.h"
+#include "sched.h"
+
+// Failed steal rounds before an idle core parks in wfe
+static constexpr uint32_t IDLE_SPINS = 64;
+
+static PerCPU<WorkDeque> deques;
+static PerCPU<uint32_t> steal_seed;
+static PerCPUCounter<uint64_t> steal_count;
+static Atomic<uint32_t> sleepers(0);
+
+static Atomic<bool> pool_stopping(false);
+static Atomic<uint32_t> pool_workers(0);
+
+bool WorkDeque::push(Task* t) {
+    int64_t b = __atomic_load_n(&bottom, __ATOMIC_RELAXED);
+    int64_t tp = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+    if (b - tp >= CAPACITY) return false;
+    __atomic_store_n(&tasks[b & (CAPACITY - 1)], t, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+Task* WorkDeque::pop() {
+    int64_t b = __atomic_load_n(&bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&bottom, b, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t t = __atomic_load_n(&top, __ATOMIC_RELAXED);
+
+    if (t > b) {
+        __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+        return nullptr;
+    }
+    Task* task = __atomic_load_n(&tasks[b & (CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (t == b) {
+        // Last task: race any thief for it
+        if (!__atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST,
+                                         __ATOMIC_RELAXED)) {
+            task = nullptr;
+        }
+        __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+Task* WorkDeque::steal() {
+    int64_t t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t b = __atomic_load_n(&bottom, __ATOMIC_ACQUIRE);
+    if (t >= b) return nullptr;
+
+    // The owner can't reuse this slot until top moves past it
+    Task* task = __atomic_load_n(&tasks[t & (CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&top, &t, t + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return nullptr;
+    }
+    return task;
+}
+
+static void run_task(Task* t) {
+    // t may be gone as soon as its group sees it finish
+    TaskGroup* group = t->group;
+    t->run(t);
+    group->task_done();
+}
+
+static Task* steal_any() {
+    uint32_t me = this_core();
+
+    // xorshift32: start at a random victim so thieves spread out
+    uint32_t& seed = steal_seed.mine();
+    uint32_t x = seed ? seed : me * 2654435761u + 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    seed = x;
+
+    for (uint32_t i = 0; i < CORE_COUNT; i++) {
+        uint32_t victim = (x + i) % CORE_COUNT;
+        if (victim == me) continue;
+        Task* t = deques.forCPU(victim).steal();
+        if (t) {
+            steal_count.inc();
+            return t;
+        }
+    }
+    return nullptr;
+}
+
+static bool all_empty() {
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (!deques.forCPU(core).empty()) return false;
+    }
+    return true;
+}
+
+void TaskGroup::spawn(Task& t) {
+    t.group = this;
+    pending.fetch_add(1);
+
+    // Threads sharing this core must not interleave owner operations
+    Preempt::disable();
+    bool queued = deques.mine().push(&t);
+    Preempt::enable();
+    if (!queued) {
+        run_task(&t);
+        return;
+    }
+
+    // Pairs with the sleeper count in work_until(): either we see the
+    // sleeper, or it sees our task before it parks
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (sleepers.get() != 0) sev();
+}
+
+void TaskGroup::sync() {
+    while (!idle()) {
+        if (!WorkPool::run_one()) cpu_relax();
+    }
+}
+
+bool WorkPool::run_one() {
+    Preempt::disable();
+    Task* t = deques.mine().pop();
+    Preempt::enable();
+
+    if (!t) t = steal_any();
+    if (!t) return false;
+    run_task(t);
+    return true;
+}
+
+void WorkPool::work_until(Atomic<bool>& stop) {
+    uint32_t idle_rounds = 0;
+
+    while (!stop.load_acquire()) {
+        if (run_one()) {
+            idle_rounds = 0;
+            rcu_quiescent_state();
+            continue;
+        }
+        if (++idle_rounds < IDLE_SPINS) {
+            cpu_relax();
+            continue;
+        }
+
+        sleepers.add_fetch(1);
+        if (all_empty() && !stop.load_acquire()) {
+            bool online = rcu_is_online();
+            if (online) rcu_idle_enter();
+            wfe();
+            if (online) rcu_idle_exit();
+        }
+        sleepers.add_fetch((uint32_t)-1);
+        idle_rounds = 0;
+    }
+}
+
+static void worker_thread(void*) {
+    WorkPool::work_until(pool_stopping);
+    pool_workers.add_fetch((uint32_t)-1);
+}
+
+void WorkPool::start() {
+    uint32_t me = this_core();
+    pool_stopping.set(false);
+    for (uint32_t core = 0; core < CORE_COUNT; core++) {
+        if (core == me) continue;
+        pool_workers.add_fetch(1);
+        thread_create("worker", worker_thread, nullptr, core);
+    }
+}
+
+void WorkPool::stop() {
+    pool_stopping.set(true);
+    sev();
+    while (pool_workers.get() != 0) {
+        yield();
+    }
+}
+
+uint64_t WorkPool::steals(uint32_t core) {
+    return steal_count.forCPU(core);
+}